@@ -23,9 +23,12 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include "sis.h"
+#include "pattern.h"
+#include "dprep.h"
 
 /*
 
@@ -74,6 +77,13 @@ Contains for each pixel of the SIS output image of one row the column index
 of the pixel image that has the same color in this row. So, IdentBuffer
 contains indices of locations in the image, not color indices.
 
+IdentFrac:
+Fractional part of the linked location in IdentBuffer in units of
+1/SIS_SUBPIX_ONE pixels. The color of the pixel is interpolated between the
+linked pixel and its right neighbour, random dots take the color of the
+nearer one. Only used with subpixel linking (algorithms 1-3 with an
+oversampling factor > 1), otherwise always zero.
+
 SISBuffer:
 Color values (palette indices) of each pixel in the output SIS image.
 
@@ -82,177 +92,271 @@ Like the SISBuffer, but with rgb color values and not palette indices.
 This allows for having more colors in the output SIS image than
 the color palette taken from the texture image provides.
 
+With --indexed, colors are never interpolated or averaged. Every dot of
+SIScolorRGB is a palette color, and indexed output files are written with
+the palette indices of GatherIndexRow().
+
 */
 
 /// The biggest and smallest distance in one line (!)
 /// of the depth-map. This is just for efficiency.
-z_t max_depth_in_row, min_depth_in_row, max_depth, min_depth;
-
-int algorithm;
-/// Just for statistics.
-long forwards_obscure_c, backwards_obscure_c;
-long inner_propagate_c, outer_propagate_c;
-
-/// Near and far plane
-float t, u;
+SIS_THREAD_LOCAL z_t max_depth_in_row, min_depth_in_row;
 
 /// References to equally-colored pixels
-static ind_t *IdentBuffer;
+static SIS_THREAD_LOCAL ind_t *IdentBuffer;
 // static col_t *IdentBuffer;
+/// Subpixel part of the references in IdentBuffer
+static SIS_THREAD_LOCAL uint8_t *IdentFrac;
 
-/// Separation of each possible z
-static ind_t separation[SIS_MAX_COLORS + 1];
-/// Ascend dz to check for hidden pixels
-static pos_t dz[SIS_MAX_COLORS + 1];
-
-static pos_t DBufStep;
-/// Proportions of near and far-plane
-static int numerator, denominator;
-
-col_t *SISBuffer = NULL;
+SIS_THREAD_LOCAL col_t *SISBuffer = NULL;
 
 /// IdentBuffer's equivalent in algo #4 are lookL and lookR
-static int *lookL, *lookR;
+static SIS_THREAD_LOCAL int *lookL, *lookR;
+
 
+/// Size of the SIS from -x and -y, the size of the depth map where they're missing
 void
-InitAlgorithm(void)
+InitSISSize(void)
 {
-	if (!SISwidth && !SISheight) {
-		SISwidth = Dwidth;
-		SISheight = Dheight;
+	if (!sis->SISwidth && !sis->SISheight) {
+		sis->SISwidth = sis->Dwidth;
+		sis->SISheight = sis->Dheight;
 	}
-	if (!SISwidth) {
-		SISwidth = SISheight * (float)Dwidth / (float)Dheight;
+	if (!sis->SISwidth) {
+		sis->SISwidth = sis->SISheight * (float)sis->Dwidth / (float)sis->Dheight;
 	}
-	if (!SISheight) {
-		SISheight = SISwidth * (float)Dheight / (float)Dwidth;
+	if (!sis->SISheight) {
+		sis->SISheight = sis->SISwidth * (float)sis->Dheight / (float)sis->Dwidth;
 	}
+}
+
+
+void
+InitAlgorithm(void)
+{
+	InitKernels();
+	InitSISSize();
 
 	/// max(int) > SIS_MAX_DEPTH
 	int i;
 
-	if (origin > SISwidth) {
+	if (sis->origin > sis->SISwidth) {
 		fprintf(stderr, "Starting point out of range\n");
-		exit(1);
+		SISExit(1);
 	}
 
-	DBufStep = (double)Dwidth / (double)SISwidth;
+	sis->DBufStep = (double)sis->Dwidth / (double)sis->SISwidth;
+	free(sis->DColumn);
+	if ((sis->DColumn = (ind_t *)malloc(sis->SISwidth * sizeof(ind_t))) == NULL) {
+		fprintf(stderr, "Couldn't alloc memory for depth columns.\n");
+		SISExit(1);
+	}
+	for (i = 0; i < sis->SISwidth; i++) {
+		sis->DColumn[i] = (ind_t)((double)i * sis->Dwidth / sis->SISwidth);
+	}
 	for (i = 0; i <= SIS_MAX_COLORS; i++) {
-		zvalue[i] = -1;
+		sis->zvalue[i] = -1;
 	}
-	numerator = SIS_MAX_DEPTH / u;
-	denominator = SIS_MAX_DEPTH / u + SIS_MAX_DEPTH / (t * u);
+	sis->filled_lo = SIS_MAX_COLORS;
+	sis->filled_hi = 0;
+	sis->numerator = SIS_MAX_DEPTH / sis->u;
+	sis->denominator = SIS_MAX_DEPTH / sis->u + SIS_MAX_DEPTH / (sis->t * sis->u);
 	// printf("DBufStep: %f\n", DBufStep);
 	// printf("SIS_MAX_DEPTH: %d\n", SIS_MAX_DEPTH);
 	// printf("u: %f\n", u);
 	// printf("t: %f\n", t);
 	// printf("numerator: %d\n", numerator);
 	// printf("denominator: %d\n", denominator);
-	if (SIStype != SIS_TEXT_MAP) {
-		Twidth = 1;
-		Theight = 1;
+	if (sis->SIStype != SIS_TEXT_MAP) {
+		sis->Twidth = 1;
+		sis->Theight = 1;
 	}
-
-	if (eye_dist == 0) {
-		eye_dist = metric2pixel(22, resolution);
+	/// Instead of oversampled buffers, algorithms 1-3 use fractional separations.
+	/// Interpolated texture colors aren't in the palette of indexed output,
+	/// random dots keep their palette indices anyway.
+	sis->subpixel = (sis->algorithm < 4 && sis->oversam > 1
+	            && !(sis->indexed_output && sis->SIStype == SIS_TEXT_MAP));
+
+	if (sis->eye_dist == 0) {
+		sis->eye_dist = metric2pixel(22, sis->resolution);
 	}
-	halfstripwidth = eye_dist * t / (2 * (1 + t));
-	halftriangwidth = SISwidth / 75;
-	if (!halftriangwidth)
-		halftriangwidth = 4;
-	DLineStep = (double)Dheight / (double)SISheight;
-	DLinePosition = 0.0;
+	sis->halfstripwidth = sis->eye_dist * sis->t / (2 * (1 + sis->t));
+	sis->halftriangwidth = sis->SISwidth / 75;
+	if (!sis->halftriangwidth)
+		sis->halftriangwidth = 4;
+	sis->DLineStep = (double)sis->Dheight / (double)sis->SISheight;
+	sis->DLinePosition = 0.0;
 	/// Set the original default value for origin in case of algo #4,
 	/// it is not in the center of the image because some artifacts
 	/// in the background appear
-	if (origin == -1 && algorithm < 4) {
-		origin = SISwidth >> 1;
+	if (sis->origin == -1 && sis->algorithm < 4) {
+		sis->origin = sis->SISwidth >> 1;
 	}
-	switch (SIStype) {
+	switch (sis->SIStype) {
 	case SIS_RANDOM_GREY:
-		SISred[0] = SISgreen[0] = SISblue[0] = white_value;
-		white = 0;
-		for (int i = 1; i < rand_grey_num; i++) {
-			SISred[i] = SISgreen[i] = SISblue[i] =
-			    i * (float)SIS_MAX_CMAP / (float)rand_grey_num;
+		sis->SISred[0] = sis->SISgreen[0] = sis->SISblue[0] = sis->white_value;
+		sis->white = 0;
+		for (int i = 1; i < sis->rand_grey_num; i++) {
+			sis->SISred[i] = sis->SISgreen[i] = sis->SISblue[i] =
+			    i * (float)SIS_MAX_CMAP / (float)sis->rand_grey_num;
 		}
 		break;
 	case SIS_RANDOM_COLOR:
-		for (int i = 0; i < rand_col_num; i++) {
-			SISred[i] = rand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
-			SISgreen[i] = rand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
-			SISblue[i] = rand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
+		for (int i = 0; i < sis->rand_col_num; i++) {
+			sis->SISred[i] = SISRand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
+			sis->SISgreen[i] = SISRand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
+			sis->SISblue[i] = SISRand() / ((float)RAND_MAX / (float)SIS_MAX_CMAP);
 		}
 		break;
 	}
-	SISred[SIS_MAX_COLORS] = SISgreen[SIS_MAX_COLORS] = SISblue[SIS_MAX_COLORS]
-	    = black_value;
-	black = SIS_MAX_COLORS;
-	max_depth = SIS_MIN_DEPTH;
-	min_depth = SIS_MAX_DEPTH;
+	sis->SISred[SIS_MAX_COLORS] = sis->SISgreen[SIS_MAX_COLORS] = sis->SISblue[SIS_MAX_COLORS]
+	    = sis->black_value;
+	sis->black = SIS_MAX_COLORS;
+	sis->max_depth = SIS_MIN_DEPTH;
+	sis->min_depth = SIS_MAX_DEPTH;
 
-	inner_propagate_c = 0;
-	outer_propagate_c = 0;
-	forwards_obscure_c = 0;
-	backwards_obscure_c = 0;
+	sis->render_stats = (sis_stats_t){0};
 }
 
 
 void
-DaddEntry(col_t index, z_t zval)
+MergeStats(sis_stats_t *total, const sis_stats_t *worker)
+{
+	total->inner_propagate += worker->inner_propagate;
+	total->outer_propagate += worker->outer_propagate;
+	total->forwards_obscure += worker->forwards_obscure;
+	total->backwards_obscure += worker->backwards_obscure;
+}
+
+
+static void
+add_depth_to_range(z_t zval)
 {
-	if (invert)
-		zval = SIS_MAX_DEPTH - zval;
 	if (zval < min_depth_in_row)
 		min_depth_in_row = zval;
 	if (zval > max_depth_in_row)
 		max_depth_in_row = zval;
-	if (min_depth_in_row < min_depth)
-		min_depth = min_depth_in_row;
-	if (max_depth_in_row > max_depth)
-		max_depth = max_depth_in_row;
-
-	if (zvalue[index] == -1) {
-		zvalue[index] = zval;
-		if (algorithm == 4) {
-			separation[index] = eye_dist * oversam * (numerator - zval) / (denominator - zval);
-			dz[index] = (double)(denominator - zval) / (double)(((eye_dist * oversam) >> 1) * DBufStep);
+	if (min_depth_in_row < sis->min_depth)
+		sis->min_depth = min_depth_in_row;
+	if (max_depth_in_row > sis->max_depth)
+		sis->max_depth = max_depth_in_row;
+}
+
+
+void
+DaddEntry(col_t index, z_t zval)
+{
+	if (sis->invert)
+		zval = SIS_MAX_DEPTH - zval;
+	add_depth_to_range(zval);
+
+	if (sis->zvalue[index] == -1) {
+		sis->zvalue[index] = zval;
+		if (sis->algorithm == 4) {
+			sis->separation[index] = sis->eye_dist * sis->oversam * (sis->numerator - zval) / (sis->denominator - zval);
+			sis->dz[index] = (double)(sis->denominator - zval) / (double)(((sis->eye_dist * sis->oversam) >> 1) * sis->DBufStep);
 		} else {
-			separation[index] = eye_dist * (numerator - zval) / (denominator - zval);
-			dz[index] = (double)(denominator - zval) / (double)((eye_dist >> 1) * DBufStep);
+			/// Fixed-point separation, quantized to 1/oversam pixels
+			sis->separation[index] = ((sis->eye_dist * sis->oversam * (sis->numerator - zval) / (sis->denominator - zval))
+			                     << SIS_SUBPIX_BITS) / sis->oversam;
+			sis->dz[index] = (double)(sis->denominator - zval) / (double)((sis->eye_dist >> 1) * sis->DBufStep);
 		}
 	}
 }
 
 
+/// Register all depth values between lo and hi of a row, their z value is
+/// the depth value shifted left by shift bits. The tables for zvalue and
+/// separation are only filled for the values that haven't been seen before.
+void
+DaddRange(col_t lo, col_t hi, int shift)
+{
+	col_t index;
+	if (sis->depth_capture)
+		return;
+	if (sis->filled_lo > sis->filled_hi) {
+		for (index = lo; index <= hi; index++)
+			DaddEntry(index, (z_t)index << shift);
+	} else {
+		for (index = lo; index < sis->filled_lo; index++)
+			DaddEntry(index, (z_t)index << shift);
+		for (index = sis->filled_hi + 1; index <= hi; index++)
+			DaddEntry(index, (z_t)index << shift);
+	}
+	if (lo < sis->filled_lo)
+		sis->filled_lo = lo;
+	if (hi > sis->filled_hi)
+		sis->filled_hi = hi;
+	z_t zlo = (z_t)lo << shift, zhi = (z_t)hi << shift;
+	add_depth_to_range(sis->invert ? SIS_MAX_DEPTH - zlo : zlo);
+	add_depth_to_range(sis->invert ? SIS_MAX_DEPTH - zhi : zhi);
+}
+
+
+/// Only algorithm 4 renders into an oversampled 'virtual' row
+static ind_t
+virtual_width(void)
+{
+	return sis->SISwidth * (sis->algorithm == 4 ? sis->oversam : 1);
+}
+
+
+/// Width of one period of the SIS in dots, the separation at the far plane.
+/// A texture of this width repeats exactly where the SIS repeats.
+ind_t
+TexturePeriod(void)
+{
+	ind_t eye = sis->eye_dist ? sis->eye_dist : metric2pixel(22, sis->resolution);
+	if (sis->algorithm == 4) {
+		/// maxsep of asteer(), which is in oversampled dots
+		int obsDist  = SIS_MAX_DEPTH / sis->u;
+		int maxdepth = SIS_MAX_DEPTH / (sis->u * sis->t);
+		return (ind_t)(((long)eye * sis->oversam * maxdepth) / (maxdepth + obsDist)) / sis->oversam;
+	}
+	int num = SIS_MAX_DEPTH / sis->u;
+	int den = SIS_MAX_DEPTH / sis->u + SIS_MAX_DEPTH / (sis->t * sis->u);
+	return eye * num / den;
+}
+
+
 void
 AllocBuffers(void)
 {
-	if ((DBuffer = (col_t *)calloc(Dwidth * oversam, sizeof(col_t))) == NULL) {
+	ind_t vwidth = virtual_width();
+
+	if ((DBuffer = (col_t *)calloc(sis->Dwidth * sis->oversam, sizeof(col_t))) == NULL) {
 		fprintf(stderr, "Couldn't alloc memory for depth buffer.\n");
-		exit(1);
+		SISExit(1);
 	}
-	if ((IdentBuffer = (ind_t *)calloc(SISwidth * oversam, sizeof(ind_t))) == NULL) {
+	if ((IdentBuffer = (ind_t *)calloc(vwidth, sizeof(ind_t))) == NULL) {
 	// if ((IdentBuffer = (col_t *) calloc(SISwidth * oversam, sizeof(col_t))) == NULL) {
 		fprintf(stderr, "Couldn't alloc memory for ident buffer\n");
 		free(DBuffer);
-		exit(1);
+		SISExit(1);
 	}
-	if ((SISBuffer = (col_t *)calloc(SISwidth * oversam, sizeof(col_t))) == NULL) {
+	if ((SISBuffer = (col_t *)calloc(vwidth, sizeof(col_t))) == NULL) {
 		fprintf(stderr, "Couldn't alloc memory for SIS buffer.\n");
 		free(DBuffer);
 		free(IdentBuffer);
-		exit(1);
+		SISExit(1);
 	}
-	if ((SIScolorRGB = (col_rgb_t *)calloc(SISwidth * oversam, sizeof(col_rgb_t))) == NULL ) {;
+	if ((SIScolorRGB = (col_rgb_t *)calloc(vwidth, sizeof(col_rgb_t))) == NULL ) {;
 		fprintf(stderr, "Couldn't alloc memory for SIScolorRGB buffer.\n");
 		free(DBuffer);
 		free(IdentBuffer);
 		free(SISBuffer);
-		exit(1);
+		SISExit(1);
+	}
+	if ((IdentFrac = (uint8_t *)calloc(sis->SISwidth, sizeof(uint8_t))) == NULL) {
+		fprintf(stderr, "Couldn't alloc memory for ident fraction buffer.\n");
+		free(DBuffer);
+		free(IdentBuffer);
+		free(SISBuffer);
+		free(SIScolorRGB);
+		SISExit(1);
 	}
-	lookL = (int *)calloc(SISwidth * oversam, sizeof(int));
-	lookR = (int *)calloc(SISwidth * oversam, sizeof(int));
+	lookL = (int *)calloc(vwidth, sizeof(int));
+	lookR = (int *)calloc(vwidth, sizeof(int));
 }
 
 
@@ -263,176 +367,203 @@ FreeBuffers(void)
 	free(IdentBuffer);
 	free(SISBuffer);
 	free(SIScolorRGB);
+	free(IdentFrac);
 	free(lookL);
 	free(lookR);
 }
 
 
+/// Half width of the little triangles in row y, -1 if there are none
+static ind_t
+triangle_size(ind_t y)
+{
+	if ((y < sis->halftriangwidth) && ((sis->SISwidth >> 1) > sis->halfstripwidth + sis->halftriangwidth))
+		return sis->halftriangwidth - y;
+	return -1;
+}
+
+
 /// Add the little, nice triangles in black
 void
 AddTriangles(ind_t y)
 {
 	col_rgb_t black_rgb = {0, 0, 0};
-	if ((y < halftriangwidth) && ((SISwidth >> 1) > halfstripwidth + halftriangwidth)) {
-		for (ind_t i = halftriangwidth - y; i >= 0; i--) {
-			SIScolorRGB[(SISwidth >> 1) - halfstripwidth - i] = black_rgb;
-			SIScolorRGB[(SISwidth >> 1) - halfstripwidth + i] = black_rgb;
-			SIScolorRGB[(SISwidth >> 1) + halfstripwidth - i] = black_rgb;
-			SIScolorRGB[(SISwidth >> 1) + halfstripwidth + i] = black_rgb;
-		}
+	for (ind_t i = triangle_size(y); i >= 0; i--) {
+		SIScolorRGB[(sis->SISwidth >> 1) - sis->halfstripwidth - i] = black_rgb;
+		SIScolorRGB[(sis->SISwidth >> 1) - sis->halfstripwidth + i] = black_rgb;
+		SIScolorRGB[(sis->SISwidth >> 1) + sis->halfstripwidth - i] = black_rgb;
+		SIScolorRGB[(sis->SISwidth >> 1) + sis->halfstripwidth + i] = black_rgb;
 	}
 }
 
 
-void
-CalcIdentLine(void)
+SIS_KERNEL_BODY void
+calc_ident_line_body(sis_stats_t *stats)
 {
 	z_t z, z_limit;             /* z_limit > SIS_MAX_DEPTH !!!!!!!!! */
-	ind_t i, DBufInd, IdentBufInd, left, right, IdInd;
-	pos_t DBufPos, ZPos;
+	ind_t i, DBufInd, IdentBufInd, left, right, IdInd, sep;
+	ind_t left_fx, right_fx;    /* Linked positions in fixed-point */
+	pos_t ZPos;
 	int visible;
 
-	for (i = 0; i < SISwidth; i++)  /* point to yourself */
+	for (i = 0; i < sis->SISwidth; i++)  /* point to yourself */
 		IdentBuffer[i] = i;
 
 	/// Handle the right half of the picture from the origin
-	DBufPos = (SISwidth - 1) * DBufStep;
-	for (IdentBufInd = SISwidth - 1; IdentBufInd >= origin; IdentBufInd--) {
-		DBufInd = (int)DBufPos;
-		z = zvalue[DBuffer[DBufInd]];
+	for (IdentBufInd = sis->SISwidth - 1; IdentBufInd >= sis->origin; IdentBufInd--) {
+		DBufInd = sis->DColumn[IdentBufInd];
+		z = sis->zvalue[DBuffer[DBufInd]];
+		sep = sis->separation[DBuffer[DBufInd]];
 
 		/// Left eye sees this:
-		left = IdentBufInd - (separation[DBuffer[DBufInd]] >> 1);
+		left = IdentBufInd - ((sep >> SIS_SUBPIX_BITS) >> 1);
 		/// Right eye sees this:
-		right = left + separation[DBuffer[DBufInd]];
+		right = left + (sep >> SIS_SUBPIX_BITS);
+		/// The exact position seen by the left eye is subpixel
+		left_fx = (right << SIS_SUBPIX_BITS) - sep;
+		left = left_fx >> SIS_SUBPIX_BITS;
 		/// Both is within the SIS-picture
-		if ((0 <= left) && (right < SISwidth)) {
+		if ((0 <= left) && (right < sis->SISwidth)) {
 			visible = 1;
-			if (algorithm > 2) {
+			if (sis->algorithm > 2) {
 				/// Check for hidden pixels:
-				ZPos = z + dz[DBuffer[DBufInd]];
+				ZPos = z + sis->dz[DBuffer[DBufInd]];
 				z_limit = (unsigned int)ZPos;
 				for (i = 1; z_limit < (unsigned int)max_depth_in_row; i++) {
 					/// Does right eye see all?
-					if (zvalue[DBuffer[DBufInd + i]] > z_limit) {
+					if (sis->zvalue[DBuffer[DBufInd + i]] > z_limit) {
 						visible = 0;
-						backwards_obscure_c++;
+						STAT_INC(stats, backwards_obscure);
 						break;
 					}
 					/// Does left eye see all?
-					if (zvalue[DBuffer[DBufInd - i]] > z_limit) {
+					if (sis->zvalue[DBuffer[DBufInd - i]] > z_limit) {
 						visible = 0;
-						forwards_obscure_c++;
+						STAT_INC(stats, forwards_obscure);
 						break;
 					}
-					ZPos += dz[DBuffer[DBufInd]];
+					ZPos += sis->dz[DBuffer[DBufInd]];
 					/// Don't go further than the nearest point
 					z_limit = (unsigned int)ZPos;
 				}
 			}
 			if (visible) {
-				if (algorithm > 1) {
+				if (sis->algorithm > 1) {
 					/// Now do the propagation stuff
 					IdInd = IdentBuffer[right];
 					/// Already pointed at a pixel between left and right
-					while ((origin <= left) && (IdInd != left)
+					while ((sis->origin <= left) && (IdInd != left)
 					       && (IdInd != right)) {
 						if (IdInd > left) {
-							inner_propagate_c++;
+							STAT_INC(stats, inner_propagate);
 							right = IdInd;
 							IdInd = IdentBuffer[right];
 						}
 						/// Already pointed at a pixel outside of left and right
 						else {
-							outer_propagate_c++;
+							STAT_INC(stats, outer_propagate);
+							/// The old link of right is carried over to left,
+							/// shifted by the difference of both fractions
+							ind_t frac = IdentFrac[right];
 							IdentBuffer[right] = left;
+							IdentFrac[right] = left_fx & SIS_SUBPIX_MASK;
 							right = left;
-							left = IdInd;
+							left_fx = (IdInd << SIS_SUBPIX_BITS) + frac - (left_fx & SIS_SUBPIX_MASK);
+							if (left_fx < 0)
+								left_fx = 0;
+							left = left_fx >> SIS_SUBPIX_BITS;
 							IdInd = IdentBuffer[right];
 						}
 					}
 				}
 				/// Here's what the most simple SIS-algorithm does (nearly nothing)
 				IdentBuffer[right] = left;
+				IdentFrac[right] = left_fx & SIS_SUBPIX_MASK;
 			}
 		}
-		DBufPos -= DBufStep;
 	}
 
 	/// Handle the left half of the picture from the origin
-	DBufPos = 0.0;
-	for (IdentBufInd = 0; IdentBufInd < origin; IdentBufInd++) {
-		DBufInd = (int)DBufPos;
-		z = zvalue[DBuffer[DBufInd]];
+	for (IdentBufInd = 0; IdentBufInd < sis->origin; IdentBufInd++) {
+		DBufInd = sis->DColumn[IdentBufInd];
+		z = sis->zvalue[DBuffer[DBufInd]];
+		sep = sis->separation[DBuffer[DBufInd]];
 
-		left = IdentBufInd - (separation[DBuffer[DBufInd]] >> 1);
-		right = left + separation[DBuffer[DBufInd]];
+		left = IdentBufInd - ((sep >> SIS_SUBPIX_BITS) >> 1);
+		right_fx = (left << SIS_SUBPIX_BITS) + sep;
+		right = right_fx >> SIS_SUBPIX_BITS;
 
-		if ((0 <= left) && (right < SISwidth)) {
+		if ((0 <= left) && (right < sis->SISwidth)) {
 			visible = 1;
-			if (algorithm > 2) {
-				ZPos = z + dz[DBuffer[DBufInd]];
+			if (sis->algorithm > 2) {
+				ZPos = z + sis->dz[DBuffer[DBufInd]];
 				z_limit = (unsigned int)ZPos;
 				for (i = 1; z_limit < (unsigned int)max_depth_in_row; i++) {
-					if (zvalue[DBuffer[DBufInd + i]] > z_limit) {
+					if (sis->zvalue[DBuffer[DBufInd + i]] > z_limit) {
 						visible = 0;
-						forwards_obscure_c++;
+						STAT_INC(stats, forwards_obscure);
 						break;
 					}
-					if (zvalue[DBuffer[DBufInd - i]] > z_limit) {
+					if (sis->zvalue[DBuffer[DBufInd - i]] > z_limit) {
 						visible = 0;
-						backwards_obscure_c++;
+						STAT_INC(stats, backwards_obscure);
 						break;
 					}
-					ZPos += dz[DBuffer[DBufInd]];
+					ZPos += sis->dz[DBuffer[DBufInd]];
 					z_limit = (unsigned int)ZPos;
 				}
 			}
 			if (visible) {
-				if (algorithm > 1) {
+				if (sis->algorithm > 1) {
 					IdInd = IdentBuffer[left];
-					while ((right < origin) && (IdInd != left)
+					while ((right < sis->origin) && (IdInd != left)
 					       && (IdInd != right)) {
 						if (IdInd < right) {
-							inner_propagate_c++;
+							STAT_INC(stats, inner_propagate);
 							left = IdInd;
 							IdInd = IdentBuffer[left];
 						} else {
-							outer_propagate_c++;
+							STAT_INC(stats, outer_propagate);
+							ind_t frac = IdentFrac[left];
 							IdentBuffer[left] = right;
+							IdentFrac[left] = right_fx & SIS_SUBPIX_MASK;
 							left = right;
-							right = IdInd;
+							right_fx = (IdInd << SIS_SUBPIX_BITS) + frac - (right_fx & SIS_SUBPIX_MASK);
+							right = right_fx >> SIS_SUBPIX_BITS;
 							IdInd = IdentBuffer[left];
 						}
 					}
 				}
 				IdentBuffer[left] = right;
+				IdentFrac[left] = right_fx & SIS_SUBPIX_MASK;
 			}
 		}
-		DBufPos += DBufStep;
 	}
 }
 
 
+SIS_KERNEL_VARIANTS(calc_ident_line, (sis_stats_t *stats), (stats))
+
+
 #define random_texture_size (200)
 col_t random_texture[random_texture_size][random_texture_size];
 
 void
 init_random_texture(void)
 {
-	Theight = random_texture_size;
-	Twidth = random_texture_size;
+	sis->Theight = random_texture_size;
+	sis->Twidth = random_texture_size;
 	for (int line_number = 0; line_number < random_texture_size; ++line_number) {
 		for (int i = 0; i < random_texture_size; i++) {
-			switch (SIStype) {
+			switch (sis->SIStype) {
 			case SIS_RANDOM_GREY:
-				if (rand_grey_num == 2)
-					random_texture[line_number][i] = (rand() > (RAND_MAX * density)) ? white : black;
+				if (sis->rand_grey_num == 2)
+					random_texture[line_number][i] = (SISRand() > (RAND_MAX * sis->density)) ? sis->white : sis->black;
 				else
-					random_texture[line_number][i] = rand() / (RAND_MAX / rand_grey_num);
+					random_texture[line_number][i] = SISRand() / (RAND_MAX / sis->rand_grey_num);
 				break;
 			case SIS_RANDOM_COLOR:
-				random_texture[line_number][i] = rand() / (RAND_MAX / rand_col_num);
+				random_texture[line_number][i] = SISRand() / (RAND_MAX / sis->rand_col_num);
 				break;
 			}
 		}
@@ -440,51 +571,278 @@ init_random_texture(void)
 }
 
 
+/// Random numbers of a thread come from *dot_seed instead of rand() if it's
+/// set. The frames of a video then get the same dots whichever thread renders
+/// them, and libsis leaves the rand() state of its caller alone.
+static SIS_THREAD_LOCAL uint32_t *dot_seed;
+
+
+void
+SetDotSeed(uint32_t *seed)
+{
+	dot_seed = seed;
+}
+
+
+int
+SISRand(void)
+{
+	if (!dot_seed)
+		return rand();
+	/// xorshift32, the seed must not be zero
+	uint32_t x = *dot_seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*dot_seed = x;
+	return (int)(x % ((uint32_t)RAND_MAX + 1));
+}
+
+
 void
 InitSISBuffer(ind_t LineNumber)
 {
 	// init_random_texture();
-	for (ind_t i = 0; i < SISwidth * oversam; i++) {
-		switch (SIStype) {
+	if (sis->SIStype == SIS_TEXT_MAP && sis->texture_pattern) {
+		/// asteer() sets each dot from the pattern itself
+		if (sis->algorithm < 4)
+			sis->PatternRow(SISBuffer, 0, virtual_width(), LineNumber, 1);
+		return;
+	}
+	if (sis->SIStype == SIS_TEXT_MAP) {
+		sis->FillTextureRow(SISBuffer, sis->ReadTRow(LineNumber % sis->Theight), sis->Twidth, virtual_width());
+		return;
+	}
+	for (ind_t i = 0; i < virtual_width(); i++) {
+		switch (sis->SIStype) {
 		case SIS_RANDOM_GREY:
-			if (rand_grey_num == 2)
-				SISBuffer[i] = (rand() > (RAND_MAX * density)) ? white : black;
+			if (sis->rand_grey_num == 2)
+				SISBuffer[i] = (SISRand() > (RAND_MAX * sis->density)) ? sis->white : sis->black;
 			else
-				SISBuffer[i] = rand() / (RAND_MAX / rand_grey_num);
+				SISBuffer[i] = SISRand() / (RAND_MAX / sis->rand_grey_num);
 			break;
 		case SIS_RANDOM_COLOR:
-			SISBuffer[i] = rand() / (RAND_MAX / rand_col_num);
-			break;
-		case SIS_TEXT_MAP:
-			SISBuffer[i] = ReadTPixel(LineNumber % Theight, i % Twidth);
+			SISBuffer[i] = SISRand() / (RAND_MAX / sis->rand_col_num);
 			break;
 		}
 	}
 }
 
 
+/// Bytes of a rendered row as SaveSISRow() stores it
+size_t
+SISRowSize(void)
+{
+	return virtual_width() * sizeof(col_t) + sis->SISwidth * sizeof(col_rgb_t);
+}
+
+
+/// Store the row that has been rendered last, so that it can be written
+/// again later with RestoreSISRow() instead of rendering it again
+void
+SaveSISRow(unsigned char *dst)
+{
+	memcpy(dst, SISBuffer, virtual_width() * sizeof(col_t));
+	memcpy(dst + virtual_width() * sizeof(col_t), SIScolorRGB, sis->SISwidth * sizeof(col_rgb_t));
+}
+
+
+void
+RestoreSISRow(const unsigned char *src)
+{
+	memcpy(SISBuffer, src, virtual_width() * sizeof(col_t));
+	memcpy(SIScolorRGB, src + virtual_width() * sizeof(col_t), sis->SISwidth * sizeof(col_rgb_t));
+}
+
+
+/// Number of colors of the SIS with black, if the triangles or the random
+/// dots use it
+int
+OutputColorCount(void)
+{
+	bool with_black = sis->mark || (sis->SIStype == SIS_RANDOM_GREY && sis->rand_grey_num == 2);
+	switch (sis->SIStype) {
+	case SIS_RANDOM_GREY:
+		return sis->rand_grey_num + with_black;
+	case SIS_RANDOM_COLOR:
+		return sis->rand_col_num + with_black;
+	default:
+		return sis->direct_rgb ? INT_MAX : sis->Tcolcount + with_black;
+	}
+}
+
+
+/// Set the palette of indexed output files from the color palette, after
+/// InitAlgorithm()
+void
+InitOutputPalette(void)
+{
+	sis->SISPaletteSize = OutputColorCount();
+	sis->index_count = sis->SIStype == SIS_RANDOM_GREY ? sis->rand_grey_num
+	            : sis->SIStype == SIS_RANDOM_COLOR ? sis->rand_col_num : sis->Tcolcount;
+	sis->index_black = sis->SISPaletteSize - 1;
+	for (int i = 0; i < sis->SISPaletteSize; i++) {
+		col_t c = i < sis->index_count ? (col_t)i : sis->black;
+		/// Same 8-bit colors as in the RGB output
+		sis->SISPalette[3 * i + 0] = (unsigned char)sis->SISred[c];
+		sis->SISPalette[3 * i + 1] = (unsigned char)sis->SISgreen[c];
+		sis->SISPalette[3 * i + 2] = (unsigned char)sis->SISblue[c];
+	}
+}
+
+
+/// Palette indices into SISPalette of the row that has been rendered last
+void
+GatherIndexRow(unsigned char *dst, ind_t LineNumber)
+{
+	/// The middle of the oversampled dots, as in nearest_row()
+	int factor = sis->algorithm == 4 ? sis->oversam : 1;
+	const col_t *src = SISBuffer + factor / 2;
+	for (ind_t x = 0; x < sis->SISwidth; x++) {
+		col_t c = src[x * factor];
+		dst[x] = c == sis->black ? sis->index_black : c < (col_t)sis->index_count ? c : sis->index_count - 1;
+	}
+	if (sis->mark) {
+		for (ind_t i = triangle_size(LineNumber); i >= 0; i--) {
+			dst[(sis->SISwidth >> 1) - sis->halfstripwidth - i] = sis->index_black;
+			dst[(sis->SISwidth >> 1) - sis->halfstripwidth + i] = sis->index_black;
+			dst[(sis->SISwidth >> 1) + sis->halfstripwidth - i] = sis->index_black;
+			dst[(sis->SISwidth >> 1) + sis->halfstripwidth + i] = sis->index_black;
+		}
+	}
+}
+
+
+/// Black and white random dots (-d or -g 2)
+bool
+BilevelOutput(void)
+{
+	return sis->SIStype == SIS_RANDOM_GREY && sis->rand_grey_num == 2;
+}
+
+
+/// Row of black and white dots packed into bits, most significant bit
+/// first, black dots are black_bit
+void
+GatherBitRow(unsigned char *dst, ind_t LineNumber, int black_bit)
+{
+	int factor = sis->algorithm == 4 ? sis->oversam : 1;
+	const col_t *src = SISBuffer + factor / 2;
+	unsigned char bits = 0;
+	ind_t x;
+	for (x = 0; x < sis->SISwidth; x++) {
+		bits = bits << 1 | ((src[x * factor] == sis->black) == black_bit);
+		if ((x & 7) == 7)
+			dst[x >> 3] = bits;
+	}
+	/// The unused bits of the last byte are white
+	if (x & 7)
+		dst[x >> 3] = (bits << (8 - (x & 7))) | (black_bit ? 0 : 0xff >> (x & 7));
+	if (sis->mark) {
+		for (ind_t i = triangle_size(LineNumber); i >= 0; i--) {
+			ind_t dots[4] = {
+				(sis->SISwidth >> 1) - sis->halfstripwidth - i, (sis->SISwidth >> 1) - sis->halfstripwidth + i,
+				(sis->SISwidth >> 1) + sis->halfstripwidth - i, (sis->SISwidth >> 1) + sis->halfstripwidth + i
+			};
+			for (int k = 0; k < 4; k++) {
+				unsigned char bit = 0x80 >> (dots[k] & 7);
+				if (black_bit)
+					dst[dots[k] >> 3] |= bit;
+				else
+					dst[dots[k] >> 3] &= ~bit;
+			}
+		}
+	}
+}
+
+
+static void FillRGBBufferSubpixel(ind_t LineNumber);
+
 void
 FillRGBBuffer(ind_t LineNumber)
 {
 	ind_t i;
+	if (sis->subpixel) {
+		FillRGBBufferSubpixel(LineNumber);
+		return;
+	}
 	/// Set the color of two corresponding pixels to the same value.
 	/// right half:
-	for (i = origin; i < SISwidth; i++) {
+	for (i = sis->origin; i < sis->SISwidth; i++) {
 		if (IdentBuffer[i] != i)
 			SISBuffer[i] = SISBuffer[IdentBuffer[i]];
 	}
 
 	/// Left half:
-	for (i = origin - 1; i >= 0; i--) {
+	for (i = sis->origin - 1; i >= 0; i--) {
 		if (IdentBuffer[i] != i)
 			SISBuffer[i] = SISBuffer[IdentBuffer[i]];
 	}
 	/// Fill the RGB buffer for writing to the output image
-	for (i = 0; i < SISwidth; i++) {
-		col_rgb_t colrgb = { SISred[SISBuffer[i]], SISgreen[SISBuffer[i]], SISblue[SISBuffer[i]] };
-		SIScolorRGB[i] = colrgb;
+	sis->GatherPaletteRow(SIScolorRGB, SISBuffer, sis->SISwidth);
+	if (sis->mark) AddTriangles(LineNumber);
+}
+
+
+/// Fraction of the subpixel link of pixel i that is used for its color
+static int
+link_fraction(ind_t i)
+{
+	ind_t link = IdentBuffer[i];
+	/// Don't interpolate with the pixel itself or beyond the row
+	if (link + 1 == i || link + 1 >= sis->SISwidth)
+		return 0;
+	return IdentFrac[i];
+}
+
+
+/// Interpolate the color of pixel i at the subpixel position it is linked to
+static void
+link_subpixel(ind_t i)
+{
+	ind_t link = IdentBuffer[i];
+	int frac = link_fraction(i);
+	col_rgb_t a = SIScolorRGB[link];
+	col_rgb_t b = SIScolorRGB[link + (frac != 0)];
+	SIScolorRGB[i].r = a.r + (((b.r - a.r) * frac) >> SIS_SUBPIX_BITS);
+	SIScolorRGB[i].g = a.g + (((b.g - a.g) * frac) >> SIS_SUBPIX_BITS);
+	SIScolorRGB[i].b = a.b + (((b.b - a.b) * frac) >> SIS_SUBPIX_BITS);
+	/// Keep the palette index of the nearest pixel
+	SISBuffer[i] = SISBuffer[link + (frac >= SIS_SUBPIX_ONE / 2)];
+}
+
+
+/// Like FillRGBBuffer() but the colors of linked pixels are interpolated
+/// from their subpixel positions
+static void
+FillRGBBufferSubpixel(ind_t LineNumber)
+{
+	ind_t i;
+	/// Random dots keep the number of colors that was asked for, they take
+	/// the color of the nearest pixel instead
+	if (sis->SIStype != SIS_TEXT_MAP) {
+		for (i = sis->origin; i < sis->SISwidth; i++) {
+			if (IdentBuffer[i] != i)
+				SISBuffer[i] = SISBuffer[IdentBuffer[i] + (link_fraction(i) >= SIS_SUBPIX_ONE / 2)];
+		}
+		for (i = sis->origin - 1; i >= 0; i--) {
+			if (IdentBuffer[i] != i)
+				SISBuffer[i] = SISBuffer[IdentBuffer[i] + (link_fraction(i) >= SIS_SUBPIX_ONE / 2)];
+		}
+		sis->GatherPaletteRow(SIScolorRGB, SISBuffer, sis->SISwidth);
+		if (sis->mark) AddTriangles(LineNumber);
+		return;
+	}
+	sis->GatherPaletteRow(SIScolorRGB, SISBuffer, sis->SISwidth);
+	for (i = sis->origin; i < sis->SISwidth; i++) {
+		if (IdentBuffer[i] != i)
+			link_subpixel(i);
 	}
-	if (mark) AddTriangles(LineNumber);
+	for (i = sis->origin - 1; i >= 0; i--) {
+		if (IdentBuffer[i] != i)
+			link_subpixel(i);
+	}
+	if (sis->mark) AddTriangles(LineNumber);
 }
 
 
@@ -492,14 +850,14 @@ col_t
 get_pixel_from_pattern(int x, int y)
 {
 	col_t ret = {0};
-	switch (SIStype) {
+	switch (sis->SIStype) {
 	case SIS_RANDOM_GREY:
 	case SIS_RANDOM_COLOR:
 		ret = SISBuffer[x];
 		// ret = random_texture[y % random_texture_size][x % random_texture_size];
 		break;
 	case SIS_TEXT_MAP:
-		ret = ReadTPixel(y % Theight, x % Twidth);
+		ret = sis->ReadTPixel(y % sis->Theight, x % sis->Twidth);
 		break;
 	}
 	// ret = ReadTPixel(y % Theight, x % Twidth);
@@ -508,27 +866,23 @@ get_pixel_from_pattern(int x, int y)
 }
 
 
-/// Oversampling ratio
-int oversam;
-
 void
 asteer(ind_t LineNumber)
 {
 	// int obsDist  = 1500;   /// original distance from viewer to screen
 	// int maxdepth = 675;    /// original distance from screen to far plane
-	int obsDist  = SIS_MAX_DEPTH / u;          /// distance from viewer to screen
-	int maxdepth = SIS_MAX_DEPTH / (u * t);    /// distance from screen to far plane
+	int obsDist  = SIS_MAX_DEPTH / sis->u;          /// distance from viewer to screen
+	int maxdepth = SIS_MAX_DEPTH / (sis->u * sis->t);    /// distance from screen to far plane
 	int lastlinked;
-	int i;
 	/// Shift texture map 4 pixels in vertical direction
 	int yShift = 4;
 	/// Pattern must be at least this wide
-	int maxsep = (int)(((long)eye_dist * oversam * maxdepth) / (maxdepth + obsDist));
-	int vmaxsep = oversam * maxsep;
-	int vwidth = SISwidth * oversam;
+	int maxsep = (int)(((long)sis->eye_dist * sis->oversam * maxdepth) / (maxdepth + obsDist));
+	int vmaxsep = sis->oversam * maxsep;
+	int vwidth = sis->SISwidth * sis->oversam;
 	int start = vwidth / 2 - vmaxsep / 2;
-	if (origin != -1) {
-		start = origin * oversam;
+	if (sis->origin != -1) {
+		start = sis->origin * sis->oversam;
 	}
 	int poffset = vmaxsep - (start % vmaxsep);
 	int sep = 0;
@@ -561,7 +915,7 @@ asteer(ind_t LineNumber)
 	/// Set indices of identical color pixels in 'virtual' buffer based on
 	/// eye separation and depth value
 	for (x = 0; x < vwidth; x++) {
-		if ((x % oversam) == 0) // speedup for oversampled pictures
+		if ((x % sis->oversam) == 0) // speedup for oversampled pictures
 		{
 	        // featureZ = maxdepth - DBuffer[x / oversam] * maxdepth / 256;
 	        // featureZ = maxdepth - zvalue[x / oversam] * maxdepth / 256;
@@ -569,8 +923,8 @@ asteer(ind_t LineNumber)
             // printf("sep: %d\n", sep);
 
             // sep = separation[x / oversam];
-            ind_t DBufInd = (x / oversam) * DBufStep;
-            sep = separation[DBuffer[DBufInd]];
+            ind_t DBufInd = sis->DColumn[x / sis->oversam];
+            sep = sis->separation[DBuffer[DBufInd]];
 		}
 		left = x - sep / 2;
 		right = left + sep;
@@ -615,8 +969,8 @@ asteer(ind_t LineNumber)
 				SISBuffer[x] = SISBuffer[x - 1];
 			else {
 				SISBuffer[x] = get_pixel_from_pattern(
-				  ((x + poffset) % vmaxsep) / oversam,
-				   (LineNumber + ((x - start) / vmaxsep) * yShift) % Theight);
+				  ((x + poffset) % vmaxsep) / sis->oversam,
+				   (LineNumber + ((x - start) / vmaxsep) * yShift) % sis->Theight);
 			}
 		} else {
 			SISBuffer[x] = SISBuffer[lookL[x]];
@@ -631,8 +985,8 @@ asteer(ind_t LineNumber)
 				SISBuffer[x] = SISBuffer[x + 1];
 			else {
 				SISBuffer[x] = get_pixel_from_pattern(
-				  ((x + poffset) % vmaxsep) / oversam,
-				  (LineNumber + ((start - x) / vmaxsep + 1) * yShift) % Theight);
+				  ((x + poffset) % vmaxsep) / sis->oversam,
+				  (LineNumber + ((start - x) / vmaxsep + 1) * yShift) % sis->Theight);
 			}
 		} else {
 			SISBuffer[x] = SISBuffer[lookR[x]];
@@ -640,23 +994,206 @@ asteer(ind_t LineNumber)
 		}
 	}
 
-	int red, green, blue;
-	for (x = 0; x < vwidth; x += oversam) {
-		red = 0;
-		green = 0;
-		blue = 0;
-		/// Use average color of virtual pixels for screen pixel
-		for (i = x; i < (x + oversam); i++) {
-			/// Get RGB colors for color palette index col and sum them up
-			red += SISred[SISBuffer[i]];
-			green += SISgreen[SISBuffer[i]];
-			blue += SISblue[SISBuffer[i]];
-		}
-		col_rgb_t colrgb = { red / oversam, green / oversam, blue / oversam };
-		SIScolorRGB[x / oversam] = colrgb;
-	}
-	if (mark) AddTriangles(LineNumber);
+	/// Use average color of virtual pixels for screen pixel
+	sis->AverageRow(SIScolorRGB, SISBuffer, sis->SISwidth, sis->oversam);
+	if (sis->mark) AddTriangles(LineNumber);
 
 	// free(lookL);
 	// free(lookR);
 }
+
+
+/*
+ * Row kernels, each one is compiled for several instruction sets (see cpu.c)
+ */
+
+/// Copy one row of 8-bit depth values into DBuffer and find their range
+SIS_KERNEL_BODY void
+ingest_depth_row_body(col_t *restrict dst, const uint8_t *restrict src, ind_t n,
+                      col_t *lo, col_t *hi)
+{
+	uint8_t l = UINT8_MAX, h = 0;
+	for (ind_t i = 0; i < n; i++) {
+		uint8_t v = src[i];
+		dst[i] = v;
+		l = v < l ? v : l;
+		h = v > h ? v : h;
+	}
+	*lo = l;
+	*hi = h;
+}
+
+SIS_KERNEL_VARIANTS(ingest_depth_row,
+  (col_t *restrict dst, const uint8_t *restrict src, ind_t n, col_t *lo, col_t *hi),
+  (dst, src, n, lo, hi))
+
+
+/// Copy one row of 16-bit depth values into DBuffer and find their range
+SIS_KERNEL_BODY void
+ingest_depth_row16_body(col_t *restrict dst, const uint16_t *restrict src, ind_t n,
+                        col_t *lo, col_t *hi)
+{
+	uint16_t l = UINT16_MAX, h = 0;
+	for (ind_t i = 0; i < n; i++) {
+		uint16_t v = src[i];
+		dst[i] = v;
+		l = v < l ? v : l;
+		h = v > h ? v : h;
+	}
+	*lo = l;
+	*hi = h;
+}
+
+SIS_KERNEL_VARIANTS(ingest_depth_row16,
+  (col_t *restrict dst, const uint16_t *restrict src, ind_t n, col_t *lo, col_t *hi),
+  (dst, src, n, lo, hi))
+
+
+/// Tile a row of texture color indices over the SIS row
+SIS_KERNEL_BODY void
+fill_texture_row_body(col_t *restrict dst, const col_t *restrict src, ind_t twidth, ind_t n)
+{
+	for (ind_t i = 0; i < n; i += twidth) {
+		ind_t len = (n - i < twidth) ? n - i : twidth;
+		for (ind_t j = 0; j < len; j++)
+			dst[i + j] = src[j];
+	}
+}
+
+SIS_KERNEL_VARIANTS(fill_texture_row,
+  (col_t *restrict dst, const col_t *restrict src, ind_t twidth, ind_t n),
+  (dst, src, twidth, n))
+
+
+/// Look up the RGB colors of a row of palette indices
+SIS_KERNEL_BODY void
+gather_palette_row_body(col_rgb_t *restrict dst, const col_t *restrict src, ind_t n)
+{
+	const cmap_t *restrict red = sis->SISred;
+	const cmap_t *restrict green = sis->SISgreen;
+	const cmap_t *restrict blue = sis->SISblue;
+	for (ind_t i = 0; i < n; i++) {
+		col_t c = src[i];
+		dst[i].r = red[c];
+		dst[i].g = green[c];
+		dst[i].b = blue[c];
+	}
+}
+
+SIS_KERNEL_VARIANTS(gather_palette_row,
+  (col_rgb_t *restrict dst, const col_t *restrict src, ind_t n),
+  (dst, src, n))
+
+
+/// Average each factor palette indices of an oversampled row to one RGB color
+SIS_KERNEL_BODY void
+average_row_body(col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor)
+{
+	const cmap_t *restrict red = sis->SISred;
+	const cmap_t *restrict green = sis->SISgreen;
+	const cmap_t *restrict blue = sis->SISblue;
+	for (ind_t x = 0; x < width; x++) {
+		int r = 0, g = 0, b = 0;
+		for (int i = 0; i < factor; i++) {
+			col_t c = src[x * factor + i];
+			r += red[c];
+			g += green[c];
+			b += blue[c];
+		}
+		dst[x].r = r / factor;
+		dst[x].g = g / factor;
+		dst[x].b = b / factor;
+	}
+}
+
+SIS_KERNEL_VARIANTS(average_row,
+  (col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor),
+  (dst, src, width, factor))
+
+
+/// Take the middle one of each factor palette indices of an oversampled row,
+/// colors are not averaged with --indexed
+SIS_KERNEL_BODY void
+nearest_row_body(col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor)
+{
+	const cmap_t *restrict red = sis->SISred;
+	const cmap_t *restrict green = sis->SISgreen;
+	const cmap_t *restrict blue = sis->SISblue;
+	src += factor / 2;
+	for (ind_t x = 0; x < width; x++) {
+		col_t c = src[x * factor];
+		dst[x].r = red[c];
+		dst[x].g = green[c];
+		dst[x].b = blue[c];
+	}
+}
+
+SIS_KERNEL_VARIANTS(nearest_row,
+  (col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor),
+  (dst, src, width, factor))
+
+
+/// Unpack a row of packed RGB texture colors
+SIS_KERNEL_BODY void
+unpack_rgb_row_body(col_rgb_t *restrict dst, const col_t *restrict src, ind_t n)
+{
+	for (ind_t i = 0; i < n; i++) {
+		col_t c = src[i];
+		dst[i].r = SIS_RGB_R(c);
+		dst[i].g = SIS_RGB_G(c);
+		dst[i].b = SIS_RGB_B(c);
+	}
+}
+
+SIS_KERNEL_VARIANTS(unpack_rgb_row,
+  (col_rgb_t *restrict dst, const col_t *restrict src, ind_t n),
+  (dst, src, n))
+
+
+/// Average each factor packed RGB colors of an oversampled row to one RGB color
+SIS_KERNEL_BODY void
+average_rgb_row_body(col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor)
+{
+	for (ind_t x = 0; x < width; x++) {
+		int r = 0, g = 0, b = 0;
+		for (int i = 0; i < factor; i++) {
+			col_t c = src[x * factor + i];
+			r += SIS_RGB_R(c);
+			g += SIS_RGB_G(c);
+			b += SIS_RGB_B(c);
+		}
+		dst[x].r = r / factor;
+		dst[x].g = g / factor;
+		dst[x].b = b / factor;
+	}
+}
+
+SIS_KERNEL_VARIANTS(average_rgb_row,
+  (col_rgb_t *restrict dst, const col_t *restrict src, ind_t width, int factor),
+  (dst, src, width, factor))
+
+
+void
+InitKernels(void)
+{
+	InitCPU();
+	SIS_KERNEL_SELECT(sis->IngestDepthRow, ingest_depth_row, "depth ingest:");
+	SIS_KERNEL_SELECT(sis->IngestDepthRow16, ingest_depth_row16, "depth ingest 16:");
+	SIS_KERNEL_SELECT(sis->CalcIdentLine, calc_ident_line, "ident line:");
+	SIS_KERNEL_SELECT(sis->FillTextureRow, fill_texture_row, "texture fill:");
+	if (sis->texture_pattern && sis->SIStype == SIS_TEXT_MAP)
+		InitPatternKernel();
+	if (sis->depth_prep)
+		InitDepthPrepKernel();
+	if (sis->direct_rgb && sis->SIStype == SIS_TEXT_MAP) {
+		/// SISBuffer holds packed RGB colors instead of palette indices
+		SIS_KERNEL_SELECT(sis->GatherPaletteRow, unpack_rgb_row, "rgb unpack:");
+		SIS_KERNEL_SELECT(sis->AverageRow, average_rgb_row, "oversampling:");
+	} else {
+		SIS_KERNEL_SELECT(sis->GatherPaletteRow, gather_palette_row, "palette gather:");
+		if (sis->indexed_output)
+			SIS_KERNEL_SELECT(sis->AverageRow, nearest_row, "oversampling:");
+		else
+			SIS_KERNEL_SELECT(sis->AverageRow, average_row, "oversampling:");
+	}
+}
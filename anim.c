@@ -0,0 +1,199 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "anim.h"
+#include "png.h"
+#include "gif.h"
+#include "sequence.h"
+
+/*
+
+Animated png (apng) and gif files of depth map sequences.
+
+The frames are written while the sequence is rendered. Only the current and
+the previous frame are kept. The first frame is written as a whole, each
+other frame only as the rectangle around the pixels that differ from the
+previous frame, which stays on the screen around it.
+
+gif files use the palette of indexed output, which is chosen for them if
+the SIS has at most 256 colors (random dots or a texture with few colors).
+Otherwise the colors are mapped to the gif color cube.
+
+*/
+
+static bool gif;
+static ind_t anim_width, anim_height;
+/// Pixels of the current and the previous frame, in the pixel format of the
+/// file (bits, palette indices or RGB)
+static unsigned char *cur_frame, *prev_frame;
+static size_t frame_row_bytes;
+/// Bytes per pixel, 0 for 8 pixels per byte
+static int frame_bpp;
+static long frames_written;
+
+
+void
+Anim_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	long frames = sequence ? sequence_frames : 1;
+	gif = sis->ImgFileFormat == SIS_IMGFMT_GIF;
+	anim_width = width;
+	anim_height = height;
+	frame_bpp = gif || sis->SISPixelFormat == SIS_PIXFMT_INDEXED ? 1
+	          : sis->SISPixelFormat == SIS_PIXFMT_BILEVEL ? 0 : 3;
+	frame_row_bytes = frame_bpp ? width * frame_bpp : (width + 7) / 8;
+	cur_frame = (unsigned char *)malloc(frame_row_bytes * height);
+	prev_frame = (unsigned char *)malloc(frame_row_bytes * height);
+	if (!cur_frame || !prev_frame) {
+		fprintf(stderr, "Failed to allocate animation frame buffers.\n");
+		SISExit(1);
+	}
+	frames_written = 0;
+	if (!gif) {
+		ApngOpen(sis->SISFileName, width, height, sis->SISPixelFormat, frames, sis->anim_fps);
+	} else if (sis->SISPixelFormat == SIS_PIXFMT_INDEXED) {
+		GifOpen(sis->SISFileName, width, height, sis->SISPalette, sis->SISPaletteSize, frames,
+		        (100 + sis->anim_fps / 2) / sis->anim_fps);
+	} else {
+		unsigned char palette[3 * GIF_CUBE_COLORS];
+		GifCubePalette(palette);
+		GifOpen(sis->SISFileName, width, height, palette, GIF_CUBE_COLORS, frames,
+		        (100 + sis->anim_fps / 2) / sis->anim_fps);
+	}
+}
+
+
+void
+Anim_WriteSISColorBuffer(ind_t r)
+{
+	unsigned char *row = cur_frame + r * frame_row_bytes;
+	if (sis->SISPixelFormat == SIS_PIXFMT_BILEVEL) {
+		/// Black is 0 in grey png files
+		GatherBitRow(row, r, 0);
+	} else if (sis->SISPixelFormat == SIS_PIXFMT_INDEXED) {
+		GatherIndexRow(row, r);
+	} else if (gif) {
+		for (ind_t c = 0; c < anim_width; c++)
+			row[c] = GifCubeIndex(SIScolorRGB[c].r, SIScolorRGB[c].g, SIScolorRGB[c].b);
+	} else {
+		for (ind_t c = 0; c < anim_width; c++) {
+			row[3 * c + 0] = SIScolorRGB[c].r;
+			row[3 * c + 1] = SIScolorRGB[c].g;
+			row[3 * c + 2] = SIScolorRGB[c].b;
+		}
+	}
+}
+
+
+/// Bytes [*left, *right] of rows [*top, *bottom] contain all differences of
+/// the current frame from the previous one, false if there are none
+static bool
+changed_region(ind_t *top, ind_t *bottom, size_t *left, size_t *right)
+{
+	ind_t r;
+	for (r = 0; r < anim_height; r++) {
+		if (memcmp(cur_frame + r * frame_row_bytes, prev_frame + r * frame_row_bytes, frame_row_bytes))
+			break;
+	}
+	if (r == anim_height)
+		return false;
+	*top = r;
+	for (r = anim_height - 1; r > *top; r--) {
+		if (memcmp(cur_frame + r * frame_row_bytes, prev_frame + r * frame_row_bytes, frame_row_bytes))
+			break;
+	}
+	*bottom = r;
+	*left = frame_row_bytes - 1;
+	*right = 0;
+	for (r = *top; r <= *bottom; r++) {
+		const unsigned char *a = cur_frame + r * frame_row_bytes;
+		const unsigned char *b = prev_frame + r * frame_row_bytes;
+		size_t i;
+		for (i = 0; i < *left && a[i] == b[i]; i++)
+			;
+		*left = i;
+		for (i = frame_row_bytes - 1; i > *right && a[i] == b[i]; i--)
+			;
+		*right = i;
+	}
+	return true;
+}
+
+
+/// Write the frame that has been rendered
+void
+Anim_WriteSISFile(void)
+{
+	ind_t x = 0, y = 0, width = anim_width, height = anim_height;
+	ind_t bottom;
+	size_t left = 0, right;
+	if (frames_written && !changed_region(&y, &bottom, &left, &right)) {
+		/// The frame still has to be shown for its time
+		width = height = 1;
+	} else if (frames_written) {
+		height = bottom - y + 1;
+		if (frame_bpp) {
+			x = left / frame_bpp;
+			width = right / frame_bpp + 1 - x;
+		} else {
+			/// Rectangles of packed bits start at a whole byte
+			x = left * 8;
+			width = ((ind_t)right + 1) * 8 < anim_width ? ((ind_t)right + 1) * 8 - x : anim_width - x;
+		}
+	}
+	const unsigned char *pix = cur_frame + y * frame_row_bytes
+	                         + (frame_bpp ? x * frame_bpp : x / 8);
+	if (gif)
+		GifWriteFrame(pix, frame_row_bytes, x, y, width, height);
+	else
+		ApngWriteFrame(pix, frame_row_bytes, x, y, width, height);
+	unsigned char *tmp = prev_frame;
+	prev_frame = cur_frame;
+	cur_frame = tmp;
+	frames_written++;
+}
+
+
+void
+Anim_CloseSISFile(void)
+{
+	if (gif)
+		GifClose();
+	else
+		ApngClose();
+	free(cur_frame);
+	free(prev_frame);
+	cur_frame = prev_frame = NULL;
+}
+
+
+/// The frames are never kept in memory as a whole image
+unsigned char *
+Anim_GetSISFileBuffer(void)
+{
+	return NULL;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sis.h"
+
+#if defined(__arm__) && defined(__linux__) && defined(SIS_DISPATCH_ARM)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*
+
+CPU feature detection for the row kernels.
+
+Each row kernel is compiled once for every instruction set level that the
+compiler supports on the build target (see SIS_KERNEL_VARIANTS in sis.h).
+At startup the best level that the running CPU supports is detected and the
+kernel function pointers are set to the matching variants. One binary runs
+on all machines and still uses the vector units of the newer ones.
+
+*/
+
+static const char *cpu_level_names[] = {
+	[SIS_CPU_GENERIC] = "generic",
+	[SIS_CPU_SSE2]    = "sse2",
+	[SIS_CPU_AVX2]    = "avx2",
+	[SIS_CPU_AVX512]  = "avx512",
+	[SIS_CPU_NEON]    = "neon",
+};
+
+
+static int
+detect_cpu_level(void)
+{
+#if defined(SIS_DISPATCH_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		return SIS_CPU_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIS_CPU_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIS_CPU_SSE2;
+#elif defined(__aarch64__)
+	/// NEON is mandatory on aarch64
+	return SIS_CPU_NEON;
+#elif defined(SIS_DISPATCH_ARM)
+	if (getauxval(AT_HWCAP) & HWCAP_NEON)
+		return SIS_CPU_NEON;
+#endif
+	return SIS_CPU_GENERIC;
+}
+
+
+void
+InitCPU(void)
+{
+	sis->kernel_count = 0;
+	sis->cpu_level = detect_cpu_level();
+	/// Forcing a level the CPU doesn't support would crash with illegal instructions
+	if (sis->cpu_level_forced >= 0 && sis->cpu_level_forced <= sis->cpu_level) {
+		sis->cpu_level = sis->cpu_level_forced;
+	}
+}
+
+
+const char *
+cpu_level_name(int level)
+{
+	if (level < SIS_CPU_GENERIC || level > SIS_CPU_NEON)
+		return "unknown";
+	return cpu_level_names[level];
+}
+
+
+int
+cpu_level_from_name(const char *name)
+{
+	for (int level = SIS_CPU_GENERIC; level <= SIS_CPU_NEON; level++) {
+		if (!strcmp(name, cpu_level_names[level]))
+			return level;
+	}
+	return -1;
+}
+
+
+void
+ReportKernel(const char *name, int level)
+{
+	for (int i = 0; i < sis->kernel_count; i++) {
+		if (!strcmp(sis->kernel_names[i], name)) {
+			sis->kernel_levels[i] = level;
+			return;
+		}
+	}
+	if (sis->kernel_count < SIS_MAX_KERNELS) {
+		sis->kernel_names[sis->kernel_count] = name;
+		sis->kernel_levels[sis->kernel_count] = level;
+		sis->kernel_count++;
+	}
+}
+
+
+void
+PrintKernels(void)
+{
+	printf("  CPU:            %s\n", cpu_level_name(sis->cpu_level));
+	for (int i = 0; i < sis->kernel_count; i++) {
+		printf("  %-16s%s\n", sis->kernel_names[i], cpu_level_name(sis->kernel_levels[i]));
+	}
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+
+/*
+
+Deflate compressor (RFC 1951) for the image writers.
+
+The data is compressed in bands. Each band is LZ77 compressed on its own and
+coded with the fixed Huffman codes. It ends with an empty stored block, like
+the sync flush of zlib, so the compressed bands end on byte boundaries and
+can be written out (or concatenated) as soon as they are done. Matches don't
+reach back into the previous band, which costs a bit of compression but only
+keeps one band of uncompressed data in memory.
+
+*/
+
+#define WINDOW_SIZE   32768
+#define HASH_BITS     15
+#define MIN_MATCH     3
+#define MAX_MATCH     258
+
+/// Maximum number of hash chain entries searched for a match per level
+static const int chain_limit[] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+
+static const uint16_t length_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+
+static void
+put_byte(deflate_t *d, unsigned char b)
+{
+	if (d->len == d->cap) {
+		d->cap = d->cap ? 2 * d->cap : 65536;
+		if (!(d->data = (unsigned char *)realloc(d->data, d->cap))) {
+			fprintf(stderr, "Failed to allocate compression buffer.\n");
+			SISExit(1);
+		}
+	}
+	d->data[d->len++] = b;
+}
+
+
+/// Append count bits of value, the least significant bit first
+static void
+put_bits(deflate_t *d, uint32_t value, int count)
+{
+	d->bits |= value << d->bit_count;
+	d->bit_count += count;
+	while (d->bit_count >= 8) {
+		put_byte(d, d->bits & 0xff);
+		d->bits >>= 8;
+		d->bit_count -= 8;
+	}
+}
+
+
+/// Huffman codes are stored with the most significant bit first
+static void
+put_code(deflate_t *d, uint32_t code, int count)
+{
+	uint32_t rev = 0;
+	for (int i = 0; i < count; i++) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+	}
+	put_bits(d, rev, count);
+}
+
+
+static void
+put_literal(deflate_t *d, int sym)
+{
+	if (sym < 144)
+		put_code(d, 0x30 + sym, 8);
+	else if (sym < 256)
+		put_code(d, 0x190 + sym - 144, 9);
+	else if (sym < 280)
+		put_code(d, sym - 256, 7);
+	else
+		put_code(d, 0xc0 + sym - 280, 8);
+}
+
+
+static void
+put_match(deflate_t *d, int len, int dist)
+{
+	int i = 0;
+	while (i < 28 && length_base[i + 1] <= len)
+		i++;
+	put_literal(d, 257 + i);
+	put_bits(d, len - length_base[i], length_extra[i]);
+	int j = 0;
+	while (j < 29 && dist_base[j + 1] <= dist)
+		j++;
+	put_code(d, j, 5);
+	put_bits(d, dist - dist_base[j], dist_extra[j]);
+}
+
+
+/// Write out the pending bits, padded to a byte boundary
+static void
+align_bits(deflate_t *d)
+{
+	if (d->bit_count > 0)
+		put_byte(d, d->bits & 0xff);
+	d->bits = 0;
+	d->bit_count = 0;
+}
+
+
+static inline uint32_t
+hash3(const unsigned char *p)
+{
+	uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+void
+DeflateInit(deflate_t *d, int level)
+{
+	memset(d, 0, sizeof(*d));
+	d->level = level < 0 ? 0 : level > 9 ? 9 : level;
+	if (d->level > 0) {
+		d->head = (int32_t *)malloc((1 << HASH_BITS) * sizeof(int32_t));
+		d->prev = (int32_t *)malloc(WINDOW_SIZE * sizeof(int32_t));
+		if (!d->head || !d->prev) {
+			fprintf(stderr, "Failed to allocate compression buffer.\n");
+			SISExit(1);
+		}
+	}
+}
+
+
+void
+DeflateFree(deflate_t *d)
+{
+	free(d->data);
+	free(d->head);
+	free(d->prev);
+	memset(d, 0, sizeof(*d));
+}
+
+
+static void
+deflate_stored(deflate_t *d, const unsigned char *src, size_t n)
+{
+	while (n > 0) {
+		size_t len = n < 0xffff ? n : 0xffff;
+		put_bits(d, 0, 1);
+		put_bits(d, 0, 2);
+		align_bits(d);
+		put_byte(d, len & 0xff);
+		put_byte(d, len >> 8);
+		put_byte(d, ~len & 0xff);
+		put_byte(d, (~len >> 8) & 0xff);
+		for (size_t i = 0; i < len; i++)
+			put_byte(d, src[i]);
+		src += len;
+		n -= len;
+	}
+}
+
+
+static void
+deflate_fixed(deflate_t *d, const unsigned char *src, size_t n)
+{
+	const int max_chain = chain_limit[d->level];
+	/// Positions in the chains are band offsets + 1, 0 is the end of a chain
+	memset(d->head, 0, (1 << HASH_BITS) * sizeof(int32_t));
+	put_bits(d, 0, 1);
+	put_bits(d, 1, 2);
+	size_t i = 0;
+	while (i < n) {
+		int best_len = 0, best_dist = 0;
+		if (i + MIN_MATCH <= n) {
+			uint32_t h = hash3(src + i);
+			size_t max_len = n - i < MAX_MATCH ? n - i : MAX_MATCH;
+			int32_t cand = d->head[h];
+			for (int chain = 0; cand && chain < max_chain; chain++) {
+				size_t pos = cand - 1;
+				if (i - pos > WINDOW_SIZE)
+					break;
+				if (src[pos + best_len] == src[i + best_len]) {
+					size_t len = 0;
+					while (len < max_len && src[pos + len] == src[i + len])
+						len++;
+					if ((int)len > best_len) {
+						best_len = len;
+						best_dist = i - pos;
+						if (len == max_len)
+							break;
+					}
+				}
+				cand = d->prev[pos & (WINDOW_SIZE - 1)];
+			}
+			d->prev[i & (WINDOW_SIZE - 1)] = d->head[h];
+			d->head[h] = i + 1;
+		}
+		if (best_len >= MIN_MATCH) {
+			put_match(d, best_len, best_dist);
+			/// Insert the positions inside the match into the hash chains
+			for (size_t j = i + 1; j < i + best_len && j + MIN_MATCH <= n; j++) {
+				uint32_t h = hash3(src + j);
+				d->prev[j & (WINDOW_SIZE - 1)] = d->head[h];
+				d->head[h] = j + 1;
+			}
+			i += best_len;
+		} else {
+			put_literal(d, src[i]);
+			i++;
+		}
+	}
+	put_literal(d, 256);
+}
+
+
+void
+DeflateBand(deflate_t *d, const unsigned char *src, size_t n)
+{
+	if (n == 0)
+		return;
+	if (d->level == 0)
+		deflate_stored(d, src, n);
+	else
+		deflate_fixed(d, src, n);
+	/// End the band with an empty stored block on a byte boundary
+	put_bits(d, 0, 1);
+	put_bits(d, 0, 2);
+	align_bits(d);
+	put_byte(d, 0x00);
+	put_byte(d, 0x00);
+	put_byte(d, 0xff);
+	put_byte(d, 0xff);
+}
+
+
+void
+DeflateFinish(deflate_t *d)
+{
+	/// Empty final block with fixed Huffman codes
+	put_bits(d, 1, 1);
+	put_bits(d, 1, 2);
+	put_literal(d, 256);
+	align_bits(d);
+}
+
+
+/// zlib header for a 32k window, the level bits tell how hard it was compressed
+void
+ZlibHeader(int level, unsigned char *header)
+{
+	header[0] = 0x78;
+	header[1] = level < 2 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda;
+}
+
+
+uint32_t
+Adler32(uint32_t adler, const unsigned char *src, size_t n)
+{
+	uint32_t a = adler & 0xffff, b = adler >> 16;
+	while (n > 0) {
+		/// 5552 bytes can be summed up before b overflows
+		size_t len = n < 5552 ? n : 5552;
+		n -= len;
+		while (len--) {
+			a += *src++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return b << 16 | a;
+}
+
+
+/// Checksum of two pieces of data from the checksums adler1 and adler2 of
+/// the pieces, len2 is the length of the second piece
+uint32_t
+Adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+	const uint32_t base = 65521;
+	uint32_t rem = len2 % base;
+	uint32_t a = adler1 & 0xffff;
+	uint32_t b = (uint32_t)(((uint64_t)rem * a) % base);
+	a += (adler2 & 0xffff) + base - 1;
+	b += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+	if (a >= base)
+		a -= base;
+	if (a >= base)
+		a -= base;
+	if (b >= 2 * base)
+		b -= 2 * base;
+	if (b >= base)
+		b -= base;
+	return b << 16 | a;
+}
+
+
+uint32_t
+Crc32(uint32_t crc, const unsigned char *src, size_t n)
+{
+	static uint32_t table[256];
+	if (!table[1]) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+	crc = ~crc;
+	while (n--)
+		crc = table[(crc ^ *src++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
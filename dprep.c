@@ -0,0 +1,468 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sis.h"
+#include "dprep.h"
+#include "resample.h"
+
+/*
+
+Preprocessing of depth maps (--depth-prep).
+
+Depth maps often need smoothing to avoid artifacts in the SIS, and a
+contrast stretch to use the whole depth range. Right after a depth map is
+opened, PrepDepthMap() reads all of its rows, whatever the backend is, and
+preprocesses them in three optional steps:
+
+  blur=#     Gaussian blur with a standard deviation of # dots
+  box=#      box blur with a radius of # dots, instead of blur
+  normalize  stretch the used depth range to [0, SIS_MAX_DEPTH]
+  gamma=#    raise the depth (0 far, 1 near) to the power #
+
+The depth values are 16-bit throughout, 8-bit depth maps are widened first.
+The blur is separable, a horizontal pass into a 16-bit intermediate image
+and a vertical one. Both are weighted sums of rows with 16-bit fixed point
+weights, which the blur_row kernel computes with the vector units of the
+CPU. Normalization and gamma are one lookup table. All passes work on
+bands of rows in parallel. The result doesn't depend on the number of
+threads.
+
+With --depth-filter the preprocessed depth map is finally resampled to
+the size of the SIS with a box, bilinear or Lanczos filter, in parallel
+bands as well. Otherwise a SIS of another size than the depth map takes
+the nearest depth value of each dot, which aliases when it is smaller and
+doesn't smooth the steps between the depth values when it is larger.
+
+The rows of the depth map are then read from the preprocessed image.
+
+*/
+
+/// Dots of a row that blur_row() sums at a time
+#define PREP_CHUNK      256
+/// Weights are fixed point numbers with 16 fractional bits
+#define PREP_ONE        65536
+#define PREP_MAX_RADIUS 256
+
+typedef struct {
+	const uint16_t *src;
+	uint16_t *dst;
+	ind_t width, height;
+	const uint32_t *weights;
+	int radius;
+	const uint16_t *lut;
+	uint16_t *lo, *hi;        /// Depth range of each band
+} prep_pass_t;
+
+
+static bool
+parse_step(const char *spec)
+{
+	char *end;
+	if (!strncmp(spec, "blur=", 5)) {
+		sis->prep.sigma = strtof(spec + 5, &end);
+		return sis->prep.sigma > 0.0f && sis->prep.sigma * 3.0f <= PREP_MAX_RADIUS && (*end == ':' || *end == 0);
+	}
+	if (!strncmp(spec, "box=", 4)) {
+		sis->prep.box = (int)strtol(spec + 4, &end, 10);
+		return sis->prep.box >= 1 && sis->prep.box <= PREP_MAX_RADIUS && (*end == ':' || *end == 0);
+	}
+	if (!strncmp(spec, "normalize", 9) && (spec[9] == ':' || spec[9] == 0)) {
+		sis->prep.normalize = true;
+		return true;
+	}
+	if (!strncmp(spec, "gamma=", 6)) {
+		sis->prep.gamma = strtof(spec + 6, &end);
+		return sis->prep.gamma >= 0.1f && sis->prep.gamma <= 10.0f && (*end == ':' || *end == 0);
+	}
+	return false;
+}
+
+
+bool
+ParseDepthPrep(const char *spec)
+{
+	sis->prep.sigma = 0.0f;
+	sis->prep.box = 0;
+	sis->prep.normalize = false;
+	sis->prep.gamma = 1.0f;
+	for (const char *p = spec; ; p += strcspn(p, ":") + 1) {
+		if (!parse_step(p))
+			return false;
+		if (!p[strcspn(p, ":")])
+			break;
+	}
+	/// Only one of the blurs
+	if (sis->prep.sigma > 0.0f && sis->prep.box > 0)
+		return false;
+	snprintf(sis->depth_prep_spec, sizeof(sis->depth_prep_spec), "%s", spec);
+	sis->depth_prep = true;
+	return true;
+}
+
+
+bool
+ParseDepthFilter(const char *name)
+{
+	sis->depth_filter = ResampleFilterFromName(name);
+	if (sis->depth_filter < 0)
+		return !strcmp(name, "nearest");
+	sis->depth_prep = true;
+	return true;
+}
+
+
+SIS_KERNEL_BODY void
+blur_row_body(uint16_t *restrict dst, const uint16_t *const *rows, const uint32_t *weights,
+              int count, ind_t n)
+{
+	for (ind_t x0 = 0; x0 < n; x0 += PREP_CHUNK) {
+		uint32_t acc[PREP_CHUNK];
+		ind_t len = n - x0 < PREP_CHUNK ? n - x0 : PREP_CHUNK;
+		for (ind_t j = 0; j < len; j++)
+			acc[j] = PREP_ONE / 2;
+		/// The sum stays below 2^32, the weights sum to PREP_ONE
+		for (int k = 0; k < count; k++) {
+			const uint16_t *restrict src = rows[k] + x0;
+			uint32_t w = weights[k];
+			for (ind_t j = 0; j < len; j++)
+				acc[j] += w * src[j];
+		}
+		for (ind_t j = 0; j < len; j++)
+			dst[x0 + j] = (uint16_t)(acc[j] >> 16);
+	}
+}
+
+SIS_KERNEL_VARIANTS(blur_row,
+  (uint16_t *dst, const uint16_t *const *rows, const uint32_t *weights, int count, ind_t n),
+  (dst, rows, weights, count, n))
+
+
+void
+InitDepthPrepKernel(void)
+{
+	SIS_KERNEL_SELECT(sis->BlurRow, blur_row, "depth blur:");
+}
+
+
+/// Ingest functions while the depth map is captured, they widen 8-bit depth
+/// like DaddRange() does
+static void
+capture_row8(col_t *dst, const uint8_t *src, ind_t n, col_t *lo, col_t *hi)
+{
+	uint16_t *row = sis->prep_depth + (size_t)sis->prep_row * n;
+	for (ind_t i = 0; i < n; i++)
+		row[i] = (uint16_t)(src[i] << 8);
+	*lo = 0;
+	*hi = 0;
+}
+
+
+static void
+capture_row16(col_t *dst, const uint16_t *src, ind_t n, col_t *lo, col_t *hi)
+{
+	memcpy(sis->prep_depth + (size_t)sis->prep_row * n, src, n * sizeof(uint16_t));
+	*lo = 0;
+	*hi = 0;
+}
+
+
+/// Read all rows of the opened depth map into prep_depth
+static void
+capture_depth_map(void)
+{
+	void (*ingest)(col_t *, const uint8_t *, ind_t, col_t *, col_t *) = sis->IngestDepthRow;
+	void (*ingest16)(col_t *, const uint16_t *, ind_t, col_t *, col_t *) = sis->IngestDepthRow16;
+	col_t *dbuffer = DBuffer;
+	col_t *row = (col_t *)malloc(sis->Dwidth * sizeof(col_t));
+	if (!row) {
+		fprintf(stderr, "Failed to allocate the depth map row.\n");
+		SISExit(1);
+	}
+	sis->IngestDepthRow = capture_row8;
+	sis->IngestDepthRow16 = capture_row16;
+	DBuffer = row;
+	sis->depth_capture = true;
+	for (sis->prep_row = 0; sis->prep_row < sis->Dheight; sis->prep_row++)
+		sis->ReadDBuffer(sis->prep_row);
+	sis->depth_capture = false;
+	DBuffer = dbuffer;
+	sis->IngestDepthRow = ingest;
+	sis->IngestDepthRow16 = ingest16;
+	free(row);
+}
+
+
+/// Weights of the blur, count is 2 * radius + 1
+static uint32_t *
+blur_weights(int *radius)
+{
+	*radius = sis->prep.box ? sis->prep.box : (int)ceilf(3.0f * sis->prep.sigma);
+	int count = 2 * *radius + 1;
+	uint32_t *weights = (uint32_t *)malloc(count * sizeof(uint32_t));
+	double *g = (double *)malloc(count * sizeof(double));
+	if (!weights || !g) {
+		fprintf(stderr, "Failed to allocate the blur weights.\n");
+		SISExit(1);
+	}
+	double sum = 0.0;
+	for (int k = 0; k < count; k++) {
+		double x = k - *radius;
+		g[k] = sis->prep.box ? 1.0 : exp(-x * x / (2.0 * sis->prep.sigma * sis->prep.sigma));
+		sum += g[k];
+	}
+	uint32_t total = 0;
+	for (int k = 0; k < count; k++) {
+		weights[k] = (uint32_t)(g[k] / sum * PREP_ONE);
+		total += weights[k];
+	}
+	/// The rounding error goes to the middle, the weights sum to PREP_ONE
+	weights[*radius] += PREP_ONE - total;
+	free(g);
+	return weights;
+}
+
+
+static void
+blur_rows_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const prep_pass_t *p = (const prep_pass_t *)arg;
+	int count = 2 * p->radius + 1;
+	/// A row with its edge dots repeated radius times on both sides
+	uint16_t *pad = (uint16_t *)malloc((p->width + 2 * p->radius) * sizeof(uint16_t));
+	const uint16_t **rows = (const uint16_t **)malloc(count * sizeof(uint16_t *));
+	if (!pad || !rows) {
+		fprintf(stderr, "Failed to allocate the blur buffers.\n");
+		SISExit(1);
+	}
+	for (int k = 0; k < count; k++)
+		rows[k] = pad + k;
+	for (ind_t y = begin; y < end; y++) {
+		const uint16_t *src = p->src + (size_t)y * p->width;
+		for (int k = 0; k < p->radius; k++) {
+			pad[k] = src[0];
+			pad[p->radius + p->width + k] = src[p->width - 1];
+		}
+		memcpy(pad + p->radius, src, p->width * sizeof(uint16_t));
+		sis->BlurRow(p->dst + (size_t)y * p->width, rows, p->weights, count, p->width);
+	}
+	free(rows);
+	free(pad);
+}
+
+
+static void
+blur_columns_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const prep_pass_t *p = (const prep_pass_t *)arg;
+	int count = 2 * p->radius + 1;
+	const uint16_t **rows = (const uint16_t **)malloc(count * sizeof(uint16_t *));
+	if (!rows) {
+		fprintf(stderr, "Failed to allocate the blur buffers.\n");
+		SISExit(1);
+	}
+	for (ind_t y = begin; y < end; y++) {
+		for (int k = 0; k < count; k++) {
+			ind_t r = y + k - p->radius;
+			r = r < 0 ? 0 : r >= p->height ? p->height - 1 : r;
+			rows[k] = p->src + (size_t)r * p->width;
+		}
+		sis->BlurRow(p->dst + (size_t)y * p->width, rows, p->weights, count, p->width);
+	}
+	free(rows);
+}
+
+
+static void
+range_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const prep_pass_t *p = (const prep_pass_t *)arg;
+	uint16_t lo = UINT16_MAX, hi = 0;
+	const uint16_t *src = p->src + (size_t)begin * p->width;
+	for (size_t i = 0; i < (size_t)(end - begin) * p->width; i++) {
+		lo = src[i] < lo ? src[i] : lo;
+		hi = src[i] > hi ? src[i] : hi;
+	}
+	p->lo[band] = lo;
+	p->hi[band] = hi;
+}
+
+
+static void
+lookup_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const prep_pass_t *p = (const prep_pass_t *)arg;
+	uint16_t *dst = p->dst + (size_t)begin * p->width;
+	for (size_t i = 0; i < (size_t)(end - begin) * p->width; i++)
+		dst[i] = p->lut[dst[i]];
+}
+
+
+static void
+blur_depth_map(int bands)
+{
+	prep_pass_t p = { 0 };
+	uint16_t *tmp = (uint16_t *)malloc((size_t)sis->Dwidth * sis->Dheight * sizeof(uint16_t));
+	if (!tmp) {
+		fprintf(stderr, "Failed to allocate the blurred depth map.\n");
+		SISExit(1);
+	}
+	p.width = sis->Dwidth;
+	p.height = sis->Dheight;
+	p.weights = blur_weights(&p.radius);
+	p.src = sis->prep_depth;
+	p.dst = tmp;
+	ParallelFor(sis->Dheight, bands, blur_rows_band, &p);
+	/// The vertical pass needs the rows around each band, so it starts after
+	/// the horizontal one has finished
+	p.src = tmp;
+	p.dst = sis->prep_depth;
+	ParallelFor(sis->Dheight, bands, blur_columns_band, &p);
+	free((void *)p.weights);
+	free(tmp);
+}
+
+
+/// Stretch the used range and apply the gamma curve with one lookup table
+static void
+map_depth_values(int bands)
+{
+	prep_pass_t p = { 0 };
+	uint16_t lo = 0, hi = SIS_MAX_DEPTH;
+	p.width = sis->Dwidth;
+	p.src = p.dst = sis->prep_depth;
+	if (sis->prep.normalize) {
+		p.lo = (uint16_t *)malloc(bands * sizeof(uint16_t));
+		p.hi = (uint16_t *)malloc(bands * sizeof(uint16_t));
+		if (!p.lo || !p.hi) {
+			fprintf(stderr, "Failed to allocate the depth ranges.\n");
+			SISExit(1);
+		}
+		ParallelFor(sis->Dheight, bands, range_band, &p);
+		lo = UINT16_MAX;
+		hi = 0;
+		for (int b = 0; b < bands; b++) {
+			lo = p.lo[b] < lo ? p.lo[b] : lo;
+			hi = p.hi[b] > hi ? p.hi[b] : hi;
+		}
+		free(p.lo);
+		free(p.hi);
+	}
+	uint16_t *lut = (uint16_t *)malloc((UINT16_MAX + 1) * sizeof(uint16_t));
+	if (!lut) {
+		fprintf(stderr, "Failed to allocate the depth lookup table.\n");
+		SISExit(1);
+	}
+	for (long v = 0; v <= UINT16_MAX; v++) {
+		/// A flat depth map stays as it is
+		double d = hi > lo ? (double)(v - lo) / (hi - lo) : v / (double)SIS_MAX_DEPTH;
+		d = d < 0.0 ? 0.0 : d > 1.0 ? 1.0 : d;
+		if (sis->prep.gamma != 1.0f)
+			d = pow(d, sis->prep.gamma);
+		lut[v] = (uint16_t)lround(d * SIS_MAX_DEPTH);
+	}
+	p.lut = lut;
+	ParallelFor(sis->Dheight, bands, lookup_band, &p);
+	free(lut);
+}
+
+
+/// Resample the depth map to the size of the SIS
+static void
+resample_depth_map(void)
+{
+	InitSISSize();
+	if (sis->SISwidth == sis->Dwidth && sis->SISheight == sis->Dheight)
+		return;
+	uint16_t *dst = (uint16_t *)malloc((size_t)sis->SISwidth * sis->SISheight * sizeof(uint16_t));
+	if (!dst) {
+		fprintf(stderr, "Failed to allocate the resampled depth map.\n");
+		SISExit(1);
+	}
+	/// The edges of the depth map are repeated, unlike the tiles of textures
+	ResampleImage16(sis->prep_depth, sis->Dwidth, sis->Dheight, dst, sis->SISwidth, sis->SISheight, 1, sis->depth_filter, false);
+	free(sis->prep_depth);
+	sis->prep_depth = dst;
+	sis->Dwidth = sis->SISwidth;
+	sis->Dheight = sis->SISheight;
+}
+
+
+void
+PrepDepthMap(void)
+{
+	if (!sis->BlurRow) {
+		/// The kernels aren't selected yet for the first depth map
+		InitCPU();
+		InitDepthPrepKernel();
+	}
+	sis->prep_depth = (uint16_t *)malloc((size_t)sis->Dwidth * sis->Dheight * sizeof(uint16_t));
+	if (!sis->prep_depth) {
+		fprintf(stderr, "Failed to allocate the preprocessed depth map.\n");
+		SISExit(1);
+	}
+	capture_depth_map();
+	sis->CloseDFile();
+	sis->depth_source_width = sis->Dwidth;
+	sis->depth_source_height = sis->Dheight;
+	int bands = ParallelBands(sis->Dheight, 16);
+	if (sis->prep.sigma > 0.0f || sis->prep.box > 0)
+		blur_depth_map(bands);
+	if (sis->prep.normalize || sis->prep.gamma != 1.0f)
+		map_depth_values(bands);
+	if (sis->depth_filter >= 0)
+		resample_depth_map();
+	sis->ReadDBuffer = Prep_ReadDBuffer;
+	sis->CloseDFile = Prep_CloseDFile;
+	sis->GetDFileBuffer = Prep_GetDFileBuffer;
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+void
+Prep_ReadDBuffer(ind_t r)
+{
+	col_t lo, hi;
+	sis->IngestDepthRow16(DBuffer, sis->prep_depth + (size_t)r * sis->Dwidth, sis->Dwidth, &lo, &hi);
+	DaddRange(lo, hi, 0);
+}
+
+
+void
+Prep_CloseDFile(void)
+{
+	free(sis->prep_depth);
+	sis->prep_depth = NULL;
+}
+
+
+/// The depth map is 16-bit, there is no 8-bit buffer of it
+unsigned char *
+Prep_GetDFileBuffer(void)
+{
+	return NULL;
+}
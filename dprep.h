@@ -0,0 +1,36 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sis.h"
+
+/// Parse steps like "blur=2:normalize:gamma=0.8", false if they're invalid
+bool ParseDepthPrep(const char *spec);
+/// Parse nearest, box, bilinear or lanczos, false if it's none of them
+bool ParseDepthFilter(const char *name);
+void InitDepthPrepKernel(void);
+/// Read the depth map that was just opened, preprocess it and replace its
+/// backend by the preprocessed 16-bit depth map
+void PrepDepthMap(void);
+
+void Prep_ReadDBuffer(ind_t r);
+void Prep_CloseDFile(void);
+unsigned char *Prep_GetDFileBuffer(void);
@@ -0,0 +1,452 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "sis.h"
+#include "dstream.h"
+
+/*
+
+Streaming depth map reader for png and binary pgm/ppm files.
+
+Instead of decoding the whole depth map at startup like stb_image, the rows
+are decoded when the algorithm asks for them. The rows are requested in
+ascending order, so png rows are inflated one after the other and pgm/ppm
+rows are read (or skipped) from the file. Only the current and the previous
+row are kept in memory, depth maps larger than stb_image can handle (and
+larger than the memory) can be used.
+
+*/
+
+enum { FMT_PNG, FMT_PNM };
+
+static FILE *dfp;
+static int dformat;
+static ind_t dwidth, dheight;
+/// Sample bit depth, channels per pixel and bytes of a row in the file
+static int bit_depth, channels;
+static size_t row_bytes;
+/// Row number of the next row in the file
+static ind_t next_row;
+static unsigned char *cur_row, *prev_row;
+static uint8_t *grey8;
+static uint16_t *grey16;
+/// png state
+static int color_type;
+static uint8_t palette_grey[256];
+static long idat_offset;
+static uint32_t idat_left;
+static bool idat_end;
+static inflate_t *zs;
+/// pnm state
+static long data_offset;
+
+
+static uint32_t
+get_be32(const unsigned char *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+
+/// Same weights as stb_image uses for converting RGB to grey
+static inline int
+rgb_to_grey(int r, int g, int b)
+{
+	return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+
+static bool
+read_png_header(FILE *fp, ind_t *width, ind_t *height, int *depth, int *type, int *interlace)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	unsigned char buf[8 + 8 + 13];
+	if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf) || memcmp(buf, signature, 8)
+	    || memcmp(buf + 12, "IHDR", 4))
+		return false;
+	*width = get_be32(buf + 16);
+	*height = get_be32(buf + 20);
+	*depth = buf[24];
+	*type = buf[25];
+	*interlace = buf[28];
+	return true;
+}
+
+
+/// Skip white space and comments of a pnm header and read a number
+static bool
+read_pnm_number(FILE *fp, ind_t *value)
+{
+	int c = fgetc(fp);
+	while (c == '#' || isspace(c)) {
+		if (c == '#') {
+			while (c != '\n' && c != EOF)
+				c = fgetc(fp);
+		}
+		c = fgetc(fp);
+	}
+	if (!isdigit(c))
+		return false;
+	*value = 0;
+	while (isdigit(c)) {
+		*value = *value * 10 + (c - '0');
+		c = fgetc(fp);
+	}
+	/// A single white space character ends the number
+	return isspace(c);
+}
+
+
+static bool
+read_pnm_header(FILE *fp, ind_t *width, ind_t *height, ind_t *maxval, int *ch)
+{
+	char magic[2];
+	if (fread(magic, 1, 2, fp) != 2 || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6'))
+		return false;
+	*ch = magic[1] == '5' ? 1 : 3;
+	return read_pnm_number(fp, width) && read_pnm_number(fp, height)
+	    && read_pnm_number(fp, maxval) && *maxval > 0 && *maxval < 65536;
+}
+
+
+int
+Stream_ProbeDFile(const char *FileName)
+{
+	ind_t w = 0, h = 0, maxval;
+	int depth = 8, type, interlace, ch = 1;
+	FILE *fp = fopen(FileName, "rb");
+	if (!fp)
+		return SIS_STREAM_NO;
+	if (read_png_header(fp, &w, &h, &depth, &type, &interlace)) {
+		const int png_channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+		if (interlace || type > 6 || !png_channels[type]) {
+			fclose(fp);
+			return SIS_STREAM_NO;
+		}
+		ch = png_channels[type];
+	} else {
+		rewind(fp);
+		if (!read_pnm_header(fp, &w, &h, &maxval, &ch)) {
+			fclose(fp);
+			return SIS_STREAM_NO;
+		}
+		depth = maxval > 255 ? 16 : 8;
+	}
+	fclose(fp);
+	/// The limits of stb_image
+	if (w > (1 << 24) || h > (1 << 24) || (double)w * h * ch * (depth > 8 ? 2 : 1) > INT_MAX)
+		return SIS_STREAM_LARGE;
+	return SIS_STREAM_YES;
+}
+
+
+/// Read the data of the IDAT chunks for the inflate stream
+static size_t
+read_idat(void *ctx, unsigned char *buf, size_t n)
+{
+	unsigned char head[12];
+	(void)ctx;
+	while (idat_left == 0) {
+		/// Skip the crc of the previous chunk and read the header of the next one
+		if (idat_end || fread(head, 1, 12, dfp) != 12 || memcmp(head + 8, "IDAT", 4)) {
+			idat_end = true;
+			return 0;
+		}
+		idat_left = get_be32(head + 4);
+	}
+	if (n > idat_left)
+		n = idat_left;
+	n = fread(buf, 1, n, dfp);
+	idat_left -= n;
+	if (n == 0)
+		idat_end = true;
+	return n;
+}
+
+
+/// Position the file at the first row of the image data
+static void
+start_data(void)
+{
+	next_row = 0;
+	/// Row data starts at prev_row + 1, behind the filter type byte
+	memset(prev_row, 0, row_bytes + 1);
+	if (dformat == FMT_PNM) {
+		fseek(dfp, data_offset, SEEK_SET);
+		return;
+	}
+	unsigned char zhead[2];
+	/// The file is positioned in front of the crc of the chunk before the first IDAT
+	fseek(dfp, idat_offset, SEEK_SET);
+	idat_left = 0;
+	idat_end = false;
+	if (zs)
+		InflateFree(zs);
+	zs = InflateNew(read_idat, NULL);
+	if (read_idat(NULL, zhead, 1) != 1 || read_idat(NULL, zhead + 1, 1) != 1
+	    || (zhead[0] & 0x0f) != 8 || (zhead[1] & 0x20) || (zhead[0] << 8 | zhead[1]) % 31) {
+		fprintf(stderr, "Failed to decode %s: bad zlib header\n", sis->DFileName);
+		SISExit(1);
+	}
+}
+
+
+static void
+open_png(char *DFileName)
+{
+	unsigned char head[8];
+	int interlace;
+	if (!read_png_header(dfp, &dwidth, &dheight, &bit_depth, &color_type, &interlace)
+	    || interlace) {
+		fprintf(stderr, "Failed to load %s: not a streamable png file\n", DFileName);
+		SISExit(1);
+	}
+	const int png_channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+	channels = png_channels[color_type];
+	for (int i = 0; i < 256; i++)
+		palette_grey[i] = i;
+	/// Read the chunks up to the first IDAT, the palette is converted to grey
+	for (;;) {
+		idat_offset = ftell(dfp);
+		if (fseek(dfp, 4, SEEK_CUR) || fread(head, 1, 8, dfp) != 8) {
+			fprintf(stderr, "Failed to load %s: no image data\n", DFileName);
+			SISExit(1);
+		}
+		uint32_t len = get_be32(head);
+		if (!memcmp(head + 4, "IDAT", 4))
+			break;
+		if (!memcmp(head + 4, "PLTE", 4) && len <= 3 * 256) {
+			unsigned char plte[3 * 256];
+			if (fread(plte, 1, len, dfp) != len) {
+				fprintf(stderr, "Failed to load %s: bad palette\n", DFileName);
+				SISExit(1);
+			}
+			for (uint32_t i = 0; i < len / 3; i++)
+				palette_grey[i] = rgb_to_grey(plte[3 * i], plte[3 * i + 1], plte[3 * i + 2]);
+		} else {
+			fseek(dfp, len, SEEK_CUR);
+		}
+	}
+	row_bytes = ((size_t)dwidth * channels * bit_depth + 7) / 8;
+}
+
+
+static void
+open_pnm(char *DFileName)
+{
+	ind_t maxval;
+	if (!read_pnm_header(dfp, &dwidth, &dheight, &maxval, &channels)) {
+		fprintf(stderr, "Failed to load %s: not a binary pgm or ppm file\n", DFileName);
+		SISExit(1);
+	}
+	bit_depth = maxval > 255 ? 16 : 8;
+	data_offset = ftell(dfp);
+	row_bytes = (size_t)dwidth * channels * (bit_depth / 8);
+}
+
+
+void
+Stream_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	unsigned char magic[2];
+	if (!(dfp = fopen(DFileName, "rb")) || fread(magic, 1, 2, dfp) != 2) {
+		fprintf(stderr, "Failed to load %s\n", DFileName);
+		SISExit(1);
+	}
+	rewind(dfp);
+	dformat = magic[0] == 'P' ? FMT_PNM : FMT_PNG;
+	if (dformat == FMT_PNM)
+		open_pnm(DFileName);
+	else
+		open_png(DFileName);
+	/// The filter type byte of png rows is read into cur_row, too
+	cur_row = (unsigned char *)malloc(row_bytes + 1);
+	prev_row = (unsigned char *)calloc(row_bytes + 1, 1);
+	if (bit_depth == 16)
+		grey16 = (uint16_t *)malloc(dwidth * sizeof(uint16_t));
+	else
+		grey8 = (uint8_t *)malloc(dwidth);
+	if (!cur_row || !prev_row || !(grey8 || grey16)) {
+		fprintf(stderr, "Failed to allocate depth map row buffers.\n");
+		SISExit(1);
+	}
+	start_data();
+	*width = dwidth;
+	*height = dheight;
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+static inline int
+paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+
+/// Inflate and unfilter the next png row into cur_row + 1
+static void
+next_png_row(void)
+{
+	unsigned char *x = cur_row + 1;
+	const unsigned char *b = prev_row + 1;
+	size_t bpp = (channels * bit_depth + 7) / 8;
+	unsigned char *tmp = prev_row;
+	if (Inflate(zs, cur_row, row_bytes + 1) != row_bytes + 1 || InflateError(zs)) {
+		fprintf(stderr, "Failed to decode %s: corrupt image data\n", sis->DFileName);
+		SISExit(1);
+	}
+	switch (cur_row[0]) {
+	case 0:
+		break;
+	case 1:
+		for (size_t i = bpp; i < row_bytes; i++)
+			x[i] += x[i - bpp];
+		break;
+	case 2:
+		for (size_t i = 0; i < row_bytes; i++)
+			x[i] += b[i];
+		break;
+	case 3:
+		for (size_t i = 0; i < row_bytes; i++)
+			x[i] += ((i >= bpp ? x[i - bpp] : 0) + b[i]) >> 1;
+		break;
+	case 4:
+		for (size_t i = 0; i < row_bytes; i++)
+			x[i] += paeth(i >= bpp ? x[i - bpp] : 0, b[i], i >= bpp ? b[i - bpp] : 0);
+		break;
+	default:
+		fprintf(stderr, "Failed to decode %s: bad filter type\n", sis->DFileName);
+		SISExit(1);
+	}
+	/// The unfiltered row is the previous row of the next one
+	prev_row = cur_row;
+	cur_row = tmp;
+}
+
+
+/// Convert the row in the file format to grey values in grey8 or grey16
+static void
+grey_row(const unsigned char *src)
+{
+	if (bit_depth == 16) {
+		for (ind_t c = 0; c < dwidth; c++) {
+			const unsigned char *p = src + 2 * channels * c;
+			if (channels >= 3)
+				grey16[c] = rgb_to_grey(p[0] << 8 | p[1], p[2] << 8 | p[3], p[4] << 8 | p[5]);
+			else
+				grey16[c] = p[0] << 8 | p[1];
+		}
+	} else if (bit_depth == 8) {
+		for (ind_t c = 0; c < dwidth; c++) {
+			const unsigned char *p = src + channels * c;
+			if (channels >= 3)
+				grey8[c] = rgb_to_grey(p[0], p[1], p[2]);
+			else if (dformat == FMT_PNG && color_type == 3)
+				grey8[c] = palette_grey[p[0]];
+			else
+				grey8[c] = p[0];
+		}
+	} else {
+		/// Grey or palette png with 1, 2 or 4 bits per pixel
+		int per_byte = 8 / bit_depth, mask = (1 << bit_depth) - 1;
+		int scale = 255 / mask;
+		for (ind_t c = 0; c < dwidth; c++) {
+			int v = (src[c / per_byte] >> (8 - bit_depth * (c % per_byte + 1))) & mask;
+			grey8[c] = color_type == 3 ? palette_grey[v] : v * scale;
+		}
+	}
+}
+
+
+void
+Stream_ReadDBuffer(ind_t r)
+{
+	col_t lo, hi;
+	/// Rows are read again from the start of the image data for a new render
+	if (r < next_row - 1)
+		start_data();
+	if (r == next_row - 1) {
+		/// Row r was already read, e.g. if the SIS is higher than the depth map
+	} else if (dformat == FMT_PNG) {
+		while (next_row <= r) {
+			next_png_row();
+			next_row++;
+		}
+		grey_row(prev_row + 1);
+	} else {
+		if (r > next_row) {
+			for (; next_row < r; next_row++)
+				fseek(dfp, row_bytes, SEEK_CUR);
+		}
+		if (fread(prev_row, 1, row_bytes, dfp) != row_bytes) {
+			fprintf(stderr, "Failed to read %s: file too short\n", sis->DFileName);
+			SISExit(1);
+		}
+		next_row++;
+		grey_row(prev_row);
+	}
+	if (grey16) {
+		sis->IngestDepthRow16(DBuffer, grey16, dwidth, &lo, &hi);
+		DaddRange(lo, hi, 0);
+		return;
+	}
+	sis->IngestDepthRow(DBuffer, grey8, dwidth, &lo, &hi);
+	DaddRange(lo, hi, 8);
+}
+
+
+void
+Stream_CloseDFile(void)
+{
+	if (dfp)
+		fclose(dfp);
+	dfp = NULL;
+	if (zs)
+		InflateFree(zs);
+	zs = NULL;
+	free(cur_row);
+	free(prev_row);
+	free(grey8);
+	free(grey16);
+	cur_row = prev_row = NULL;
+	grey8 = NULL;
+	grey16 = NULL;
+}
+
+
+/// The depth map is never kept in memory as a whole
+unsigned char *
+Stream_GetDFileBuffer(void)
+{
+	return NULL;
+}
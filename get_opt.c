@@ -26,15 +26,36 @@
 #include <string.h>
 
 #include "sis.h"
+#include "sequence.h"
+#include "pattern.h"
+#include "scene.h"
+#include "mesh.h"
+#include "dprep.h"
 
 
 static void
 print_usage(void)
 {
+	/// libsis returns invalid options as an error code and prints nothing
+	if (sis->context)
+		SISExit(1);
 	fprintf(stderr,
 	        "\nUsage: sis [DEPTH FILE] [SIS FILE] [OPTIONS]\n\n"
 	        "(...;...) = (range; default value)\n"
 	        "#  = integer value.\n"
+	        "The format of SIS FILE is png, qoi, bmp, tga, jpeg, tiff, ppm, pbm (-d\n"
+	        "only), raw, gif or apng, given by its extension (png if unknown) or\n"
+	        "--format.\n"
+	        "With a y4m SIS FILE, DEPTH FILE is a y4m video and each frame is\n"
+	        "rendered into a frame of the SIS video.\n"
+	        "A numbered DEPTH FILE like depth%%04d.png is a sequence of depth maps,\n"
+	        "each one is rendered into the SIS FILE with the same number, or into\n"
+	        "the frames of an apng or gif SIS FILE.\n"
+	        "A file name - reads the depth map or texture from the standard input\n"
+	        "or writes the SIS to the standard output.\n"
+	        "A DEPTH FILE .obj or .stl is a 3D mesh, rendered as seen by --camera.\n"
+	        "With --shape, the depth map is a scene of shapes and the only file\n"
+	        "name is the SIS FILE.\n"
 	        "OPTIONS:\n"
 	        "   -a #     : algorithm number (1-4; 4)\n"
 	        "   -c #     : output is random color with # colors\n"
@@ -52,7 +73,8 @@ print_usage(void)
 	        "              from screen to far plane (>0; 33)\n"
 	        "   -o #     : position where algorithm starts (0-SISwidth; SISwidth/2)\n"
 	        "              in algo #4 the default origin is left of the image center\n"
-	        "   -q #     : oversampling factor (>0; 4)\n"
+	        "   -q #     : oversampling factor (>0; 4), algo #1-3 link pixels with\n"
+	        "              a precision of 1/# pixels instead\n"
 	        "   -s #     : seed value for random dots (>0; 1)\n"
 	        "   -t file  : texture filename (texture.tif)\n"
 	        "   -v       : print some information\n"
@@ -61,16 +83,64 @@ print_usage(void)
 	        "              example: -e45i300 means 4.5inch at 300dpi\n"
 	        "   -y #     : height of SIS in dots (>0; height of depth-map)\n"
 	        "   -y #m|i# : height of SIS in tenths of (cm | inch) with resolution in dpi\n"
-	        "              example: -e32i300 means 3.2inch at 300dpi\n");
+	        "              example: -e32i300 means 3.2inch at 300dpi\n"
+	        "LONG OPTIONS:\n"
+	        "   --cache      : cache decoded depth maps and textures as pgm/ppm files\n"
+	        "                  next to them (e.g. depth.png.sis.pgm)\n"
+	        "   --camera yaw,pitch[,fov] : view of obj and stl depth maps, angles\n"
+	        "                  in degrees, fov 0 is orthographic (0-170; 0,0,0)\n"
+	        "   --cpu level  : limit the row kernels to an instruction set level\n"
+	        "                  (generic, sse2, avx2, avx512, neon; best of the CPU)\n"
+	        "   --depth-filter name : resample the depth map to the size of the SIS\n"
+	        "                  with a box, bilinear or lanczos filter (nearest\n"
+	        "                  samples each dot while rendering; nearest)\n"
+	        "   --depth-prep step[:step...] : preprocess the depth map, blur=#\n"
+	        "                  (Gaussian, sigma in dots) or box=# (radius in\n"
+	        "                  dots), normalize (stretch to the depth range) and\n"
+	        "                  gamma=# (0.1-10)\n"
+	        "   --direct-rgb : keep texture colors as RGB instead of a palette, used\n"
+	        "                  anyway for textures with more than 65535 colors\n"
+	        "   --first-frame # : number of the first frame of a depth map sequence\n"
+	        "                  (>=0; 0 or 1, whichever exists)\n"
+	        "   --fps #      : frames per second of animated apng and gif files\n"
+	        "                  (1-100; 25)\n"
+	        "   --format ext : format of SIS FILE as its extension would give it,\n"
+	        "                  e.g. qoi, for the standard output (png by default)\n"
+	        "   --indexed    : no interpolated colors, write png and tiff files with\n"
+	        "                  a palette if the SIS has at most 256 colors\n"
+	        "   --jpeg-quality : quality of jpeg files (1-100; default 90)\n"
+	        "   --pattern name[:param...] : procedural texture instead of -t,\n"
+	        "                  noise, perlin, stripes, plasma or gradient, params\n"
+	        "                  scale=# (size in dots), octaves=# (noise, perlin;\n"
+	        "                  1-8), angle=# (stripes; 60) and grey\n"
+	        "   --png-filter : row filter of png files (adaptive, none, sub, up,\n"
+	        "                  average, paeth or fixed; default adaptive)\n"
+	        "   --png-level  : png and tiff deflate level (0-9; default 6)\n"
+	        "   --raw-size # : size of raw input files (*.raw) as width x height,\n"
+	        "                  e.g. 640x480\n"
+	        "   --shape kind[:param...] : shape of a scene that is the depth map,\n"
+	        "                  given instead of DEPTH FILE, may be repeated: sphere,\n"
+	        "                  box, ring or text, params x=#, y=# (center), r=#\n"
+	        "                  (sphere, ring), w=#, h=# (box, ring tube), size=#,\n"
+	        "                  font=file, text=string (text, last) in dots or #%%,\n"
+	        "                  and depth=# (0-100%% of the depth range)\n"
+	        "   --stats file : write render statistics in JSON format to file\n"
+	        "   --stream     : read depth rows and write png rows while rendering\n"
+	        "   --texture-scale #|fit : resample the texture by # (0.01-16) or to\n"
+	        "                  the width of one period of the SIS (fit)\n"
+	        "   --threads #  : number of threads (>=0; 0 is one per CPU core)\n"
+	        "   --tiff-compression : compression of tiff files (none, packbits,\n"
+	        "                  deflate; default deflate)\n"
+	        "   --y4m-chroma : chroma of y4m videos (444, 420 or mono; default 444)\n");
 	        // "   -z       : output is compressed if possible\n" "\n");
-	exit(1);
+	SISExit(1);
 }
 
 
 ind_t
 metric2pixel(int metric_val, int resolution)
 {
-	switch (metric) {
+	switch (sis->metric) {
 	case 'm':
 	case 'c':
 		return metric_val / 25.4 * resolution;
@@ -83,21 +153,150 @@ metric2pixel(int metric_val, int resolution)
 }
 
 
+/// File names don't start with '-', except "-" for the standard input or output
+static bool
+is_file_arg(const char *arg)
+{
+	return arg[0] != '-' || arg[1] == 0;
+}
+
+
+/// Long options are given as --name=value or --name value
+static bool
+is_long_option(const char *arg, const char *name)
+{
+	size_t len = strlen(name);
+	return !strncmp(arg + 2, name, len) && (arg[2 + len] == 0 || arg[2 + len] == '=');
+}
+
+
+static char *
+long_option_value(int argc, char **argv, int *opt_ind)
+{
+	char *value = strchr(argv[*opt_ind], '=');
+	if (value)
+		return value + 1;
+	(*opt_ind)++;
+	if (*opt_ind >= argc)
+		print_usage();
+	return argv[*opt_ind];
+}
+
+
+static void
+get_long_option(int argc, char **argv, int *opt_ind)
+{
+	char *arg = argv[*opt_ind];
+	if (is_long_option(arg, "stats")) {
+		strncpy(sis->StatsFileName, long_option_value(argc, argv, opt_ind), PATH_MAX - 1);
+	} else if (is_long_option(arg, "direct-rgb")) {
+		sis->direct_rgb = true;
+	} else if (is_long_option(arg, "indexed")) {
+		sis->indexed_output = true;
+	} else if (is_long_option(arg, "cache")) {
+		sis->cache_files = true;
+	} else if (is_long_option(arg, "raw-size")) {
+		if (sscanf(long_option_value(argc, argv, opt_ind), "%ldx%ld", &sis->raw_width, &sis->raw_height) != 2
+		    || sis->raw_width <= 0 || sis->raw_height <= 0)
+			print_usage();
+	} else if (is_long_option(arg, "camera")) {
+		char *value = long_option_value(argc, argv, opt_ind);
+		int n = sscanf(value, "%f,%f,%f", &sis->camera_yaw, &sis->camera_pitch, &sis->camera_fov);
+		if (n < 2 || sis->camera_fov < 0.0f || sis->camera_fov > 170.0f)
+			print_usage();
+	} else if (is_long_option(arg, "jpeg-quality")) {
+		sis->jpeg_quality = atoi(long_option_value(argc, argv, opt_ind));
+		if (sis->jpeg_quality < 1 || sis->jpeg_quality > 100)
+			print_usage();
+	} else if (is_long_option(arg, "format")) {
+		sis->output_format = ImgFileFormatFromExtension(long_option_value(argc, argv, opt_ind));
+		if (sis->output_format < 0)
+			print_usage();
+	} else if (is_long_option(arg, "fps")) {
+		sis->anim_fps = atoi(long_option_value(argc, argv, opt_ind));
+		if (sis->anim_fps < 1 || sis->anim_fps > 100)
+			print_usage();
+	} else if (is_long_option(arg, "first-frame")) {
+		sis->first_frame = atol(long_option_value(argc, argv, opt_ind));
+		if (sis->first_frame < 0)
+			print_usage();
+	} else if (is_long_option(arg, "pattern")) {
+		char *value = long_option_value(argc, argv, opt_ind);
+		if (!ParsePattern(value))
+			print_usage();
+		sis->SIStype = SIS_TEXT_MAP;
+		strncpy(sis->TFileName, value, PATH_MAX - 1);
+	} else if (is_long_option(arg, "depth-filter")) {
+		if (!ParseDepthFilter(long_option_value(argc, argv, opt_ind)))
+			print_usage();
+	} else if (is_long_option(arg, "depth-prep")) {
+		if (!ParseDepthPrep(long_option_value(argc, argv, opt_ind)))
+			print_usage();
+	} else if (is_long_option(arg, "shape")) {
+		if (!AddSceneShape(long_option_value(argc, argv, opt_ind)))
+			print_usage();
+	} else if (is_long_option(arg, "y4m-chroma")) {
+		char *value = long_option_value(argc, argv, opt_ind);
+		if (!strcmp(value, "444"))
+			sis->y4m_chroma = SIS_Y4M_444;
+		else if (!strcmp(value, "420"))
+			sis->y4m_chroma = SIS_Y4M_420;
+		else if (!strcmp(value, "mono"))
+			sis->y4m_chroma = SIS_Y4M_MONO;
+		else
+			print_usage();
+	} else if (is_long_option(arg, "tiff-compression")) {
+		sis->tiff_compression = tiff_compression_from_name(long_option_value(argc, argv, opt_ind));
+		if (!sis->tiff_compression)
+			print_usage();
+	} else if (is_long_option(arg, "png-level")) {
+		sis->png_level = atoi(long_option_value(argc, argv, opt_ind));
+		if (sis->png_level < 0 || sis->png_level > 9)
+			print_usage();
+	} else if (is_long_option(arg, "png-filter")) {
+		sis->png_filter = png_filter_from_name(long_option_value(argc, argv, opt_ind));
+		if (sis->png_filter < SIS_PNG_ADAPTIVE)
+			print_usage();
+	} else if (is_long_option(arg, "stream")) {
+		sis->stream_output = true;
+	} else if (is_long_option(arg, "texture-scale")) {
+		char *value = long_option_value(argc, argv, opt_ind);
+		sis->texture_fit = !strcmp(value, "fit");
+		sis->texture_scale = sis->texture_fit ? 1.0f : atof(value);
+		if (sis->texture_scale < 0.01f || sis->texture_scale > 16.0f)
+			print_usage();
+	} else if (is_long_option(arg, "threads")) {
+		sis->num_threads = atoi(long_option_value(argc, argv, opt_ind));
+		if (sis->num_threads < 0)
+			print_usage();
+	} else if (is_long_option(arg, "cpu")) {
+		sis->cpu_level_forced = cpu_level_from_name(long_option_value(argc, argv, opt_ind));
+		if (sis->cpu_level_forced < 0)
+			print_usage();
+	} else {
+		print_usage();
+	}
+}
+
+
 void
 get_options(int argc, char **argv)
 {
 	int opt_ind = 1;
 	int str_ind, i;
+	int file_args = 0;
 
 	if (opt_ind == argc)
 		print_usage();
-	if ((opt_ind < argc) && (argv[opt_ind][0] != '-')) {
-		strncpy(DFileName, argv[opt_ind], PATH_MAX);
+	if ((opt_ind < argc) && is_file_arg(argv[opt_ind])) {
+		strncpy(sis->DFileName, argv[opt_ind], PATH_MAX);
 		opt_ind++;
+		file_args++;
 	}
-	if ((opt_ind < argc) && (argv[opt_ind][0] != '-')) {
-		strncpy(SISFileName, argv[opt_ind], PATH_MAX);
+	if ((opt_ind < argc) && is_file_arg(argv[opt_ind])) {
+		strncpy(sis->SISFileName, argv[opt_ind], PATH_MAX);
 		opt_ind++;
+		file_args++;
 	}
 	while (opt_ind < argc) {
 		if (argv[opt_ind][0] != '-')
@@ -105,43 +304,43 @@ get_options(int argc, char **argv)
 		switch (argv[opt_ind][1]) {
 		case 'a':
 			if (argv[opt_ind][2] != 0)
-				algorithm = atoi(argv[opt_ind] + 2);
+				sis->algorithm = atoi(argv[opt_ind] + 2);
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					algorithm = atoi(argv[opt_ind]);
+					sis->algorithm = atoi(argv[opt_ind]);
 				else
 					print_usage();
 			}
-			if ((algorithm < SIS_MIN_ALGO) || (algorithm > SIS_MAX_ALGO))
+			if ((sis->algorithm < SIS_MIN_ALGO) || (sis->algorithm > SIS_MAX_ALGO))
 				print_usage();
 			break;
 		case 'c':
-			SIStype = SIS_RANDOM_COLOR;
+			sis->SIStype = SIS_RANDOM_COLOR;
 			if (argv[opt_ind][2] != 0)
-				rand_col_num = atoi(argv[opt_ind] + 2);
+				sis->rand_col_num = atoi(argv[opt_ind] + 2);
 			else {
 				if ((opt_ind + 1 < argc) && (argv[opt_ind + 1][0] != '-')) {
 					opt_ind++;
-					rand_col_num = atoi(argv[opt_ind]);
+					sis->rand_col_num = atoi(argv[opt_ind]);
 				}
 			}
-			if ((rand_col_num < 1) || (rand_col_num > SIS_MAX_COLORS + 1))
+			if ((sis->rand_col_num < 1) || (sis->rand_col_num > SIS_MAX_COLORS + 1))
 				print_usage();
 			break;
 		case 'd':
-			SIStype = SIS_RANDOM_GREY;
-			rand_grey_num = 2;
+			sis->SIStype = SIS_RANDOM_GREY;
+			sis->rand_grey_num = 2;
 			if (argv[opt_ind][2] != 0)
-				density = (double)atoi(argv[opt_ind] + 2) / 100.0;
+				sis->density = (double)atoi(argv[opt_ind] + 2) / 100.0;
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					density = (double)atoi(argv[opt_ind]) / 100.0;
+					sis->density = (double)atoi(argv[opt_ind]) / 100.0;
 				else
 					print_usage();
 			}
-			if ((density <= 0.0) || (density >= 100.0))
+			if ((sis->density <= 0.0) || (sis->density >= 100.0))
 				print_usage();
 			break;
 		case 'e':
@@ -155,40 +354,40 @@ get_options(int argc, char **argv)
 				print_usage();
 			for (i = str_ind; isdigit(argv[opt_ind][i]); i++) ;
 			if (!argv[opt_ind][i])
-				eye_dist = atoi(argv[opt_ind] + str_ind);
+				sis->eye_dist = atoi(argv[opt_ind] + str_ind);
 			else {
 				if (!isdigit(argv[opt_ind][i + 1]))
 					print_usage();
-				metric = argv[opt_ind][i];
+				sis->metric = argv[opt_ind][i];
 				argv[opt_ind][i] = 0;
-				resolution = atoi(argv[opt_ind] + i + 1);
-				eye_dist = metric2pixel(atoi(argv[opt_ind] + str_ind), resolution);
+				sis->resolution = atoi(argv[opt_ind] + i + 1);
+				sis->eye_dist = metric2pixel(atoi(argv[opt_ind] + str_ind), sis->resolution);
 			}
-			if (eye_dist <= 0)
+			if (sis->eye_dist <= 0)
 				print_usage();
 			break;
 		case 'f':
 			if (argv[opt_ind][2] != 0)
-				t = (double)atoi(argv[opt_ind] + 2) / 100.0;
+				sis->t = (double)atoi(argv[opt_ind] + 2) / 100.0;
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					t = (double)atoi(argv[opt_ind]) / 100.0;
+					sis->t = (double)atoi(argv[opt_ind]) / 100.0;
 				else
 					print_usage();
 			}
 			break;
 		case 'g':
-			SIStype = SIS_RANDOM_GREY;
+			sis->SIStype = SIS_RANDOM_GREY;
 			if (argv[opt_ind][2] != 0)
-				rand_grey_num = atoi(argv[opt_ind] + 2);
+				sis->rand_grey_num = atoi(argv[opt_ind] + 2);
 			else {
 				if ((opt_ind + 1 < argc) && (argv[opt_ind + 1][0] != '-')) {
 					opt_ind++;
-					rand_grey_num = atoi(argv[opt_ind]);
+					sis->rand_grey_num = atoi(argv[opt_ind]);
 				}
 			}
-			if ((rand_grey_num < 1) || (rand_grey_num > SIS_MAX_COLORS + 1))
+			if ((sis->rand_grey_num < 1) || (sis->rand_grey_num > SIS_MAX_COLORS + 1))
 				print_usage();
 			break;
 		case 'h':
@@ -202,13 +401,13 @@ get_options(int argc, char **argv)
 					print_usage();
 					break;
 				case 'i':
-					invert = !invert;
+					sis->invert = !sis->invert;
 					break;
 				case 'm':
-					mark = 1;
+					sis->mark = 1;
 					break;
 				case 'v':
-					verbose = 1;
+					sis->verbose = 1;
 					break;
 				// case 'z':
 					// SIScompress = 1;
@@ -219,37 +418,37 @@ get_options(int argc, char **argv)
 			break;
 		case 'q':
 			if (argv[opt_ind][2] != 0)
-				oversam = atoi(argv[opt_ind] + 2);
+				sis->oversam = atoi(argv[opt_ind] + 2);
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					oversam = atoi(argv[opt_ind]);
+					sis->oversam = atoi(argv[opt_ind]);
 				else
 					print_usage();
 			}
-			if (oversam <= 0)
+			if (sis->oversam <= 0)
 				print_usage();
 			break;
 		case 'n':
 			if (argv[opt_ind][2] != 0)
-				u = 1.0 - (double)atoi(argv[opt_ind] + 2) / 100.0;
+				sis->u = 1.0 - (double)atoi(argv[opt_ind] + 2) / 100.0;
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					u = 1.0 - (double)atoi(argv[opt_ind]) / 100.0;
+					sis->u = 1.0 - (double)atoi(argv[opt_ind]) / 100.0;
 				else
 					print_usage();
 			}
-			if ((u <= 0.0) || (u >= 1.0))
+			if ((sis->u <= 0.0) || (sis->u >= 1.0))
 				print_usage();
 			break;
 		case 'o':
 			if (argv[opt_ind][2] != 0)
-				origin = atoi(argv[opt_ind] + 2);
+				sis->origin = atoi(argv[opt_ind] + 2);
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					origin = atoi(argv[opt_ind]);
+					sis->origin = atoi(argv[opt_ind]);
 				else
 					print_usage();
 			}
@@ -259,26 +458,27 @@ get_options(int argc, char **argv)
 			break;
 		case 's':
 			if (argv[opt_ind][2] != 0)
-				srand(atoi(argv[opt_ind] + 2));
+				sis->rand_seed = atoi(argv[opt_ind] + 2);
 			else {
 				opt_ind++;
 				if ((opt_ind < argc) && (argv[opt_ind][0] != '-'))
-					srand(atoi(argv[opt_ind]));
+					sis->rand_seed = atoi(argv[opt_ind]);
 				else
 					print_usage();
 			}
 			/*
-			   let srand () do error checking.
+			   every value is a valid seed.
 			 */
 			break;
 		case 't':
-			SIStype = SIS_TEXT_MAP;
+			sis->SIStype = SIS_TEXT_MAP;
+			sis->texture_pattern = false;
 			if (argv[opt_ind][2] != 0)
-				strncpy(TFileName, argv[opt_ind] + 2, PATH_MAX);
+				strncpy(sis->TFileName, argv[opt_ind] + 2, PATH_MAX);
 			else {
-				if ((opt_ind + 1 < argc) && (argv[opt_ind + 1][0] != '-')) {
+				if ((opt_ind + 1 < argc) && is_file_arg(argv[opt_ind + 1])) {
 					opt_ind++;
-					strncpy(TFileName, argv[opt_ind], PATH_MAX);
+					strncpy(sis->TFileName, argv[opt_ind], PATH_MAX);
 				}
 			}
 			break;
@@ -293,17 +493,17 @@ get_options(int argc, char **argv)
 				print_usage();
 			for (i = str_ind; isdigit(argv[opt_ind][i]); i++) ;
 			if (!argv[opt_ind][i])
-				SISwidth = atoi(argv[opt_ind] + str_ind);
+				sis->SISwidth = atoi(argv[opt_ind] + str_ind);
 			else {
 				if (!isdigit(argv[opt_ind][i + 1]))
 					print_usage();
-				metric = argv[opt_ind][i];
+				sis->metric = argv[opt_ind][i];
 				argv[opt_ind][i] = 0;
-				resolution = atoi(argv[opt_ind] + i + 1);
-				SISwidth = metric2pixel(atoi(argv[opt_ind] + str_ind),
-				                        resolution);
+				sis->resolution = atoi(argv[opt_ind] + i + 1);
+				sis->SISwidth = metric2pixel(atoi(argv[opt_ind] + str_ind),
+				                        sis->resolution);
 			}
-			if (SISwidth < 1)
+			if (sis->SISwidth < 1)
 				print_usage();
 			break;
 		case 'y':
@@ -317,22 +517,33 @@ get_options(int argc, char **argv)
 				print_usage();
 			for (i = str_ind; isdigit(argv[opt_ind][i]); i++) ;
 			if (!argv[opt_ind][i])
-				SISheight = atoi(argv[opt_ind] + str_ind);
+				sis->SISheight = atoi(argv[opt_ind] + str_ind);
 			else {
 				if (!isdigit(argv[opt_ind][i + 1]))
 					print_usage();
-				metric = argv[opt_ind][i];
+				sis->metric = argv[opt_ind][i];
 				argv[opt_ind][i] = 0;
-				resolution = atoi(argv[opt_ind] + i + 1);
-				SISheight = metric2pixel(atoi(argv[opt_ind] + str_ind),
-				                         resolution);
+				sis->resolution = atoi(argv[opt_ind] + i + 1);
+				sis->SISheight = metric2pixel(atoi(argv[opt_ind] + str_ind),
+				                         sis->resolution);
 			}
-			if (SISheight < 1)
+			if (sis->SISheight < 1)
 				print_usage();
 			break;
+		case '-':
+			get_long_option(argc, argv, &opt_ind);
+			break;
 		default:
 			print_usage();
 		}
 		opt_ind++;
 	}
+	if (sis->scene_shapes) {
+		/// Scenes have no depth file, the only file name is the SIS file
+		if (file_args > 1)
+			print_usage();
+		if (file_args == 1)
+			strncpy(sis->SISFileName, sis->DFileName, PATH_MAX);
+		strncpy(sis->DFileName, "scene", PATH_MAX);
+	}
 }
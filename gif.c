@@ -0,0 +1,279 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "gif.h"
+
+/*
+
+gif writer.
+
+The frames are compressed with LZW as gif needs it: the codes start with one
+bit more than the palette indices need and grow up to 12 bits, the string
+table is cleared when it's full. The strings are found in a hash table of
+(prefix code, index) pairs. The codes are packed into sub-blocks of at most
+255 bytes, least significant bit first.
+
+gif files have at most 256 colors. Random dot stereograms and textures with
+few colors are written with their own palette. Other images get the colors
+of a fixed color cube, without dithering, which would add noise to the
+pattern and break the deltas between the frames of an animation.
+
+*/
+
+#define LZW_MAX_CODE   4096
+#define LZW_HASH_SIZE  8192     /// Power of 2 and larger than LZW_MAX_CODE
+
+static FILE *gif_fp;
+static const char *gif_name;
+static int gif_delay;
+/// Bits of the palette indices in the LZW stream (2-8)
+static int min_code_size;
+
+/// Bit packer for the LZW codes
+static unsigned char block[256];
+static int block_len;
+static uint32_t bit_buf;
+static int bit_count;
+
+/// String table, key is (prefix << 8 | index) + 1, 0 is an empty slot
+static uint32_t hash_key[LZW_HASH_SIZE];
+static uint16_t hash_code[LZW_HASH_SIZE];
+
+
+static void
+write_bytes(const void *data, size_t len)
+{
+	if (len && fwrite(data, 1, len, gif_fp) != len) {
+		fprintf(stderr, "Failed to write %s.\n", gif_name);
+		SISExit(1);
+	}
+}
+
+
+static void
+put_le16(unsigned char *p, unsigned v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+
+static void
+flush_block(void)
+{
+	if (block_len) {
+		block[0] = block_len;
+		write_bytes(block, block_len + 1);
+		block_len = 0;
+	}
+}
+
+
+static void
+put_code(int code, int size)
+{
+	bit_buf |= (uint32_t)code << bit_count;
+	bit_count += size;
+	while (bit_count >= 8) {
+		block[1 + block_len++] = bit_buf;
+		bit_buf >>= 8;
+		bit_count -= 8;
+		if (block_len == 255)
+			flush_block();
+	}
+}
+
+
+static void
+clear_table(void)
+{
+	memset(hash_key, 0, sizeof(hash_key));
+}
+
+
+/// Slot of key in the string table, or the empty slot where it belongs
+static inline uint32_t
+find_slot(uint32_t key)
+{
+	uint32_t h = (key * 2654435761u) >> (32 - 13);
+	while (hash_key[h] && hash_key[h] != key)
+		h = (h + 1) & (LZW_HASH_SIZE - 1);
+	return h;
+}
+
+
+/// LZW compress the rows of the rectangle and write them as sub-blocks
+static void
+write_lzw(const unsigned char *pix, size_t stride, ind_t width, ind_t height)
+{
+	const int clear = 1 << min_code_size, eoi = clear + 1;
+	int next = eoi + 1, code_size = min_code_size + 1;
+	int prefix = -1;
+	unsigned char mcs = min_code_size;
+	write_bytes(&mcs, 1);
+	block_len = 0;
+	bit_buf = 0;
+	bit_count = 0;
+	clear_table();
+	put_code(clear, code_size);
+	for (ind_t y = 0; y < height; y++) {
+		const unsigned char *row = pix + y * stride;
+		for (ind_t x = 0; x < width; x++) {
+			int c = row[x];
+			if (prefix < 0) {
+				prefix = c;
+				continue;
+			}
+			uint32_t key = ((uint32_t)prefix << 8 | c) + 1;
+			uint32_t h = find_slot(key);
+			if (hash_key[h]) {
+				prefix = hash_code[h];
+				continue;
+			}
+			put_code(prefix, code_size);
+			if (next < LZW_MAX_CODE) {
+				hash_key[h] = key;
+				hash_code[h] = next;
+				/// The decoder adds the code one step later, so grow when
+				/// the code that was just added doesn't fit any more
+				if (next++ == (1 << code_size))
+					code_size++;
+			} else {
+				put_code(clear, code_size);
+				clear_table();
+				next = eoi + 1;
+				code_size = min_code_size + 1;
+			}
+			prefix = c;
+		}
+	}
+	if (prefix >= 0)
+		put_code(prefix, code_size);
+	put_code(eoi, code_size);
+	if (bit_count)
+		put_code(0, 8 - bit_count);
+	flush_block();
+	write_bytes("", 1);         /// block terminator
+}
+
+
+void
+GifOpen(const char *FileName, ind_t width, ind_t height, const unsigned char *palette,
+        int colors, long frames, int delay)
+{
+	unsigned char screen[7], table[3 * 256] = {0};
+	int bits = 1;
+	if (width > 0xffff || height > 0xffff) {
+		fprintf(stderr, "gif files can't be larger than 65535x65535.\n");
+		SISExit(1);
+	}
+	while ((1 << bits) < colors)
+		bits++;
+	min_code_size = bits < 2 ? 2 : bits;
+	gif_name = FileName;
+	gif_delay = delay;
+	if (!(gif_fp = OpenOutputFile(FileName))) {
+		fprintf(stderr, "Failed to open %s for writing.\n", FileName);
+		SISExit(1);
+	}
+	write_bytes("GIF89a", 6);
+	put_le16(screen, width);
+	put_le16(screen + 2, height);
+	screen[4] = 0x80 | 7 << 4 | (bits - 1);     /// global color table, 8-bit colors
+	screen[5] = 0;                              /// background color
+	screen[6] = 0;                              /// square pixels
+	write_bytes(screen, 7);
+	memcpy(table, palette, 3 * colors);
+	write_bytes(table, 3 << bits);
+	if (frames > 1) {
+		/// Loop forever
+		static const unsigned char loop[19] = {
+			0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+			3, 1, 0, 0, 0
+		};
+		write_bytes(loop, sizeof(loop));
+	}
+}
+
+
+void
+GifWriteFrame(const unsigned char *pix, size_t stride, ind_t x, ind_t y, ind_t width, ind_t height)
+{
+	unsigned char control[8] = { 0x21, 0xf9, 4, 1 << 2, 0, 0, 0, 0 };   /// leave the frame
+	unsigned char image[10] = { 0x2c };
+	put_le16(control + 4, gif_delay);
+	write_bytes(control, 8);
+	put_le16(image + 1, x);
+	put_le16(image + 3, y);
+	put_le16(image + 5, width);
+	put_le16(image + 7, height);
+	image[9] = 0;               /// no local color table, not interlaced
+	write_bytes(image, 10);
+	write_lzw(pix, stride, width, height);
+}
+
+
+void
+GifClose(void)
+{
+	write_bytes(";", 1);        /// trailer
+	if (CloseOutputFile(gif_fp)) {
+		fprintf(stderr, "Failed to write %s.\n", gif_name);
+		SISExit(1);
+	}
+	gif_fp = NULL;
+}
+
+
+void
+GifCubePalette(unsigned char *palette)
+{
+	for (int i = 0; i < GIF_CUBE_COLORS; i++) {
+		palette[3 * i + 0] = i / 42 * 255 / 5;
+		palette[3 * i + 1] = i / 6 % 7 * 255 / 6;
+		palette[3 * i + 2] = i % 6 * 255 / 5;
+	}
+}
+
+
+void
+GifWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height)
+{
+	unsigned char palette[3 * GIF_CUBE_COLORS];
+	unsigned char *index = (unsigned char *)malloc((size_t)width * height);
+	if (!index) {
+		fprintf(stderr, "Failed to allocate gif image buffer.\n");
+		SISExit(1);
+	}
+	for (size_t i = 0; i < (size_t)width * height; i++, pix += 3)
+		index[i] = GifCubeIndex(pix[0], pix[1], pix[2]);
+	GifCubePalette(palette);
+	GifOpen(FileName, width, height, palette, GIF_CUBE_COLORS, 1, 0);
+	GifWriteFrame(index, width, 0, 0, width, height);
+	GifClose();
+	free(index);
+}
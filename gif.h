@@ -0,0 +1,46 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sis.h"
+
+/// gif file with frames frames of width x height pixels, which are shown for
+/// delay hundredths of a second each. The colors of the palette are 8-bit
+/// RGB triplets, at most 256 of them.
+void GifOpen(const char *FileName, ind_t width, ind_t height, const unsigned char *palette,
+             int colors, long frames, int delay);
+/// Write a frame of palette indices that replaces the rectangle at (x, y).
+/// pix points to the top left pixel of the rectangle, its rows are stride
+/// bytes apart.
+void GifWriteFrame(const unsigned char *pix, size_t stride, ind_t x, ind_t y, ind_t width, ind_t height);
+void GifClose(void);
+
+/// RGB images are written with the colors of a 6x7x6 color cube
+#define GIF_CUBE_COLORS 252
+void GifCubePalette(unsigned char *palette);
+/// Index of the nearest color of the color cube
+static inline unsigned char
+GifCubeIndex(int r, int g, int b)
+{
+	return (r * 5 + 127) / 255 * 42 + (g * 6 + 127) / 255 * 6 + (b * 5 + 127) / 255;
+}
+/// Write an RGB image as gif file with the colors of the color cube
+void GifWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height);
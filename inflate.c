@@ -0,0 +1,374 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+
+/*
+
+Streaming inflate (RFC 1951) for the depth map readers.
+
+The decompressed data is pulled in pieces of any size with Inflate(), the
+compressed data is pulled from a read function when it's needed. Only the
+32k window of the last decompressed bytes is kept, so images of any size
+can be decoded row by row. Decoding stops in the middle of a block when
+enough bytes are produced and continues there with the next call.
+
+*/
+
+#define WINDOW_SIZE   32768
+#define FAST_BITS     10
+#define IN_SIZE       65536
+
+typedef struct {
+	uint16_t count[16];           /// Number of codes of each length
+	uint16_t symbol[288];         /// Symbols ordered by code
+	uint16_t fast[1 << FAST_BITS];/// length << 9 | symbol of short codes, 0 if longer
+} huffman_t;
+
+enum { BLOCK_HEADER, BLOCK_STORED, BLOCK_HUFFMAN, BLOCK_DONE };
+
+struct inflate_s {
+	inflate_read_fn read;
+	void *ctx;
+	unsigned char in[IN_SIZE];
+	size_t in_pos, in_len;
+	uint64_t bits;
+	int bit_count;
+	/// Bytes that were read beyond the end of the input
+	int overrun;
+	unsigned char window[WINDOW_SIZE];
+	uint64_t window_pos;       /// Number of bytes decompressed so far
+	int state;
+	bool final;
+	size_t stored_left;
+	int match_len, match_dist;
+	huffman_t lit, dist;
+	bool error;
+};
+
+static const uint16_t length_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+
+static int
+next_byte(inflate_t *s)
+{
+	if (s->in_pos == s->in_len) {
+		s->in_pos = 0;
+		s->in_len = s->read(s->ctx, s->in, IN_SIZE);
+		if (s->in_len == 0) {
+			/// Pad with zeros, a stream that needs them is broken
+			s->overrun++;
+			return 0;
+		}
+	}
+	return s->in[s->in_pos++];
+}
+
+
+static inline void
+need_bits(inflate_t *s, int count)
+{
+	while (s->bit_count < count) {
+		s->bits |= (uint64_t)next_byte(s) << s->bit_count;
+		s->bit_count += 8;
+	}
+}
+
+
+static inline uint32_t
+get_bits(inflate_t *s, int count)
+{
+	need_bits(s, count);
+	uint32_t v = s->bits & ((1u << count) - 1);
+	s->bits >>= count;
+	s->bit_count -= count;
+	return v;
+}
+
+
+/// Build the canonical Huffman code of the code lengths, returns false for
+/// oversubscribed codes
+static bool
+build_huffman(huffman_t *h, const uint8_t *lengths, int n)
+{
+	uint16_t offset[16];
+	memset(h->count, 0, sizeof(h->count));
+	memset(h->fast, 0, sizeof(h->fast));
+	for (int i = 0; i < n; i++)
+		h->count[lengths[i]]++;
+	h->count[0] = 0;
+	int left = 1;
+	for (int len = 1; len < 16; len++) {
+		left = (left << 1) - h->count[len];
+		if (left < 0)
+			return false;
+	}
+	offset[1] = 0;
+	for (int len = 1; len < 15; len++)
+		offset[len + 1] = offset[len] + h->count[len];
+	for (int i = 0; i < n; i++) {
+		if (lengths[i])
+			h->symbol[offset[lengths[i]]++] = i;
+	}
+	/// Lookup table of the codes up to FAST_BITS, indexed with the bit
+	/// reversed code as it comes from the stream
+	int code = 0, index = 0;
+	for (int len = 1; len <= FAST_BITS; len++) {
+		for (int i = 0; i < h->count[len]; i++, code++, index++) {
+			int rev = 0;
+			for (int b = 0; b < len; b++)
+				rev |= ((code >> b) & 1) << (len - 1 - b);
+			for (int fill = rev; fill < (1 << FAST_BITS); fill += 1 << len)
+				h->fast[fill] = len << 9 | h->symbol[index];
+		}
+		code <<= 1;
+	}
+	return true;
+}
+
+
+static int
+decode_symbol(inflate_t *s, const huffman_t *h)
+{
+	need_bits(s, 15);
+	uint16_t entry = h->fast[s->bits & ((1 << FAST_BITS) - 1)];
+	if (entry) {
+		s->bits >>= entry >> 9;
+		s->bit_count -= entry >> 9;
+		return entry & 0x1ff;
+	}
+	/// Codes longer than FAST_BITS are decoded bit by bit
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len < 16; len++) {
+		code |= get_bits(s, 1);
+		int count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	s->error = true;
+	return 256;
+}
+
+
+static void
+fixed_tables(inflate_t *s)
+{
+	uint8_t lengths[288];
+	int i = 0;
+	for (; i < 144; i++) lengths[i] = 8;
+	for (; i < 256; i++) lengths[i] = 9;
+	for (; i < 280; i++) lengths[i] = 7;
+	for (; i < 288; i++) lengths[i] = 8;
+	build_huffman(&s->lit, lengths, 288);
+	for (i = 0; i < 30; i++) lengths[i] = 5;
+	build_huffman(&s->dist, lengths, 30);
+}
+
+
+static void
+dynamic_tables(inflate_t *s)
+{
+	static const uint8_t order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	uint8_t lengths[288 + 32];
+	huffman_t code_len;
+	int nlen = get_bits(s, 5) + 257;
+	int ndist = get_bits(s, 5) + 1;
+	int ncode = get_bits(s, 4) + 4;
+	memset(lengths, 0, 19);
+	for (int i = 0; i < ncode; i++)
+		lengths[order[i]] = get_bits(s, 3);
+	if (!build_huffman(&code_len, lengths, 19)) {
+		s->error = true;
+		return;
+	}
+	for (int i = 0; i < nlen + ndist;) {
+		int sym = decode_symbol(s, &code_len);
+		int len = 0, repeat;
+		if (sym < 16) {
+			lengths[i++] = sym;
+			continue;
+		} else if (sym == 16) {
+			if (i == 0) {
+				s->error = true;
+				return;
+			}
+			len = lengths[i - 1];
+			repeat = 3 + get_bits(s, 2);
+		} else if (sym == 17) {
+			repeat = 3 + get_bits(s, 3);
+		} else {
+			repeat = 11 + get_bits(s, 7);
+		}
+		if (i + repeat > nlen + ndist) {
+			s->error = true;
+			return;
+		}
+		while (repeat--)
+			lengths[i++] = len;
+	}
+	if (!build_huffman(&s->lit, lengths, nlen) ||
+	    !build_huffman(&s->dist, lengths + nlen, ndist))
+		s->error = true;
+}
+
+
+static void
+block_header(inflate_t *s)
+{
+	if (s->final) {
+		s->state = BLOCK_DONE;
+		return;
+	}
+	s->final = get_bits(s, 1);
+	switch (get_bits(s, 2)) {
+	case 0:
+		/// Stored blocks start on a byte boundary
+		get_bits(s, s->bit_count & 7);
+		s->stored_left = get_bits(s, 16);
+		if ((get_bits(s, 16) ^ 0xffff) != s->stored_left)
+			s->error = true;
+		s->state = BLOCK_STORED;
+		break;
+	case 1:
+		fixed_tables(s);
+		s->state = BLOCK_HUFFMAN;
+		break;
+	case 2:
+		dynamic_tables(s);
+		s->state = BLOCK_HUFFMAN;
+		break;
+	default:
+		s->error = true;
+	}
+}
+
+
+static inline void
+put_out(inflate_t *s, unsigned char **dst, unsigned char b)
+{
+	s->window[s->window_pos++ & (WINDOW_SIZE - 1)] = b;
+	*(*dst)++ = b;
+}
+
+
+inflate_t *
+InflateNew(inflate_read_fn read, void *ctx)
+{
+	inflate_t *s = (inflate_t *)calloc(1, sizeof(inflate_t));
+	if (!s) {
+		fprintf(stderr, "Failed to allocate decompression buffer.\n");
+		SISExit(1);
+	}
+	s->read = read;
+	s->ctx = ctx;
+	s->state = BLOCK_HEADER;
+	return s;
+}
+
+
+void
+InflateFree(inflate_t *s)
+{
+	free(s);
+}
+
+
+size_t
+Inflate(inflate_t *s, unsigned char *dst, size_t n)
+{
+	unsigned char *p = dst, *end = dst + n;
+	while (p < end && !s->error && s->state != BLOCK_DONE) {
+		if (s->match_len) {
+			while (s->match_len && p < end) {
+				put_out(s, &p, s->window[(s->window_pos - s->match_dist) & (WINDOW_SIZE - 1)]);
+				s->match_len--;
+			}
+			continue;
+		}
+		switch (s->state) {
+		case BLOCK_HEADER:
+			block_header(s);
+			break;
+		case BLOCK_STORED:
+			while (s->stored_left && p < end) {
+				put_out(s, &p, get_bits(s, 8));
+				s->stored_left--;
+			}
+			if (!s->stored_left)
+				s->state = BLOCK_HEADER;
+			break;
+		case BLOCK_HUFFMAN: {
+			int sym = decode_symbol(s, &s->lit);
+			if (sym < 256) {
+				put_out(s, &p, sym);
+			} else if (sym == 256) {
+				s->state = BLOCK_HEADER;
+			} else if (sym <= 285) {
+				sym -= 257;
+				s->match_len = length_base[sym] + get_bits(s, length_extra[sym]);
+				int dsym = decode_symbol(s, &s->dist);
+				if (dsym >= 30) {
+					s->error = true;
+					break;
+				}
+				s->match_dist = dist_base[dsym] + get_bits(s, dist_extra[dsym]);
+				if ((uint64_t)s->match_dist > s->window_pos)
+					s->error = true;
+			} else {
+				s->error = true;
+			}
+			break;
+		}
+		}
+		/// More than the 8 bytes of the bit buffer were made up
+		if (s->overrun > 8)
+			s->error = true;
+	}
+	return p - dst;
+}
+
+
+bool
+InflateError(const inflate_t *s)
+{
+	return s->error;
+}
@@ -0,0 +1,446 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "scene.h"
+#include "dprep.h"
+#include "libsis.h"
+
+/*
+
+The library interface of sis (see libsis.h).
+
+Each context has a renderer state of its own (sis_state_t), a call points
+sis to it while it runs. A render applies the options of the context to
+the state, opens the depth map of the context with the Lib_ backend below
+and writes the rows with the Lib_ output backend into the buffer or to the
+callback of the caller. Contexts in different threads render at the same
+time, the file backends of sis (png, tiff, y4m, ...) aren't used here.
+
+Errors of the renderer call SISExit(), which jumps back to the render
+while sis_error_jump is set; ParallelFor() hands the errors of its worker
+threads on to the calling thread. The resources that were opened until then
+are released.
+
+*/
+
+struct sis_context {
+	/// "sis" and the options, args is the copy that get_options() changes in place
+	int argc;
+	char **options;
+	char **args;
+	/// Depth map
+	const void *depth;
+	long width, height;
+	size_t stride;
+	int bits;
+	/// Destination of the rendered rows
+	unsigned char *rgb;
+	size_t rgb_stride;
+	sis_row_fn row_fn;
+	void *user;
+	unsigned char *row;
+	/// State of the random numbers of a render, seeded with -s
+	uint32_t rand_state;
+	/// State of the renderer
+	sis_state_t *state;
+};
+
+/// What run() does with a context
+#define LIB_CHECK    0    /// Check the options
+#define LIB_SIZE     1    /// Size of the SIS
+#define LIB_RENDER   2
+
+/// Stages of a render, the resources of each are released in reverse order
+#define STAGE_OPTIONS 1
+#define STAGE_DEPTH   2
+#define STAGE_TEXTURE 3
+#define STAGE_BUFFERS 4
+
+const bool gui = false;
+
+
+/// Renders of the library don't print row statistics
+void
+show_statistics(const sis_stats_t *stats)
+{
+}
+
+
+static void
+Lib_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	sis_context *ctx = sis->context;
+	*width = ctx->width;
+	*height = ctx->height;
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+static void
+Lib_ReadDBuffer(ind_t r)
+{
+	sis_context *ctx = sis->context;
+	col_t lo, hi;
+	const unsigned char *row = (const unsigned char *)ctx->depth + r * ctx->stride;
+	if (ctx->bits == 16) {
+		sis->IngestDepthRow16(DBuffer, (const uint16_t *)row, sis->Dwidth, &lo, &hi);
+		DaddRange(lo, hi, 0);
+		return;
+	}
+	sis->IngestDepthRow(DBuffer, row, sis->Dwidth, &lo, &hi);
+	DaddRange(lo, hi, 8);
+}
+
+
+static void
+Lib_CloseDFile(void)
+{
+}
+
+
+/// The depth map belongs to the caller
+static unsigned char *
+Lib_GetDFileBuffer(void)
+{
+	return NULL;
+}
+
+
+static void
+Lib_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	sis_context *ctx = sis->context;
+	if (!ctx->rgb && !(ctx->row = (unsigned char *)malloc(3 * width))) {
+		fprintf(stderr, "Failed to allocate the SIS row.\n");
+		SISExit(1);
+	}
+}
+
+
+static void
+Lib_WriteSISColorBuffer(ind_t r)
+{
+	sis_context *ctx = sis->context;
+	unsigned char *dst = ctx->rgb ? ctx->rgb + r * ctx->rgb_stride : ctx->row;
+	for (ind_t c = 0; c < sis->SISwidth; c++) {
+		dst[3 * c + 0] = SIScolorRGB[c].r;
+		dst[3 * c + 1] = SIScolorRGB[c].g;
+		dst[3 * c + 2] = SIScolorRGB[c].b;
+	}
+	if (ctx->row_fn)
+		ctx->row_fn(ctx->user, r, dst, sis->SISwidth);
+}
+
+
+static void
+Lib_WriteSISFile(void)
+{
+}
+
+
+static void
+Lib_CloseSISFile(void)
+{
+	sis_context *ctx = sis->context;
+	free(ctx->row);
+	ctx->row = NULL;
+}
+
+
+/// The SIS is in the buffer of the caller
+static unsigned char *
+Lib_GetSISFileBuffer(void)
+{
+	sis_context *ctx = sis->context;
+	return ctx->rgb;
+}
+
+
+static void
+free_args(sis_context *ctx)
+{
+	if (!ctx->args)
+		return;
+	for (int i = 0; i < ctx->argc; i++)
+		free(ctx->args[i]);
+	free(ctx->args);
+	ctx->args = NULL;
+}
+
+
+/// Reset the state and apply the options of its context, false if there is no memory
+static bool
+apply_options(void)
+{
+	sis_context *ctx = sis->context;
+	InitFuncs();
+	SetDefaults();
+	sis->SISred = (cmap_t *)calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	sis->SISgreen = (cmap_t *)calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	sis->SISblue = (cmap_t *)calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	if (!sis->SISred || !sis->SISgreen || !sis->SISblue)
+		return false;
+	if (ctx->argc <= 1)
+		return true;
+	if (!(ctx->args = (char **)calloc(ctx->argc, sizeof(char *))))
+		return false;
+	for (int i = 0; i < ctx->argc; i++) {
+		if (!(ctx->args[i] = strdup(ctx->options[i])))
+			return false;
+	}
+	get_options(ctx->argc, ctx->args);
+	return true;
+}
+
+
+/// Release what the stages up to stage opened
+static void
+release(int stage)
+{
+	sis_context *ctx = sis->context;
+	if (stage >= STAGE_BUFFERS) {
+		sis->CloseSISFile();
+		FreeBuffers();
+	}
+	if (stage >= STAGE_TEXTURE && sis->SIStype == SIS_TEXT_MAP)
+		sis->CloseTFile(sis->Theight);
+	if (stage >= STAGE_DEPTH)
+		sis->CloseDFile();
+	free(sis->SISred);
+	free(sis->SISgreen);
+	free(sis->SISblue);
+	sis->SISred = sis->SISgreen = sis->SISblue = NULL;
+	free_args(ctx);
+}
+
+
+/// Open the depth map and the texture of the context and render the SIS
+static void
+render(volatile int *stage)
+{
+	sis->OpenDFile = Lib_OpenDFile;
+	sis->ReadDBuffer = Lib_ReadDBuffer;
+	sis->CloseDFile = Lib_CloseDFile;
+	sis->GetDFileBuffer = Lib_GetDFileBuffer;
+	sis->OpenDFile(sis->DFileName, &sis->Dwidth, &sis->Dheight);
+	*stage = STAGE_DEPTH;
+	if (sis->depth_prep)
+		PrepDepthMap();
+	OpenTexture();
+	*stage = STAGE_TEXTURE;
+	/// The rows are always RGB
+	sis->indexed_output = false;
+	sis->SISPixelFormat = SIS_PIXFMT_RGB;
+	InitAlgorithm();
+	sis->CreateSISBuffer = Lib_CreateSISBuffer;
+	sis->WriteSISColorBuffer = Lib_WriteSISColorBuffer;
+	sis->WriteSISFile = Lib_WriteSISFile;
+	sis->CloseSISFile = Lib_CloseSISFile;
+	sis->GetSISFileBuffer = Lib_GetSISFileBuffer;
+	AllocBuffers();
+	*stage = STAGE_BUFFERS;
+	sis->CreateSISBuffer(sis->SISwidth, sis->SISheight, sis->SIStype);
+	render_sis();
+	sis->WriteSISFile();
+}
+
+
+/// Apply the options of ctx to its state and do what with them
+static int
+run(sis_context *ctx, int what, long *width, long *height)
+{
+	jmp_buf jump;
+	volatile int stage = 0;
+	int error = SIS_OK;
+	sis_state_t *outer = sis;
+	sis = ctx->state;
+	sis->context = ctx;
+	sis_error_jump = &jump;
+	if (setjmp(jump)) {
+		/// Invalid options end in print_usage()
+		error = stage < STAGE_OPTIONS ? SIS_ERROR_ARGUMENT : SIS_ERROR_RENDER;
+	} else if (!apply_options()) {
+		error = SIS_ERROR_MEMORY;
+	} else {
+		stage = STAGE_OPTIONS;
+		/// Scenes are depth maps of their own
+		if (sis->scene_shapes || (what != LIB_CHECK && !ctx->depth)) {
+			error = SIS_ERROR_ARGUMENT;
+		} else if (what == LIB_SIZE) {
+			sis->Dwidth = ctx->width;
+			sis->Dheight = ctx->height;
+			InitSISSize();
+			*width = sis->SISwidth;
+			*height = sis->SISheight;
+		} else if (what == LIB_RENDER) {
+			/// The random dots don't use rand(), they are the same for each
+			/// render with the same options
+			ctx->rand_state = sis->rand_seed * 0x9e3779b9u | 1;
+			SetDotSeed(&ctx->rand_state);
+			render(&stage);
+		}
+	}
+	SetDotSeed(NULL);
+	sis_error_jump = NULL;
+	release(stage);
+	sis = outer;
+	return error;
+}
+
+
+sis_context *
+sis_create(void)
+{
+	sis_context *ctx = (sis_context *)calloc(1, sizeof(sis_context));
+	if (!ctx)
+		return NULL;
+	ctx->options = (char **)calloc(1, sizeof(char *));
+	if (!ctx->options || !(ctx->options[0] = strdup("sis")) || !(ctx->state = NewState())) {
+		if (ctx->options)
+			free(ctx->options[0]);
+		free(ctx->options);
+		free(ctx);
+		return NULL;
+	}
+	ctx->argc = 1;
+	return ctx;
+}
+
+
+void
+sis_destroy(sis_context *ctx)
+{
+	if (!ctx)
+		return;
+	for (int i = 0; i < ctx->argc; i++)
+		free(ctx->options[i]);
+	free(ctx->options);
+	FreeState(ctx->state);
+	free(ctx);
+}
+
+
+int
+sis_set_options(sis_context *ctx, int argc, const char *const *argv)
+{
+	/// File names would be taken as the depth map and the SIS file
+	if (argc < 0 || (argc > 0 && (argv[0][0] != '-' || !argv[0][1])))
+		return SIS_ERROR_ARGUMENT;
+	char **options = (char **)calloc(argc + 1, sizeof(char *));
+	if (!options)
+		return SIS_ERROR_MEMORY;
+	bool copied = (options[0] = strdup("sis")) != NULL;
+	for (int i = 0; i < argc && copied; i++)
+		copied = (options[i + 1] = strdup(argv[i])) != NULL;
+	if (!copied) {
+		for (int i = 0; i <= argc; i++)
+			free(options[i]);
+		free(options);
+		return SIS_ERROR_MEMORY;
+	}
+	for (int i = 0; i < ctx->argc; i++)
+		free(ctx->options[i]);
+	free(ctx->options);
+	ctx->options = options;
+	ctx->argc = argc + 1;
+	/// Invalid options are reported here rather than when rendering
+	return run(ctx, LIB_CHECK, NULL, NULL);
+}
+
+
+int
+sis_set_depth(sis_context *ctx, const void *depth, long width, long height,
+              size_t stride, int bits)
+{
+	if (!depth || width <= 0 || height <= 0 || (bits != 8 && bits != 16)
+	    || stride < (size_t)width * (bits / 8))
+		return SIS_ERROR_ARGUMENT;
+	ctx->depth = depth;
+	ctx->width = width;
+	ctx->height = height;
+	ctx->stride = stride;
+	ctx->bits = bits;
+	return SIS_OK;
+}
+
+
+int
+sis_get_size(sis_context *ctx, long *width, long *height)
+{
+	return run(ctx, LIB_SIZE, width, height);
+}
+
+
+int
+sis_render(sis_context *ctx, unsigned char *rgb, size_t stride)
+{
+	long width, height;
+	int error = sis_get_size(ctx, &width, &height);
+	if (error != SIS_OK)
+		return error;
+	if (!rgb || stride < 3 * (size_t)width)
+		return SIS_ERROR_ARGUMENT;
+	ctx->rgb = rgb;
+	ctx->rgb_stride = stride;
+	ctx->row_fn = NULL;
+	error = run(ctx, LIB_RENDER, NULL, NULL);
+	ctx->rgb = NULL;
+	return error;
+}
+
+
+int
+sis_render_rows(sis_context *ctx, sis_row_fn row_fn, void *user)
+{
+	if (!row_fn)
+		return SIS_ERROR_ARGUMENT;
+	ctx->rgb = NULL;
+	ctx->row_fn = row_fn;
+	ctx->user = user;
+	int error = run(ctx, LIB_RENDER, NULL, NULL);
+	ctx->row_fn = NULL;
+	return error;
+}
+
+
+const char *
+sis_error_string(int error)
+{
+	switch (error) {
+	case SIS_OK:
+		return "no error";
+	case SIS_ERROR_ARGUMENT:
+		return "invalid option, depth map or buffer";
+	case SIS_ERROR_MEMORY:
+		return "out of memory";
+	case SIS_ERROR_RENDER:
+		return "render failed";
+	default:
+		return "unknown error";
+	}
+}
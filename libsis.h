@@ -0,0 +1,90 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIBSIS_INCLUDED
+#define LIBSIS_INCLUDED
+
+#include <stddef.h>
+
+/*
+
+libsis renders SISs from depth maps in memory into buffers of the caller.
+
+A context holds the options and the depth map of a render. The options are
+the command line options of sis without file names. Each function returns
+SIS_OK or an error code, errors never end the process, also not those in
+the worker threads of a render. The random dots don't change the rand()
+state of the caller.
+
+    sis_context *ctx = sis_create();
+    const char *options[] = { "-a", "4", "-t", "textures/beans.png", "-x", "1920" };
+    sis_set_options(ctx, 6, options);
+    sis_set_depth(ctx, depth, 640, 480, 640 * 2, 16);
+    sis_get_size(ctx, &width, &height);
+    sis_render(ctx, rgb, width * 3);
+    sis_destroy(ctx);
+
+Each context has its own renderer state, so threads with their own
+contexts render at the same time. A context is used by one thread at a
+time. A single render uses all CPU cores where the renderer works in
+parallel (depth preprocessing, texture resampling).
+
+*/
+
+typedef struct sis_context sis_context;
+
+/// Return values
+#define SIS_OK              0
+#define SIS_ERROR_ARGUMENT  1   /// Invalid option, depth map or buffer
+#define SIS_ERROR_MEMORY    2
+#define SIS_ERROR_RENDER    3   /// E.g. the texture couldn't be loaded, the reason is printed to stderr
+
+/// Receives row number row of the SIS, width dots with 8-bit red, green and blue
+typedef void (*sis_row_fn)(void *user, long row, const unsigned char *rgb, long width);
+
+/// New context with the default options, NULL if there is no memory
+sis_context *sis_create(void);
+void sis_destroy(sis_context *ctx);
+
+/// Options like on the command line, e.g. { "-a", "4", "--depth-filter", "lanczos" },
+/// without the depth and SIS file names. They replace the options set before.
+/// Invalid options return SIS_ERROR_ARGUMENT, the usage of sis isn't printed.
+int sis_set_options(sis_context *ctx, int argc, const char *const *argv);
+
+/// Depth map of width x height values with 8 or 16 bits, rows are stride bytes
+/// apart. It isn't copied and has to stay valid while the context renders.
+int sis_set_depth(sis_context *ctx, const void *depth, long width, long height,
+                  size_t stride, int bits);
+
+/// Size of the SIS that the options and the depth map give
+int sis_get_size(sis_context *ctx, long *width, long *height);
+
+/// Render the SIS into rgb, 3 bytes per dot, rows are stride bytes apart
+int sis_render(sis_context *ctx, unsigned char *rgb, size_t stride);
+
+/// Render the SIS and pass each row to row_fn as soon as it is rendered
+int sis_render_rows(sis_context *ctx, sis_row_fn row_fn, void *user);
+
+/// Message of an error code
+const char *sis_error_string(int error);
+
+#endif     /// LIBSIS_INCLUDED
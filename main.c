@@ -24,6 +24,11 @@
 #include <stdio.h>
 
 #include "sis.h"
+#include "video.h"
+#include "sequence.h"
+#include "pattern.h"
+#include "dprep.h"
+#include "resample.h"
 
 const bool gui = false;
 
@@ -31,14 +36,10 @@ const bool gui = false;
 static void
 print_warnings(void)
 {
-	if (algorithm < 4 && oversam > 1) {
-		fprintf(stderr, "warning: oversampling is currently only available with algorithm 4\n");
-		oversam = 1;
-	}
-	if (algorithm == 4 && SIStype != SIS_TEXT_MAP) {
+	if (sis->algorithm == 4 && sis->SIStype != SIS_TEXT_MAP) {
 		fprintf(stderr, "warning: random dot stereograms currently don't work properly with algorithm 4. \n");
 	}
-	if (algorithm == 4 && verbose == 1) {
+	if (sis->algorithm == 4 && sis->verbose == 1) {
 		fprintf(stderr, "warning: verbose output is currently limited with algorithm 4\n");
 	}
 	// if (algorithm == 4 && SISwidth != Dwidth) {
@@ -50,27 +51,60 @@ print_warnings(void)
 static void
 print_message_header(void)
 {
-	printf("\n  DEPTH FILE:     %s (%ldx%ld)\n", DFileName, Dwidth, Dheight);
-	printf("  SIS FILE:       %s (%ldx%ld)\n\n", SISFileName, SISwidth,
-	       SISheight);
-	if (SIStype == SIS_TEXT_MAP) {
-		printf("  ... using texture-map: %s\n\n\n", TFileName);
+	if (sis->depth_prep)
+		printf("\n  DEPTH FILE:     %s (%ldx%ld)\n", sis->DFileName, sis->depth_source_width, sis->depth_source_height);
+	else
+		printf("\n  DEPTH FILE:     %s (%ldx%ld)\n", sis->DFileName, sis->Dwidth, sis->Dheight);
+	printf("  SIS FILE:       %s (%ldx%ld)\n\n", sis->SISFileName, sis->SISwidth,
+	       sis->SISheight);
+	if (sis->depth_prep && sis->depth_prep_spec[0])
+		printf("  ... preprocessing depth map: %s\n\n", sis->depth_prep_spec);
+	if (sis->depth_filter >= 0)
+		printf("  ... resampling depth map: %s\n\n", ResampleFilterName(sis->depth_filter));
+	if (sis->SIStype == SIS_TEXT_MAP && sis->texture_pattern) {
+		printf("  ... using pattern: %s\n\n", sis->TFileName);
+	} else if (sis->SIStype == SIS_TEXT_MAP) {
+		printf("  ... using texture-map: %s", sis->TFileName);
+		if (sis->texture_scale != 0.0f)
+			printf(" (resampled to %ldx%ld)", sis->Twidth, sis->Theight);
+		printf("\n\n");
+	}
+	PrintKernels();
+	printf("\n\n");
+	if (sis->ImgFileFormat == SIS_IMGFMT_Y4M) {
+		printf("  Frame\n");
+		return;
+	}
+	if (sequence) {
+		/// Rows that didn't change from the frame before aren't rendered
+		printf("   Frame    Rows\n");
+		return;
 	}
+#ifndef NO_STATS
 	printf("  ----    --- PROPAGATE ---    ---- OBSCURE ----     --- DEPTH ---\n");
 	printf("  Line       inner    outer        forw    backw      min      max\n");
+#else
+	printf("  ----     --- DEPTH ---\n");
+	printf("  Line       min      max\n");
+#endif
 }
 
 
 static void
-print_statistics(void)
+print_statistics(const sis_stats_t *stats)
 {
-	printf("  %4ld    %8ld %8ld    %8ld %8ld   %6ld   %6ld\r", SISLineNumber + 1,
-	       inner_propagate_c, outer_propagate_c,
-	       forwards_obscure_c, backwards_obscure_c,
+#ifndef NO_STATS
+	printf("  %4ld    %8ld %8ld    %8ld %8ld   %6ld   %6ld\r", sis->SISLineNumber + 1,
+	       stats->inner_propagate, stats->outer_propagate,
+	       stats->forwards_obscure, stats->backwards_obscure,
 	       min_depth_in_row, max_depth_in_row);
+#else
+	printf("  %4ld    %6ld   %6ld\r", sis->SISLineNumber + 1,
+	       min_depth_in_row, max_depth_in_row);
+#endif
 	if (fflush(stdout)) {
 		printf("stdout didn't flush\n");
-		verbose = 0;
+		sis->verbose = 0;
 	}
 }
 
@@ -78,17 +112,73 @@ print_statistics(void)
 static void
 print_summary(void)
 {
-	printf("  Depth map values range: [%ld, %ld]\n", min_depth, max_depth);
-	if (SIStype == SIS_TEXT_MAP) {
-		printf("  Texture unique color count: %ld\n", Tcolcount);
+	printf("  Depth map values range: [%ld, %ld]\n", sis->min_depth, sis->max_depth);
+	if (sis->SIStype == SIS_TEXT_MAP) {
+		if (sis->texture_pattern)
+			printf("  Texture colors: procedural RGB\n");
+		else if (sis->direct_rgb)
+			printf("  Texture colors: direct RGB\n");
+		else
+			printf("  Texture unique color count: %ld\n", sis->Tcolcount);
 	}
+	if (sis->SISPixelFormat == SIS_PIXFMT_BILEVEL)
+		printf("  Output colors: black and white, 1 bit per dot\n");
+	else if (sis->indexed_output)
+		printf("  Output palette color count: %d\n", sis->SISPaletteSize);
+}
+
+
+static void
+print_json_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', fp);
+		fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+
+/// Dump the merged statistics of the last render as a JSON object
+static void
+write_stats_json(void)
+{
+	FILE *fp = fopen(sis->StatsFileName, "w");
+	if (!fp) {
+		fprintf(stderr, "failed to open statistics file '%s'\n", sis->StatsFileName);
+		return;
+	}
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"depth_file\": ");
+	print_json_string(fp, sis->DFileName);
+	fprintf(fp, ",\n  \"sis_file\": ");
+	print_json_string(fp, sis->SISFileName);
+	fprintf(fp, ",\n");
+	fprintf(fp, "  \"width\": %ld,\n", sis->SISwidth);
+	fprintf(fp, "  \"height\": %ld,\n", sis->SISheight);
+	fprintf(fp, "  \"algorithm\": %d,\n", sis->algorithm);
+	fprintf(fp, "  \"min_depth\": %ld,\n", sis->min_depth);
+	fprintf(fp, "  \"max_depth\": %ld,\n", sis->max_depth);
+#ifndef NO_STATS
+	fprintf(fp, "  \"inner_propagate\": %ld,\n", sis->render_stats.inner_propagate);
+	fprintf(fp, "  \"outer_propagate\": %ld,\n", sis->render_stats.outer_propagate);
+	fprintf(fp, "  \"forwards_obscure\": %ld,\n", sis->render_stats.forwards_obscure);
+	fprintf(fp, "  \"backwards_obscure\": %ld,\n", sis->render_stats.backwards_obscure);
+	fprintf(fp, "  \"instrumented\": true\n");
+#else
+	fprintf(fp, "  \"instrumented\": false\n");
+#endif
+	fprintf(fp, "}\n");
+	fclose(fp);
 }
 
 
 void
-show_statistics(void)
+show_statistics(const sis_stats_t *stats)
 {
-	print_statistics();
+	print_statistics(stats);
 }
 
 
@@ -97,15 +187,23 @@ main(int argc, char **argv)
 {
 	init_all(argc, argv);
 	print_warnings();
-	if (verbose) {
+	if (sis->verbose) {
 		print_message_header();
 	}
-	render_sis();
-	if (verbose) {
+	if (sis->ImgFileFormat == SIS_IMGFMT_Y4M)
+		render_video();
+	else if (sequence)
+		render_sequence();
+	else
+		render_sis();
+	if (sis->verbose) {
 		puts("\n");
 		print_summary();
 	}
-	WriteSISFile();
+	if (sis->StatsFileName[0]) {
+		write_stats_json();
+	}
+	sis->WriteSISFile();
 	finish_all();
 	return EXIT_SUCCESS;
 }
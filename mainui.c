@@ -81,7 +81,7 @@ SDL_GLContext sdlGLContext = NULL;
 
 const char *window_title = "SIS Stereogram Generator";
 const char *image_read_extensions = "png,jpg,bmp,gif,hdr,tga,pic";
-const char *image_write_extensions = "png";
+const char *image_write_extensions = "png,qoi,bmp,tga,jpg,tif,ppm,pbm";
 static char dropped_file[PATH_MAX];
 static int  dropped_file_len = 0;
 static bool use_gl = false;
@@ -167,7 +167,7 @@ typedef struct {
 
 
 void
-show_statistics(void)
+show_statistics(const sis_stats_t *stats)
 {
 }
 
@@ -226,8 +226,9 @@ sis_button_handler(int item, UIevent event)
     nfdresult_t result = NFD_SaveDialogU8_With(&outPath, &args);
     if (result == NFD_OKAY) {
 		fprintf(stderr, "saving sis image to '%s'\n", outPath);
-		strncpy(SISFileName, outPath, PATH_MAX);
-		WriteSISFile();
+		strncpy(sis->SISFileName, outPath, PATH_MAX);
+		sis->ImgFileFormat = ImgFileFormatFromName(sis->SISFileName);
+		sis->WriteSISFile();
         free(outPath);
     }
 #endif
@@ -253,7 +254,7 @@ depth_button_handler(int item, UIevent event)
     nfdresult_t result = NFD_OpenDialogU8_With(&outPath, &args);
     if (result == NFD_OKAY) {
 		fprintf(stderr, "loading depth image '%s'\n", outPath);
-		strncpy(DFileName, outPath, PATH_MAX);
+		strncpy(sis->DFileName, outPath, PATH_MAX);
 		update_depth_map_and_sis();
         free(outPath);
 		update_sis_view = true;
@@ -278,7 +279,7 @@ texture_button_handler(int item, UIevent event)
     nfdresult_t result = NFD_OpenDialogU8_With(&outPath, &args);
     if (result == NFD_OKAY) {
 		fprintf(stderr, "loading texture image '%s'\n", outPath);
-		strncpy(TFileName, outPath, PATH_MAX);
+		strncpy(sis->TFileName, outPath, PATH_MAX);
 		update_texture();
 		update_sis();
         free(outPath);
@@ -316,6 +317,9 @@ void
 update_sis(void)
 {
 	InitAlgorithm();
+	/// The size of the row buffers depends on the algorithm which might have changed
+	FreeBuffers();
+	AllocBuffers();
 	render_sis();
 	update_sis_image();
 }
@@ -324,9 +328,9 @@ update_sis(void)
 void
 update_texture(void)
 {
-	CloseTFile(Theight);
-	SIStype = SIS_TEXT_MAP;
-	OpenTFile(TFileName, &Twidth, &Theight);
+	sis->CloseTFile(sis->Theight);
+	sis->SIStype = SIS_TEXT_MAP;
+	sis->OpenTFile(sis->TFileName, &sis->Twidth, &sis->Theight);
 #if 0
 	update_texture_image();
 #endif
@@ -337,18 +341,18 @@ update_texture(void)
 void
 update_depth_map_and_sis(void)
 {
-	CloseDFile();
-	CloseSISFile();
-	CloseTFile(Theight);
+	sis->CloseDFile();
+	sis->CloseSISFile();
+	sis->CloseTFile(sis->Theight);
 	FreeBuffers();
 	/// The next three functions are usually called from FreeBuffers()
 	// free(DBuffer);
 	// free(IdentBuffer);
 	// free(SISBuffer);
 
-	free(SISred);
-	free(SISgreen);
-	free(SISblue);
+	free(sis->SISred);
+	free(sis->SISgreen);
+	free(sis->SISblue);
 
 	/// FIXME deleting images causes segfault with the software backend but not with GL backend
 	// nvgDeleteImage(mctx.vg, mctx.depth_map_img);
@@ -358,9 +362,9 @@ update_depth_map_and_sis(void)
 	init_all(0, NULL);
 #if 0
 	/// The next four functions are usually called in init_sis()
-	OpenDFile(DFileName, &Dwidth, &Dheight);
-	if (SIStype == SIS_TEXT_MAP) {
-		OpenTFile(TFileName, &Twidth, &Theight);
+	sis->OpenDFile(sis->DFileName, &sis->Dwidth, &sis->Dheight);
+	if (sis->SIStype == SIS_TEXT_MAP) {
+		sis->OpenTFile(sis->TFileName, &sis->Twidth, &sis->Theight);
 	}
 	InitAlgorithm();
 	AllocBuffers();
@@ -383,7 +387,7 @@ update_depth_map_and_sis(void)
 	// }
 #endif
 
-	CreateSISBuffer(SISwidth, SISheight, SIStype);
+	sis->CreateSISBuffer(sis->SISwidth, sis->SISheight, sis->SIStype);
 
 	render_sis();
 	// WriteSISFile();
@@ -683,7 +687,7 @@ render_ui(NVGcontext *vg, int item, int corners)
 		case ST_NUMFIELD: {
 				const numfield_head *data = (numfield_head *) head;
 				static char value_str[32];
-				sprintf(value_str, "%d", algorithm);
+				sprintf(value_str, "%d", sis->algorithm);
 				bndNumberField(vg, rect.x, rect.y, rect.w, rect.h,
 				              corners, (BNDwidgetState) uiGetState(item),
 				              data->label, value_str);
@@ -747,39 +751,39 @@ ui_frame(NVGcontext *vg, float w, float h)
 	pch += BND_WIDGET_HEIGHT + 5 + 5;
 
 	int eye_dist_slider = slider_int("eye distance",
-	  &eye_dist, slider_int_handler, 10, 0.5 * Dwidth, false);
+	  &sis->eye_dist, slider_int_handler, 10, 0.5 * sis->Dwidth, false);
 	uiSetMargins(eye_dist_slider, M, 5, M, 3);
 	uiInsert(ctl_panel, eye_dist_slider);
 	pch += BND_WIDGET_HEIGHT + 5 + 3;
 
-	int near_plane_slider = slider("scene depth", &u, slider_handler, 0.01f, 1.0f, true);
+	int near_plane_slider = slider("scene depth", &sis->u, slider_handler, 0.01f, 1.0f, true);
 	uiSetMargins(near_plane_slider, M, 3, M, 3);
 	uiInsert(ctl_panel, near_plane_slider);
 	pch += BND_WIDGET_HEIGHT + 3 + 3;
 
-	int far_plane_slider = slider("back distance", &t, slider_handler, 0.25f, 2.0f, true);
+	int far_plane_slider = slider("back distance", &sis->t, slider_handler, 0.25f, 2.0f, true);
 	uiSetMargins(far_plane_slider, M, 3, M, 3);
 	uiInsert(ctl_panel, far_plane_slider);
 	pch += BND_WIDGET_HEIGHT + 3 + 3;
 
 	int origin_slider = slider_int("algo origin",
-	  &origin, slider_int_handler, 0, Dwidth, false);
+	  &sis->origin, slider_int_handler, 0, sis->Dwidth, false);
 	uiSetMargins(origin_slider, M, 3, M, 3);
 	uiInsert(ctl_panel, origin_slider);
 	pch += BND_WIDGET_HEIGHT + 3 + 3;
 
 	int algo_numfield;
-	algo_numfield = number_field("algorithm", &algorithm, 1, 4);
+	algo_numfield = number_field("algorithm", &sis->algorithm, 1, 4);
 	uiSetMargins(algo_numfield, M, 5, M, 5);
 	uiInsert(ctl_panel, algo_numfield);
 	pch += BND_WIDGET_HEIGHT + 3 + 3;
 
-	int opt_show_marker = check("show markers", &mark);
+	int opt_show_marker = check("show markers", &sis->mark);
 	uiSetMargins(opt_show_marker, 2 * M, 5, 2 * M, 5);
 	uiInsert(ctl_panel, opt_show_marker);
 	pch += BND_WIDGET_HEIGHT + 2 * M + 5;
 
-	int opt_invert_depth_map = check("invert depth", &invert);
+	int opt_invert_depth_map = check("invert depth", &sis->invert);
 	uiSetMargins(opt_invert_depth_map, 2 * M, 5, 2 * M, 5);
 	uiInsert(ctl_panel, opt_invert_depth_map);
 	pch += BND_WIDGET_HEIGHT + 2 * M + 5;
@@ -833,13 +837,13 @@ ui_frame(NVGcontext *vg, float w, float h)
 	UIvec2 c = uiGetCursor();
 	if (dropped_file_len && uiContains(depth_map_view, c.x, c.y) && (uiGetButton(0) == 0)) {
 		// printf("dropped file '%s' on depth map view\n", dropped_file);
-		strncpy(DFileName, dropped_file, PATH_MAX);
+		strncpy(sis->DFileName, dropped_file, PATH_MAX);
 		update_depth_map_and_sis();
 		dropped_file_len = 0;
 	}
 	if (dropped_file_len && uiContains(texture_view, c.x, c.y) && (uiGetButton(0) == 0)) {
 		// printf("dropped file '%s' on texture view\n", dropped_file);
-		strncpy(TFileName, dropped_file, PATH_MAX);
+		strncpy(sis->TFileName, dropped_file, PATH_MAX);
 		update_texture();
 		update_sis();
 		dropped_file_len = 0;
@@ -924,7 +928,7 @@ rgb_to_rgba(unsigned char *img, int pixels)
 bool
 load_depth_image(void)
 {
-	mctx.depth_map_img = nvgCreateImage(mctx.vg, DFileName, 0);
+	mctx.depth_map_img = nvgCreateImage(mctx.vg, sis->DFileName, 0);
 
 	return true;
 }
@@ -935,7 +939,7 @@ bool
 update_depth_image(void)
 {
 	int imageFlags = 0;
-	unsigned char *img = rgb_to_rgba(GetDFileBuffer(), Dwidth * Dheight);
+	unsigned char *img = rgb_to_rgba(sis->GetDFileBuffer(), sis->Dwidth * sis->Dheight);
 	nvgUpdateImage(mctx.vg, mctx.depth_map_img, img);
 	free(img);
 	return true;
@@ -946,7 +950,7 @@ update_depth_image(void)
 bool
 load_texture_image(void)
 {
-	mctx.texture_img = nvgCreateImage(mctx.vg, TFileName, 0);
+	mctx.texture_img = nvgCreateImage(mctx.vg, sis->TFileName, 0);
 	// mctx.texture_img = nvgCreateImageRGBA(mctx.vg, Twidth, Theight, imageFlags, GetTFileBuffer());
 	return true;
 }
@@ -957,7 +961,7 @@ bool
 update_texture_image(void)
 {
 	int imageFlags = 0;
-	unsigned char *img = rgb_to_rgba(GetTFileBuffer(), Twidth * Theight);
+	unsigned char *img = rgb_to_rgba(sis->GetTFileBuffer(), sis->Twidth * sis->Theight);
 	nvgUpdateImage(mctx.vg, mctx.texture_img, img);
 	free(img);
 	return true;
@@ -970,8 +974,8 @@ load_sis_image(void)
 {
 	update_sis_view = false;
 	int imageFlags = 0;
-	unsigned char *img = rgb_to_rgba(GetSISFileBuffer(), SISwidth * SISheight);
-	mctx.sis_img = nvgCreateImageRGBA(mctx.vg, SISwidth, SISheight, imageFlags, img);
+	unsigned char *img = rgb_to_rgba(sis->GetSISFileBuffer(), sis->SISwidth * sis->SISheight);
+	mctx.sis_img = nvgCreateImageRGBA(mctx.vg, sis->SISwidth, sis->SISheight, imageFlags, img);
 	free(img);
 	return true;
 }
@@ -981,7 +985,7 @@ bool
 update_sis_image(void)
 {
 	int imageFlags = 0;
-	unsigned char *img = rgb_to_rgba(GetSISFileBuffer(), SISwidth * SISheight);
+	unsigned char *img = rgb_to_rgba(sis->GetSISFileBuffer(), sis->SISwidth * sis->SISheight);
 	nvgUpdateImage(mctx.vg, mctx.sis_img, img);
 	free(img);
 	return true;
@@ -0,0 +1,529 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "sis.h"
+#include "map.h"
+
+#if !defined(_WIN32) && !defined(__plan9__)
+#define SIS_HAVE_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+
+Memory mapped binary pgm/ppm (P5/P6) and raw image files.
+
+The pixel data of these files is used where it is in the file, there is
+nothing to decode. Rows of 8-bit grey depth maps are passed to the depth
+ingest kernel without a copy, other depth maps are converted one row at a
+time. The output file is mapped, too, and the rows are written into it.
+Without mmap (Windows, Plan 9) the files are read into and written from
+memory instead. Black and white SIS are written as pbm (P4) files with
+8 dots per byte.
+
+Decoded png or jpeg images can be cached as pgm/ppm files next to them, a
+later render maps the cache file instead of decoding the image again.
+
+*/
+
+/// Mapped depth map
+static const unsigned char *dmap, *dpix;
+static size_t dmap_size;
+static ind_t dwidth;
+static int dchannels, dbytes;
+/// 16-bit samples of pgm files are big-endian, of raw files little-endian
+static bool dbig_endian;
+static uint8_t *grey8;
+static uint16_t *grey16;
+/// Mapped output file
+static unsigned char *omap, *opix;
+static size_t omap_size, orow_bytes;
+static ind_t owidth;
+/// Standard output, which can't be mapped, the rows are written one by one
+static FILE *ofp;
+
+
+const unsigned char *
+MapFile(const char *FileName, size_t *size)
+{
+#ifdef SIS_HAVE_MMAP
+	struct stat st;
+	void *p;
+	int fd = open(FileName, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+	return (const unsigned char *)p;
+#else
+	FILE *fp = fopen(FileName, "rb");
+	unsigned char *p = NULL;
+	long len;
+	if (!fp)
+		return NULL;
+	if (!fseek(fp, 0, SEEK_END) && (len = ftell(fp)) > 0 && !fseek(fp, 0, SEEK_SET)
+	    && (p = (unsigned char *)malloc(len)) && fread(p, 1, len, fp) == (size_t)len) {
+		*size = len;
+	} else {
+		free(p);
+		p = NULL;
+	}
+	fclose(fp);
+	return p;
+#endif
+}
+
+
+void
+UnmapFile(const unsigned char *data, size_t size)
+{
+	if (!data)
+		return;
+#ifdef SIS_HAVE_MMAP
+	munmap((void *)data, size);
+#else
+	(void)size;
+	free((void *)data);
+#endif
+}
+
+
+#ifndef SIS_HAVE_MMAP
+static char new_file_name[PATH_MAX];
+#endif
+
+unsigned char *
+MapNewFile(const char *FileName, size_t size)
+{
+#ifdef SIS_HAVE_MMAP
+	void *p;
+	int fd = open(FileName, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, size)) {
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return p == MAP_FAILED ? NULL : (unsigned char *)p;
+#else
+	strncpy(new_file_name, FileName, PATH_MAX - 1);
+	return (unsigned char *)calloc(size, 1);
+#endif
+}
+
+
+bool
+UnmapNewFile(unsigned char *data, size_t size)
+{
+#ifdef SIS_HAVE_MMAP
+	return !munmap(data, size);
+#else
+	FILE *fp = fopen(new_file_name, "wb");
+	bool ok = fp && fwrite(data, 1, size, fp) == size;
+	if (fp && fclose(fp))
+		ok = false;
+	free(data);
+	return ok;
+#endif
+}
+
+
+/// Parse the header of a binary pgm or ppm file, returns the offset of the
+/// pixel data or 0 if it's not a pgm or ppm file. With check_size, size
+/// needs to include all the pixel data.
+static size_t
+parse_pnm(const unsigned char *p, size_t size, bool check_size, ind_t *width, ind_t *height,
+          int *channels, int *bytes)
+{
+	ind_t v[3];
+	size_t i = 2;
+	if (size < 3 || p[0] != 'P' || (p[1] != '5' && p[1] != '6'))
+		return 0;
+	for (int k = 0; k < 3; k++) {
+		while (i < size && (isspace(p[i]) || p[i] == '#')) {
+			if (p[i] == '#') {
+				while (i < size && p[i] != '\n')
+					i++;
+			}
+			i++;
+		}
+		if (i >= size || !isdigit(p[i]))
+			return 0;
+		for (v[k] = 0; i < size && isdigit(p[i]); i++)
+			v[k] = v[k] * 10 + (p[i] - '0');
+		/// A single white space character ends the number
+		if (i >= size || !isspace(p[i]))
+			return 0;
+		i++;
+	}
+	if (v[0] <= 0 || v[1] <= 0 || v[2] <= 0 || v[2] > 65535)
+		return 0;
+	*width = v[0];
+	*height = v[1];
+	*channels = p[1] == '5' ? 1 : 3;
+	*bytes = v[2] > 255 ? 2 : 1;
+	if (check_size && (size - i) / *bytes / *channels / *width < (size_t)*height)
+		return 0;
+	return i;
+}
+
+
+static bool
+has_extension(const char *FileName, const char *ext)
+{
+	size_t len = strlen(FileName), elen = strlen(ext);
+	if (len < elen)
+		return false;
+	for (size_t i = 0; i < elen; i++) {
+		if (tolower((unsigned char)FileName[len - elen + i]) != ext[i])
+			return false;
+	}
+	return true;
+}
+
+
+/// Map an image file, returns the pixel data or NULL if it's neither a pgm/ppm
+/// nor a raw file of raw_width x raw_height pixels
+static const unsigned char *
+map_image(const char *FileName, const unsigned char **map, size_t *map_size,
+          ind_t *width, ind_t *height, int *channels, int *bytes, bool *big_endian)
+{
+	size_t offset;
+	if (!(*map = MapFile(FileName, map_size)))
+		return NULL;
+	if ((offset = parse_pnm(*map, *map_size, true, width, height, channels, bytes))) {
+		*big_endian = true;
+		return *map + offset;
+	}
+	if (has_extension(FileName, ".raw") && sis->raw_width > 0 && sis->raw_height > 0) {
+		size_t pixels = sis->raw_width * sis->raw_height;
+		*width = sis->raw_width;
+		*height = sis->raw_height;
+		*big_endian = false;
+		/// The kind of raw data is told by the file size
+		if (*map_size == pixels) {
+			*channels = 1;
+			*bytes = 1;
+			return *map;
+		} else if (*map_size == 2 * pixels) {
+			*channels = 1;
+			*bytes = 2;
+			return *map;
+		} else if (*map_size == 3 * pixels) {
+			*channels = 3;
+			*bytes = 1;
+			return *map;
+		}
+		fprintf(stderr, "Size of raw file %s doesn't match %ldx%ld pixels\n",
+		        FileName, sis->raw_width, sis->raw_height);
+		SISExit(1);
+	}
+	UnmapFile(*map, *map_size);
+	*map = NULL;
+	return NULL;
+}
+
+
+bool
+Map_ProbeFile(const char *FileName)
+{
+	unsigned char head[512];
+	ind_t w, h;
+	int ch, b;
+	size_t n;
+	if (has_extension(FileName, ".raw") && sis->raw_width > 0 && sis->raw_height > 0)
+		return true;
+	FILE *fp = fopen(FileName, "rb");
+	if (!fp)
+		return false;
+	n = fread(head, 1, sizeof(head), fp);
+	fclose(fp);
+	/// Only the header is parsed here
+	return parse_pnm(head, n, false, &w, &h, &ch, &b) != 0;
+}
+
+
+void
+Map_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	if (!(dpix = map_image(DFileName, &dmap, &dmap_size, width, height,
+	                       &dchannels, &dbytes, &dbig_endian))) {
+		fprintf(stderr, "Failed to map %s\n", DFileName);
+		SISExit(1);
+	}
+	dwidth = *width;
+	if (dbytes == 2)
+		grey16 = (uint16_t *)malloc(dwidth * sizeof(uint16_t));
+	else if (dchannels == 3)
+		grey8 = (uint8_t *)malloc(dwidth);
+	if ((dbytes == 2 && !grey16) || (dchannels == 3 && dbytes == 1 && !grey8)) {
+		fprintf(stderr, "Failed to allocate depth map row buffers.\n");
+		SISExit(1);
+	}
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+void
+Map_ReadDBuffer(ind_t r)
+{
+	col_t lo, hi;
+	const unsigned char *row = dpix + (size_t)r * dwidth * dchannels * dbytes;
+	if (dbytes == 2) {
+		int hi_byte = dbig_endian ? 0 : 1;
+		for (ind_t c = 0; c < dwidth; c++) {
+			const unsigned char *p = row + 2 * dchannels * c;
+			if (dchannels == 3)
+				grey16[c] = ((p[hi_byte] << 8 | p[1 - hi_byte]) * 77
+				          + (p[2 + hi_byte] << 8 | p[3 - hi_byte]) * 150
+				          + (p[4 + hi_byte] << 8 | p[5 - hi_byte]) * 29) >> 8;
+			else
+				grey16[c] = p[hi_byte] << 8 | p[1 - hi_byte];
+		}
+		sis->IngestDepthRow16(DBuffer, grey16, dwidth, &lo, &hi);
+		DaddRange(lo, hi, 0);
+		return;
+	}
+	if (dchannels == 3) {
+		/// Same weights as stb_image uses for converting RGB to grey
+		for (ind_t c = 0; c < dwidth; c++)
+			grey8[c] = (row[3 * c] * 77 + row[3 * c + 1] * 150 + row[3 * c + 2] * 29) >> 8;
+		row = grey8;
+	}
+	/// 8-bit grey rows are ingested in place
+	sis->IngestDepthRow(DBuffer, row, dwidth, &lo, &hi);
+	DaddRange(lo, hi, 8);
+}
+
+
+void
+Map_CloseDFile(void)
+{
+	UnmapFile(dmap, dmap_size);
+	dmap = dpix = NULL;
+	free(grey8);
+	free(grey16);
+	grey8 = NULL;
+	grey16 = NULL;
+}
+
+
+unsigned char *
+Map_GetDFileBuffer(void)
+{
+	return (dchannels == 1 && dbytes == 1) ? (unsigned char *)dpix : NULL;
+}
+
+
+const unsigned char *
+Map_OpenTexture(const char *TFileName, ind_t *width, ind_t *height)
+{
+	int ch, b;
+	bool big_endian;
+	const unsigned char *pix = map_image(TFileName, &sis->tmap, &sis->tmap_size, width, height,
+	                                     &ch, &b, &big_endian);
+	if (pix && (ch != 3 || b != 1)) {
+		/// Only 8-bit RGB textures are used in place
+		UnmapFile(sis->tmap, sis->tmap_size);
+		sis->tmap = NULL;
+		return NULL;
+	}
+	return pix;
+}
+
+
+void
+Map_CloseTexture(void)
+{
+	UnmapFile(sis->tmap, sis->tmap_size);
+	sis->tmap = NULL;
+}
+
+
+void
+Map_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	char header[64] = "";
+	if (sis->ImgFileFormat == SIS_IMGFMT_PBM)
+		snprintf(header, sizeof(header), "P4\n%ld %ld\n", width, height);
+	else if (sis->ImgFileFormat != SIS_IMGFMT_RAW)
+		snprintf(header, sizeof(header), "P6\n%ld %ld\n255\n", width, height);
+	owidth = width;
+	orow_bytes = sis->ImgFileFormat == SIS_IMGFMT_PBM ? (width + 7) / 8 : (size_t)width * 3;
+	if (IsStdStream(sis->SISFileName)) {
+		/// Rows are rendered from top to bottom, there is no need to map them
+		ofp = OpenOutputFile(sis->SISFileName);
+		if (!(opix = (unsigned char *)malloc(orow_bytes))) {
+			fprintf(stderr, "Failed to allocate output row buffer.\n");
+			SISExit(1);
+		}
+		if (fwrite(header, 1, strlen(header), ofp) != strlen(header)) {
+			fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+			SISExit(1);
+		}
+		return;
+	}
+	omap_size = strlen(header) + orow_bytes * height;
+	if (!(omap = MapNewFile(sis->SISFileName, omap_size))) {
+		fprintf(stderr, "Failed to map %s for writing.\n", sis->SISFileName);
+		SISExit(1);
+	}
+	memcpy(omap, header, strlen(header));
+	opix = omap + strlen(header);
+}
+
+
+void
+Map_WriteSISColorBuffer(ind_t r)
+{
+	unsigned char *row = ofp ? opix : opix + r * orow_bytes;
+	if (sis->ImgFileFormat == SIS_IMGFMT_PBM) {
+		GatherBitRow(row, r, 1);
+	} else {
+		for (ind_t c = 0; c < owidth; c++) {
+			row[3 * c + 0] = SIScolorRGB[c].r;
+			row[3 * c + 1] = SIScolorRGB[c].g;
+			row[3 * c + 2] = SIScolorRGB[c].b;
+		}
+	}
+	if (ofp && fwrite(row, 1, orow_bytes, ofp) != orow_bytes) {
+		fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+		SISExit(1);
+	}
+}
+
+
+/// The rows are already in the file, it only needs to be unmapped (or flushed)
+void
+Map_WriteSISFile(void)
+{
+	if (ofp) {
+		bool ok = !CloseOutputFile(ofp);
+		ofp = NULL;
+		free(opix);
+		opix = NULL;
+		if (!ok) {
+			fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+			SISExit(1);
+		}
+		return;
+	}
+	if (omap && !UnmapNewFile(omap, omap_size)) {
+		fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+		SISExit(1);
+	}
+	omap = opix = NULL;
+}
+
+
+void
+Map_CloseSISFile(void)
+{
+	Map_WriteSISFile();
+}
+
+
+unsigned char *
+Map_GetSISFileBuffer(void)
+{
+	return opix;
+}
+
+
+void
+CacheFileName(const char *FileName, const char *ext, char *CacheName)
+{
+	snprintf(CacheName, PATH_MAX, "%s.sis.%s", FileName, ext);
+}
+
+
+bool
+CacheIsFresh(const char *FileName, const char *CacheName)
+{
+	struct stat src, cache;
+	return !stat(FileName, &src) && !stat(CacheName, &cache)
+	    && cache.st_mtime >= src.st_mtime;
+}
+
+
+/// Write pixels with step bytes per pixel as pgm (channels 1) or ppm
+/// (channels 3) cache file. The file is written under a temporary name and
+/// renamed, so other renders never see half written cache files.
+bool
+WriteCacheFile(const char *CacheName, const void *pixels, ind_t width, ind_t height,
+               int channels, int bytes, int step)
+{
+	char tmp_name[PATH_MAX + 8];
+	const unsigned char *p = (const unsigned char *)pixels;
+	unsigned char *row;
+	FILE *fp;
+	bool ok;
+	snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", CacheName);
+	if (!(fp = fopen(tmp_name, "wb")))
+		return false;
+	if (!(row = (unsigned char *)malloc((size_t)width * channels * bytes))) {
+		fclose(fp);
+		return false;
+	}
+	ok = fprintf(fp, "P%c\n%ld %ld\n%d\n", channels == 1 ? '5' : '6', width, height,
+	             bytes == 2 ? 65535 : 255) > 0;
+	for (ind_t r = 0; ok && r < height; r++) {
+		for (ind_t c = 0; c < width; c++) {
+			for (int k = 0; k < channels; k++) {
+				if (bytes == 2) {
+					uint16_t v = ((const uint16_t *)p)[(size_t)(r * width + c) * step / 2 + k];
+					row[2 * (c * channels + k)] = v >> 8;
+					row[2 * (c * channels + k) + 1] = v & 0xff;
+				} else {
+					row[c * channels + k] = p[(size_t)(r * width + c) * step + k];
+				}
+			}
+		}
+		ok = fwrite(row, 1, (size_t)width * channels * bytes, fp) == (size_t)width * channels * bytes;
+	}
+	free(row);
+	if (fclose(fp))
+		ok = false;
+	if (ok && rename(tmp_name, CacheName))
+		ok = false;
+	if (!ok)
+		remove(tmp_name);
+	return ok;
+}
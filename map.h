@@ -0,0 +1,49 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sis.h"
+
+const unsigned char *MapFile(const char *FileName, size_t *size);
+void UnmapFile(const unsigned char *data, size_t size);
+unsigned char *MapNewFile(const char *FileName, size_t size);
+bool UnmapNewFile(unsigned char *data, size_t size);
+
+bool Map_ProbeFile(const char *FileName);
+void Map_OpenDFile(char *DFileName, ind_t * width, ind_t * height);
+void Map_ReadDBuffer(ind_t r);
+void Map_CloseDFile(void);
+unsigned char *Map_GetDFileBuffer(void);
+
+const unsigned char *Map_OpenTexture(const char *TFileName, ind_t * width, ind_t * height);
+void Map_CloseTexture(void);
+
+void Map_CreateSISBuffer(ind_t width, ind_t height, int SIStype);
+void Map_WriteSISColorBuffer(ind_t r);
+void Map_WriteSISFile(void);
+void Map_CloseSISFile(void);
+unsigned char *Map_GetSISFileBuffer(void);
+
+/// Cache files of decoded images, e.g. depth.png.sis.pgm
+void CacheFileName(const char *FileName, const char *ext, char *CacheName);
+bool CacheIsFresh(const char *FileName, const char *CacheName);
+bool WriteCacheFile(const char *CacheName, const void *pixels, ind_t width, ind_t height,
+                    int channels, int bytes, int step);
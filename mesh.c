@@ -0,0 +1,532 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "sis.h"
+#include "mesh.h"
+
+/*
+
+Depth maps of 3D meshes (obj and stl files).
+
+The triangles are rasterized into a float z-buffer at the size of the SIS
+(or 1280x720 if neither -x nor -y are given), and the rows of the depth map
+are converted from it while rendering. There is no depth image in between.
+
+The camera looks at the center of the mesh along -z, after the mesh is
+turned by yaw (around y) and then by pitch (around x), see --camera. With a
+field of view the projection is perspective, otherwise orthographic. The
+bounding sphere of the mesh fills the image with a small margin, so the
+framing doesn't change with the angles. The nearest visible point lies on
+the near plane (-n), the farthest one and the background on the far plane
+(-f), and the distances in between are mapped linearly.
+
+The z-buffer is split into bands of rows that are rasterized in parallel,
+each band clips the triangles to its rows. The result doesn't depend on the
+number of threads.
+
+*/
+
+/// Size of the depth map if neither -x nor -y are given
+#define MESH_WIDTH   1280
+#define MESH_HEIGHT  720
+/// Part of the smaller image side that the mesh fills
+#define MESH_FILL    0.9f
+/// Radians per degree
+#define MESH_RADIAN  0.017453292519943295f
+/// Subpixel precision of the rasterizer in bits
+#define MESH_SUBPIXEL  8
+/// Vertices farther off the image are clamped, so edge functions fit into 64 bits
+#define MESH_CLAMP     (float)(1 << 20)
+
+
+typedef struct {
+	float *v;                     /// x, y, z of the vertices
+	uint32_t *tri;                /// Vertex indices of the triangles
+	size_t nv, vcap, nt, tcap;
+} mesh_t;
+
+/// A triangle in image space, with fixed point coordinates so that triangles
+/// sharing an edge agree exactly on the pixels they cover. q is larger for
+/// nearer points and affine in image space: z (orthographic) or 1 / distance
+/// (perspective).
+typedef struct {
+	int64_t x[3], y[3];
+	float q[3];
+	ind_t top, bottom;
+} screen_tri_t;
+
+typedef struct {
+	const screen_tri_t *tris;
+	size_t count;
+	float *qnear, *qfar;          /// Range of visible q of each band
+} raster_t;
+
+static float *zbuf = NULL;
+static ind_t zwidth;
+static uint16_t *zrow = NULL;
+static bool perspective;
+/// Distances of the nearest and farthest visible points
+static float dnear, dfar;
+
+
+static bool
+has_extension(const char *FileName, const char *ext)
+{
+	size_t len = strlen(FileName), elen = strlen(ext);
+	if (len < elen)
+		return false;
+	for (size_t i = 0; i < elen; i++) {
+		if (tolower((unsigned char)FileName[len - elen + i]) != ext[i])
+			return false;
+	}
+	return true;
+}
+
+
+bool
+Mesh_ProbeFile(const char *FileName)
+{
+	return has_extension(FileName, ".obj") || has_extension(FileName, ".stl");
+}
+
+
+static void
+add_vertex(mesh_t *m, float x, float y, float z)
+{
+	if (m->nv == m->vcap) {
+		m->vcap = m->vcap ? 2 * m->vcap : 1024;
+		m->v = realloc(m->v, m->vcap * 3 * sizeof(float));
+		if (!m->v) {
+			fprintf(stderr, "failed to allocate the mesh vertices\n");
+			SISExit(EXIT_FAILURE);
+		}
+	}
+	m->v[3 * m->nv] = x;
+	m->v[3 * m->nv + 1] = y;
+	m->v[3 * m->nv + 2] = z;
+	m->nv++;
+}
+
+
+static void
+add_triangle(mesh_t *m, size_t a, size_t b, size_t c)
+{
+	if (m->nt == m->tcap) {
+		m->tcap = m->tcap ? 2 * m->tcap : 1024;
+		m->tri = realloc(m->tri, m->tcap * 3 * sizeof(uint32_t));
+		if (!m->tri) {
+			fprintf(stderr, "failed to allocate the mesh triangles\n");
+			SISExit(EXIT_FAILURE);
+		}
+	}
+	m->tri[3 * m->nt] = (uint32_t)a;
+	m->tri[3 * m->nt + 1] = (uint32_t)b;
+	m->tri[3 * m->nt + 2] = (uint32_t)c;
+	m->nt++;
+}
+
+
+/// Vertices (v) and faces (f) of obj files, polygons are split into fans
+static void
+read_obj(FILE *fp, mesh_t *m, const char *FileName)
+{
+	char line[4096];
+	while (fgets(line, sizeof(line), fp)) {
+		char *p = line + 1, *end;
+		if (line[0] == 'v' && isspace((unsigned char)line[1])) {
+			float x = strtof(p, &end);
+			float y = strtof(end, &end);
+			float z = strtof(end, &end);
+			add_vertex(m, x, y, z);
+		} else if (line[0] == 'f' && isspace((unsigned char)line[1])) {
+			size_t first = 0, prev = 0;
+			for (int n = 0; ; n++) {
+				/// v, v/vt, v/vt/vn or v//vn, negative indices count back
+				long i = strtol(p, &end, 10);
+				if (end == p)
+					break;
+				if (i < 0)
+					i += (long)m->nv + 1;
+				if (i < 1 || i > (long)m->nv) {
+					fprintf(stderr, "%s: vertex index out of range\n", FileName);
+					SISExit(EXIT_FAILURE);
+				}
+				if (n == 0)
+					first = i - 1;
+				else if (n >= 2)
+					add_triangle(m, first, prev, i - 1);
+				prev = i - 1;
+				for (p = end; *p && !isspace((unsigned char)*p); p++) ;
+			}
+		}
+	}
+}
+
+
+/// Facets of binary stl files, 50 bytes each after a header of 84 bytes
+static void
+read_binary_stl(FILE *fp, mesh_t *m, uint32_t count)
+{
+	unsigned char facet[50];
+	for (uint32_t i = 0; i < count && fread(facet, sizeof(facet), 1, fp) == 1; i++) {
+		/// Little endian floats, the normal comes first
+		for (int k = 0; k < 3; k++) {
+			float xyz[3];
+			for (int j = 0; j < 3; j++) {
+				const unsigned char *b = facet + 12 + 12 * k + 4 * j;
+				uint32_t u = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+				memcpy(&xyz[j], &u, sizeof(float));
+			}
+			add_vertex(m, xyz[0], xyz[1], xyz[2]);
+		}
+		add_triangle(m, m->nv - 3, m->nv - 2, m->nv - 1);
+	}
+}
+
+
+/// Vertex lines of ascii stl files, three of them make a facet
+static void
+read_ascii_stl(FILE *fp, mesh_t *m)
+{
+	char line[1024];
+	int k = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		char *p = line, *end;
+		while (isspace((unsigned char)*p))
+			p++;
+		if (strncmp(p, "vertex", 6))
+			continue;
+		float x = strtof(p + 6, &end);
+		float y = strtof(end, &end);
+		float z = strtof(end, &end);
+		add_vertex(m, x, y, z);
+		if (++k == 3) {
+			add_triangle(m, m->nv - 3, m->nv - 2, m->nv - 1);
+			k = 0;
+		}
+	}
+}
+
+
+static void
+read_mesh(const char *FileName, mesh_t *m)
+{
+	FILE *fp = fopen(FileName, "rb");
+	if (!fp) {
+		fprintf(stderr, "failed to open the mesh %s\n", FileName);
+		SISExit(EXIT_FAILURE);
+	}
+	if (has_extension(FileName, ".obj")) {
+		read_obj(fp, m, FileName);
+	} else {
+		/// Binary stl files may start with "solid" too, their size tells them apart
+		unsigned char header[84];
+		long size = -1;
+		if (!fseek(fp, 0, SEEK_END))
+			size = ftell(fp);
+		rewind(fp);
+		uint32_t count = 0;
+		if (fread(header, sizeof(header), 1, fp) == 1)
+			count = header[80] | header[81] << 8 | header[82] << 16 | (uint32_t)header[83] << 24;
+		if (size >= 84 && (size - 84) % 50 == 0 && (uint64_t)count * 50 == (uint64_t)size - 84) {
+			read_binary_stl(fp, m, count);
+		} else {
+			rewind(fp);
+			read_ascii_stl(fp, m);
+		}
+	}
+	fclose(fp);
+	if (m->nt == 0) {
+		fprintf(stderr, "%s: the mesh has no triangles\n", FileName);
+		SISExit(EXIT_FAILURE);
+	}
+}
+
+
+/// First pixel whose center lies at or after the fixed point coordinate p,
+/// clamped to [lo, hi]
+static inline ind_t
+pixel_after(int64_t p, ind_t lo, ind_t hi)
+{
+	int64_t half = 1 << (MESH_SUBPIXEL - 1);
+	int64_t n = p - half;
+	/// Rounds up for negative n too
+	n = n >= 0 ? (n + (1 << MESH_SUBPIXEL) - 1) >> MESH_SUBPIXEL : -((-n) >> MESH_SUBPIXEL);
+	return n < lo ? lo : n > hi ? hi : (ind_t)n;
+}
+
+
+/// Turn the mesh in front of the camera and project it to the image
+static screen_tri_t *
+project_mesh(const mesh_t *m, ind_t width, ind_t height)
+{
+	float lo[3] = { INFINITY, INFINITY, INFINITY };
+	float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (size_t i = 0; i < m->nv; i++) {
+		for (int j = 0; j < 3; j++) {
+			lo[j] = fminf(lo[j], m->v[3 * i + j]);
+			hi[j] = fmaxf(hi[j], m->v[3 * i + j]);
+		}
+	}
+	float center[3], radius = 0.0f;
+	for (int j = 0; j < 3; j++)
+		center[j] = (lo[j] + hi[j]) / 2.0f;
+	for (size_t i = 0; i < m->nv; i++) {
+		float dx = m->v[3 * i] - center[0];
+		float dy = m->v[3 * i + 1] - center[1];
+		float dz = m->v[3 * i + 2] - center[2];
+		radius = fmaxf(radius, dx * dx + dy * dy + dz * dz);
+	}
+	radius = radius > 0.0f ? sqrtf(radius) : 1.0f;
+
+	float yaw = sis->camera_yaw * MESH_RADIAN;
+	float pitch = sis->camera_pitch * MESH_RADIAN;
+	float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+	float half = (width < height ? width : height) / 2.0f * MESH_FILL;
+	float scale, distance = 0.0f;
+	perspective = sis->camera_fov > 0.0f;
+	if (perspective) {
+		/// The bounding sphere just fits into the field of view
+		float angle = sis->camera_fov / 2.0f * MESH_RADIAN;
+		distance = radius / sinf(angle);
+		scale = half / tanf(angle);
+	} else {
+		scale = half / radius;
+	}
+
+	float *v = malloc(m->nv * 3 * sizeof(float));
+	screen_tri_t *tris = malloc(m->nt * sizeof(screen_tri_t));
+	if (!v || !tris) {
+		fprintf(stderr, "failed to allocate the projected mesh\n");
+		SISExit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < m->nv; i++) {
+		float x = m->v[3 * i] - center[0];
+		float y = m->v[3 * i + 1] - center[1];
+		float z = m->v[3 * i + 2] - center[2];
+		float x1 = x * cy + z * sy;
+		float z1 = z * cy - x * sy;
+		float y2 = y * cp - z1 * sp;
+		float z2 = y * sp + z1 * cp;
+		if (perspective) {
+			/// Points on the bounding sphere may touch the camera
+			float d = fmaxf(distance - z2, radius * 1e-6f);
+			v[3 * i] = width / 2.0f + scale * x1 / d;
+			v[3 * i + 1] = height / 2.0f - scale * y2 / d;
+			v[3 * i + 2] = 1.0f / d;
+		} else {
+			v[3 * i] = width / 2.0f + scale * x1;
+			v[3 * i + 1] = height / 2.0f - scale * y2;
+			v[3 * i + 2] = z2;
+		}
+	}
+	for (size_t i = 0; i < m->nt; i++) {
+		screen_tri_t *t = &tris[i];
+		for (int k = 0; k < 3; k++) {
+			const float *p = &v[3 * m->tri[3 * i + k]];
+			t->x[k] = llrintf(fminf(fmaxf(p[0], -MESH_CLAMP), MESH_CLAMP) * (1 << MESH_SUBPIXEL));
+			t->y[k] = llrintf(fminf(fmaxf(p[1], -MESH_CLAMP), MESH_CLAMP) * (1 << MESH_SUBPIXEL));
+			t->q[k] = p[2];
+		}
+		/// Rows whose centers may lie inside
+		int64_t top = t->y[0] < t->y[1] ? t->y[0] : t->y[1];
+		int64_t bottom = t->y[0] > t->y[1] ? t->y[0] : t->y[1];
+		top = top < t->y[2] ? top : t->y[2];
+		bottom = bottom > t->y[2] ? bottom : t->y[2];
+		t->top = pixel_after(top, 0, height);
+		t->bottom = pixel_after(bottom + 1, 0, height);
+	}
+	free(v);
+	return tris;
+}
+
+
+/// Rasterize the triangles into the rows [begin, end) of the z-buffer
+static void
+raster_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const raster_t *r = arg;
+	for (ind_t y = begin; y < end; y++) {
+		float *z = zbuf + (size_t)y * zwidth;
+		for (ind_t x = 0; x < zwidth; x++)
+			z[x] = -INFINITY;
+	}
+	const int64_t one = 1 << MESH_SUBPIXEL, half = one / 2;
+	for (size_t i = 0; i < r->count; i++) {
+		const screen_tri_t *t = &r->tris[i];
+		if (t->bottom <= begin || t->top >= end)
+			continue;
+		/// Edge function k is the weight of vertex k, zero on the opposite
+		/// edge and positive inside for either winding
+		int64_t ea[3], eb[3], ec[3];
+		for (int k = 0; k < 3; k++) {
+			int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+			ea[k] = t->y[k1] - t->y[k2];
+			eb[k] = t->x[k2] - t->x[k1];
+			ec[k] = t->x[k1] * t->y[k2] - t->x[k2] * t->y[k1];
+		}
+		int64_t area = ec[0] + ec[1] + ec[2];
+		if (area == 0)
+			continue;
+		if (area < 0) {
+			for (int k = 0; k < 3; k++) {
+				ea[k] = -ea[k];
+				eb[k] = -eb[k];
+				ec[k] = -ec[k];
+			}
+			area = -area;
+		}
+		float q0 = t->q[0] / (float)area, q1 = t->q[1] / (float)area, q2 = t->q[2] / (float)area;
+		int64_t left = t->x[0] < t->x[1] ? t->x[0] : t->x[1];
+		int64_t right = t->x[0] > t->x[1] ? t->x[0] : t->x[1];
+		left = left < t->x[2] ? left : t->x[2];
+		right = right > t->x[2] ? right : t->x[2];
+		ind_t x0 = pixel_after(left, 0, zwidth);
+		ind_t x1 = pixel_after(right + 1, 0, zwidth);
+		ind_t y0 = t->top > begin ? t->top : begin;
+		ind_t y1 = t->bottom < end ? t->bottom : end;
+		for (ind_t y = y0; y < y1; y++) {
+			float *z = zbuf + (size_t)y * zwidth;
+			int64_t px = x0 * one + half, py = y * one + half;
+			int64_t w0 = ea[0] * px + eb[0] * py + ec[0];
+			int64_t w1 = ea[1] * px + eb[1] * py + ec[1];
+			int64_t w2 = ea[2] * px + eb[2] * py + ec[2];
+			for (ind_t x = x0; x < x1; x++) {
+				/// Pixels on an edge belong to both triangles, that's fine for a z-buffer
+				if ((w0 | w1 | w2) >= 0) {
+					/// A convex combination, it never leaves the range of the vertices
+					float q = (float)w0 * q0 + (float)w1 * q1 + (float)w2 * q2;
+					if (q > z[x])
+						z[x] = q;
+				}
+				w0 += ea[0] * one;
+				w1 += ea[1] * one;
+				w2 += ea[2] * one;
+			}
+		}
+	}
+	float qnear = -INFINITY, qfar = INFINITY;
+	for (ind_t y = begin; y < end; y++) {
+		const float *z = zbuf + (size_t)y * zwidth;
+		for (ind_t x = 0; x < zwidth; x++) {
+			if (z[x] == -INFINITY)
+				continue;
+			qnear = fmaxf(qnear, z[x]);
+			qfar = fminf(qfar, z[x]);
+		}
+	}
+	r->qnear[band] = qnear;
+	r->qfar[band] = qfar;
+}
+
+
+/// Distance from the camera, up to an offset for orthographic projections
+static inline float
+distance_of(float q)
+{
+	return perspective ? 1.0f / q : -q;
+}
+
+
+void
+Mesh_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	mesh_t m = { 0 };
+	read_mesh(DFileName, &m);
+	/// The depth map has the size of the SIS, the mesh is rasterized at any size
+	*width = sis->SISwidth ? sis->SISwidth : sis->SISheight ? sis->SISheight * MESH_WIDTH / MESH_HEIGHT : MESH_WIDTH;
+	*height = sis->SISheight ? sis->SISheight : *width * MESH_HEIGHT / MESH_WIDTH;
+	raster_t r;
+	r.tris = project_mesh(&m, *width, *height);
+	r.count = m.nt;
+	free(m.v);
+	free(m.tri);
+
+	int bands = ParallelBands(*height, 16);
+	zbuf = malloc((size_t)*width * *height * sizeof(float));
+	zrow = malloc(*width * sizeof(uint16_t));
+	r.qnear = malloc(bands * sizeof(float));
+	r.qfar = malloc(bands * sizeof(float));
+	if (!zbuf || !zrow || !r.qnear || !r.qfar) {
+		fprintf(stderr, "failed to allocate the z-buffer\n");
+		SISExit(EXIT_FAILURE);
+	}
+	zwidth = *width;
+	ParallelFor(*height, bands, raster_band, &r);
+	float qnear = -INFINITY, qfar = INFINITY;
+	for (int i = 0; i < bands; i++) {
+		qnear = fmaxf(qnear, r.qnear[i]);
+		qfar = fminf(qfar, r.qfar[i]);
+	}
+	dnear = qnear == -INFINITY ? 0.0f : distance_of(qnear);
+	dfar = qnear == -INFINITY ? 0.0f : distance_of(qfar);
+	free((void *)r.tris);
+	free(r.qnear);
+	free(r.qfar);
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+void
+Mesh_ReadDBuffer(ind_t r)
+{
+	col_t lo, hi;
+	const float *z = zbuf + (size_t)r * sis->Dwidth;
+	float range = dfar - dnear;
+	float scale = range > 0.0f ? SIS_MAX_DEPTH / range : 0.0f;
+	for (ind_t c = 0; c < sis->Dwidth; c++) {
+		if (z[c] == -INFINITY) {
+			zrow[c] = 0;
+		} else {
+			/// A flat mesh (range 0) lies on the near plane
+			float d = fminf(fmaxf((dfar - distance_of(z[c])) * scale, 0.0f), SIS_MAX_DEPTH);
+			zrow[c] = range > 0.0f ? (uint16_t)(d + 0.5f) : SIS_MAX_DEPTH;
+		}
+	}
+	sis->IngestDepthRow16(DBuffer, zrow, sis->Dwidth, &lo, &hi);
+	DaddRange(lo, hi, 0);
+}
+
+
+void
+Mesh_CloseDFile(void)
+{
+	free(zbuf);
+	zbuf = NULL;
+	free(zrow);
+	zrow = NULL;
+}
+
+
+/// The depth map is never kept in memory as a whole
+unsigned char *
+Mesh_GetDFileBuffer(void)
+{
+	return NULL;
+}
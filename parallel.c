@@ -0,0 +1,166 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sis.h"
+
+#ifndef NO_THREADING
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+/*
+
+Data parallel loops over bands of rows.
+
+ParallelFor() splits a range of items (usually rows) into bands and runs a
+function on each band in its own thread. The band boundaries only depend on
+the number of items and bands, so results that are merged in band order are
+the same for any number of threads. Building with -DNO_THREADING runs all
+bands one after the other in the calling thread.
+
+An error in a band (SISExit()) ends that band only. Once all bands have
+ended, the calling thread calls SISExit() itself, so a libsis render gets
+the error back instead of the whole process ending in a worker thread.
+
+The threads of the bands render with the state of the calling thread (sis),
+the renders of libsis contexts in other threads don't see it.
+
+*/
+
+typedef struct {
+	parallel_fn fn;
+	void *arg;
+	int band;
+	ind_t begin, end;
+	/// State of the calling thread, the band renders with it
+	sis_state_t *state;
+	/// The band ended with SISExit()
+	bool failed;
+} band_t;
+
+
+int
+ThreadCount(void)
+{
+	if (sis->num_threads > 0)
+		return sis->num_threads;
+#if defined(NO_THREADING)
+	return 1;
+#elif defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+
+int
+ParallelBands(ind_t n, ind_t min_band)
+{
+	int bands = ThreadCount();
+	if (min_band < 1)
+		min_band = 1;
+	if (n / min_band < bands)
+		bands = n / min_band;
+	return bands > 0 ? bands : 1;
+}
+
+
+#ifndef NO_THREADING
+static void *
+run_band(void *arg)
+{
+	band_t *b = (band_t *)arg;
+	jmp_buf jump, *outer = sis_error_jump;
+	sis_state_t *outer_state = sis;
+	sis = b->state;
+	sis_error_jump = &jump;
+	if (setjmp(jump))
+		b->failed = true;
+	else
+		b->fn(b->arg, b->band, b->begin, b->end);
+	sis_error_jump = outer;
+	sis = outer_state;
+	return NULL;
+}
+#endif
+
+
+void
+ParallelFor(ind_t n, int bands, parallel_fn fn, void *arg)
+{
+	band_t *b;
+	if (bands <= 1) {
+		fn(arg, 0, 0, n);
+		return;
+	}
+	if (!(b = (band_t *)calloc(bands, sizeof(band_t)))) {
+		fprintf(stderr, "Failed to allocate thread bands.\n");
+		SISExit(1);
+	}
+	for (int i = 0; i < bands; i++) {
+		b[i] = (band_t){ fn, arg, i, n * i / bands, n * (i + 1) / bands, sis };
+	}
+#ifndef NO_THREADING
+	pthread_t *threads = (pthread_t *)calloc(bands, sizeof(pthread_t));
+	bool *started = (bool *)calloc(bands, sizeof(bool));
+	if (!threads || !started) {
+		fprintf(stderr, "Failed to allocate threads.\n");
+		SISExit(1);
+	}
+	/// The calling thread works on the first band itself
+	for (int i = 1; i < bands; i++) {
+		started[i] = !pthread_create(&threads[i], NULL, run_band, &b[i]);
+	}
+	run_band(&b[0]);
+	for (int i = 1; i < bands; i++) {
+		/// Bands without a thread are run here
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			run_band(&b[i]);
+	}
+	free(started);
+	free(threads);
+	for (int i = 0; i < bands; i++) {
+		if (b[i].failed) {
+			free(b);
+			SISExit(EXIT_FAILURE);
+		}
+	}
+#else
+	for (int i = 0; i < bands; i++) {
+		fn(arg, i, b[i].begin, b[i].end);
+	}
+#endif
+	free(b);
+}
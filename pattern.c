@@ -0,0 +1,394 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sis.h"
+#include "pattern.h"
+
+/// Fused multiply-adds of some instruction set levels would change the colors
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+
+Procedural textures, selected with --pattern instead of a texture file.
+
+A pattern is a function of the dot position that is evaluated for the
+texture row of each SIS row in InitSISBuffer(), and for single dots in
+get_pixel_from_pattern(). Nothing is decoded or kept in memory, and the
+texture doesn't repeat at the edges of a texture image.
+
+Each pattern is a scalar field that is mapped to a color by a cosine hue
+ramp (or grey ramp). The lattice of the noise patterns is hashed with
+integer arithmetic instead of a permutation table, and sine and floor are
+polynomials, so that the row kernels vectorize without gathers or calls.
+The patterns look the same on all machines and instruction set levels.
+
+*/
+
+#define PATTERN_NOISE     0
+#define PATTERN_PERLIN    1
+#define PATTERN_STRIPES   2
+#define PATTERN_PLASMA    3
+#define PATTERN_GRADIENT  4
+
+/// The texture size, patterns don't repeat within an image
+#define PATTERN_SIZE      (1L << 24)
+/// Values evaluated at a time before they are mapped to colors
+#define PATTERN_CHUNK     256
+#define MAX_OCTAVES       8
+
+static const struct {
+	const char *name;
+	float scale;
+	int octaves;
+} pattern_defaults[] = {
+	[PATTERN_NOISE]    = { "noise", 6.0f, 3 },
+	[PATTERN_PERLIN]   = { "perlin", 24.0f, 4 },
+	[PATTERN_STRIPES]  = { "stripes", 8.0f, 1 },
+	[PATTERN_PLASMA]   = { "plasma", 16.0f, 1 },
+	[PATTERN_GRADIENT] = { "gradient", 32.0f, 1 },
+};
+
+
+/// Parse the value of parameter key in spec, which ends at ':' or the end
+static bool
+parse_parameter(const char *spec)
+{
+	char *end;
+	if (!strncmp(spec, "scale=", 6)) {
+		sis->pattern.scale = strtof(spec + 6, &end);
+		return sis->pattern.scale > 0.0f && (*end == ':' || *end == 0);
+	}
+	if (!strncmp(spec, "octaves=", 8)) {
+		sis->pattern.octaves = (int)strtol(spec + 8, &end, 10);
+		return sis->pattern.octaves >= 1 && sis->pattern.octaves <= MAX_OCTAVES && (*end == ':' || *end == 0);
+	}
+	if (!strncmp(spec, "angle=", 6)) {
+		sis->pattern.angle = strtof(spec + 6, &end);
+		return *end == ':' || *end == 0;
+	}
+	if (!strncmp(spec, "grey", 4) && (spec[4] == ':' || spec[4] == 0)) {
+		sis->pattern.grey = true;
+		return true;
+	}
+	return false;
+}
+
+
+bool
+ParsePattern(const char *spec)
+{
+	size_t len = strcspn(spec, ":");
+	int type;
+	for (type = 0; type <= PATTERN_GRADIENT; type++) {
+		if (strlen(pattern_defaults[type].name) == len
+		    && !strncmp(spec, pattern_defaults[type].name, len))
+			break;
+	}
+	if (type > PATTERN_GRADIENT)
+		return false;
+	sis->pattern.type = type;
+	sis->pattern.scale = pattern_defaults[type].scale;
+	sis->pattern.octaves = pattern_defaults[type].octaves;
+	sis->pattern.angle = 60.0f;
+	sis->pattern.grey = false;
+	for (const char *p = spec + len; *p == ':'; p = p + 1 + strcspn(p + 1, ":")) {
+		if (!parse_parameter(p + 1))
+			return false;
+	}
+	sis->texture_pattern = true;
+	return true;
+}
+
+
+/// floorf() for the range of int32_t, without a call to libm
+SIS_KERNEL_BODY float
+pattern_floor(float x)
+{
+	float t = (float)(int32_t)x;
+	return t > x ? t - 1.0f : t;
+}
+
+
+/// sin(2 pi t) with an error below 0.001
+SIS_KERNEL_BODY float
+turn_sin(float t)
+{
+	t -= pattern_floor(t + 0.5f);
+	float y = 8.0f * t - 16.0f * t * fabsf(t);
+	return 0.225f * (y * fabsf(y) - y) + y;
+}
+
+
+/// Random bits of the lattice point (x, y)
+SIS_KERNEL_BODY uint32_t
+lattice_hash(int32_t x, int32_t y, uint32_t seed)
+{
+	uint32_t h = seed ^ (uint32_t)x * 0x27d4eb2du ^ (uint32_t)y * 0x165667b1u;
+	h ^= h >> 15;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+
+/// Lattice value in [0, 1)
+SIS_KERNEL_BODY float
+lattice_value(int32_t x, int32_t y, uint32_t seed)
+{
+	return (float)(int32_t)(lattice_hash(x, y, seed) >> 8) * (1.0f / 16777216.0f);
+}
+
+
+/// Dot product of the offset (dx, dy) with one of the diagonal gradients
+SIS_KERNEL_BODY float
+lattice_gradient(int32_t x, int32_t y, uint32_t seed, float dx, float dy)
+{
+	uint32_t h = lattice_hash(x, y, seed);
+	return dx * (float)(1 - (int32_t)((h & 1) << 1)) + dy * (float)(1 - (int32_t)(h & 2));
+}
+
+
+/// Add amp times one octave of value noise to v, at lattice positions
+/// x + i * step of the lattice row y
+SIS_KERNEL_BODY void
+value_noise(float *restrict v, int m, float x, float step, float y, float amp, uint32_t seed)
+{
+	float fy = pattern_floor(y);
+	int32_t iy = (int32_t)fy;
+	float ty = y - fy;
+	ty = ty * ty * (3.0f - 2.0f * ty);
+	for (int i = 0; i < m; i++) {
+		float xi = x + (float)i * step;
+		float fx = pattern_floor(xi);
+		int32_t ix = (int32_t)fx;
+		float tx = xi - fx;
+		tx = tx * tx * (3.0f - 2.0f * tx);
+		float a = lattice_value(ix, iy, seed);
+		float b = lattice_value(ix + 1, iy, seed);
+		float c = lattice_value(ix, iy + 1, seed);
+		float d = lattice_value(ix + 1, iy + 1, seed);
+		float top = a + (b - a) * tx;
+		float bottom = c + (d - c) * tx;
+		v[i] += amp * (top + (bottom - top) * ty);
+	}
+}
+
+
+/// Add amp times one octave of gradient (Perlin) noise in [-1, 1] to v
+SIS_KERNEL_BODY void
+gradient_noise(float *restrict v, int m, float x, float step, float y, float amp, uint32_t seed)
+{
+	float fy = pattern_floor(y);
+	int32_t iy = (int32_t)fy;
+	float dy = y - fy;
+	float ty = dy * dy * dy * (dy * (dy * 6.0f - 15.0f) + 10.0f);
+	for (int i = 0; i < m; i++) {
+		float xi = x + (float)i * step;
+		float fx = pattern_floor(xi);
+		int32_t ix = (int32_t)fx;
+		float dx = xi - fx;
+		float tx = dx * dx * dx * (dx * (dx * 6.0f - 15.0f) + 10.0f);
+		float a = lattice_gradient(ix, iy, seed, dx, dy);
+		float b = lattice_gradient(ix + 1, iy, seed, dx - 1.0f, dy);
+		float c = lattice_gradient(ix, iy + 1, seed, dx, dy - 1.0f);
+		float d = lattice_gradient(ix + 1, iy + 1, seed, dx - 1.0f, dy - 1.0f);
+		float top = a + (b - a) * tx;
+		float bottom = c + (d - c) * tx;
+		v[i] += amp * (top + (bottom - top) * ty);
+	}
+}
+
+
+/// Octaves of noise with half the size and half the amplitude each
+SIS_KERNEL_BODY void
+fractal_noise(float *restrict v, int m, float x, float step, float y)
+{
+	float amp = 1.0f, total = 0.0f;
+	for (int i = 0; i < m; i++)
+		v[i] = 0.0f;
+	for (int o = 0; o < sis->pattern.octaves; o++) {
+		uint32_t seed = sis->pattern.seed + (uint32_t)o * 0x9e3779b9u;
+		if (sis->pattern.type == PATTERN_PERLIN)
+			gradient_noise(v, m, x, step, y, amp, seed);
+		else
+			value_noise(v, m, x, step, y, amp, seed);
+		total += amp;
+		amp *= 0.5f;
+		x *= 2.0f;
+		step *= 2.0f;
+		y *= 2.0f;
+	}
+	/// Spread the values, which are mostly close to the mean, over about [-1, 1]
+	float spread = (sis->pattern.type == PATTERN_PERLIN ? 2.5f : 3.0f) / total;
+	float mean = sis->pattern.type == PATTERN_PERLIN ? 0.0f : 0.5f * total;
+	for (int i = 0; i < m; i++)
+		v[i] = (v[i] - mean) * spread;
+}
+
+
+/// Stripes across the direction angle, the value goes once around the hues
+/// per stripe
+SIS_KERNEL_BODY void
+stripes(float *restrict v, int m, float x, float step, float y)
+{
+	float ca = sis->pattern.cos_angle, sa = sis->pattern.sin_angle;
+	for (int i = 0; i < m; i++)
+		v[i] = (x + (float)i * step) * ca + y * sa;
+}
+
+
+/// Sum of sine waves along x, y, the diagonal and rings around the origin
+SIS_KERNEL_BODY void
+plasma(float *restrict v, int m, float x, float step, float y)
+{
+	float wy = turn_sin(y);
+	for (int i = 0; i < m; i++) {
+		float xi = x + (float)i * step;
+		float w = turn_sin(xi) + wy + turn_sin(0.5f * (xi + y))
+		          + turn_sin(0.05f * (xi * xi + y * y));
+		v[i] = 0.25f * w;
+	}
+}
+
+
+/// Tiles with a diagonal gradient through half of the hues
+SIS_KERNEL_BODY void
+gradient(float *restrict v, int m, float x, float step, float y)
+{
+	float ty = y - pattern_floor(y);
+	for (int i = 0; i < m; i++) {
+		float xi = x + (float)i * step;
+		v[i] = 0.5f * (xi - pattern_floor(xi) + ty);
+	}
+}
+
+
+/// Map the values to packed RGB colors, one turn of the hue circle per 1.0,
+/// or from black to white and back to black per 2.0
+SIS_KERNEL_BODY void
+colorize(col_t *restrict dst, const float *restrict v, int m)
+{
+	if (sis->pattern.grey) {
+		for (int i = 0; i < m; i++) {
+			int32_t c = (int32_t)(127.5f + 127.0f * turn_sin(0.5f * v[i]) + 0.5f);
+			dst[i] = (col_t)(c | c << 8 | c << 16);
+		}
+		return;
+	}
+	for (int i = 0; i < m; i++) {
+		int32_t r = (int32_t)(127.5f + 127.0f * turn_sin(v[i] + 0.25f) + 0.5f);
+		int32_t g = (int32_t)(127.5f + 127.0f * turn_sin(v[i] - 0.083333f) + 0.5f);
+		int32_t b = (int32_t)(127.5f + 127.0f * turn_sin(v[i] - 0.416667f) + 0.5f);
+		dst[i] = (col_t)(r | g << 8 | b << 16);
+	}
+}
+
+
+SIS_KERNEL_BODY void
+pattern_row_body(col_t *restrict dst, ind_t x0, ind_t n, ind_t y, int factor)
+{
+	float v[PATTERN_CHUNK];
+	/// Pattern units per evaluated position
+	float step = 1.0f / (sis->pattern.scale * (float)factor);
+	float py = (float)y / sis->pattern.scale;
+	for (ind_t i = 0; i < n; i += PATTERN_CHUNK) {
+		int m = n - i < PATTERN_CHUNK ? (int)(n - i) : PATTERN_CHUNK;
+		float px = (float)(x0 + i) * step;
+		switch (sis->pattern.type) {
+		case PATTERN_NOISE:
+		case PATTERN_PERLIN:
+			fractal_noise(v, m, px, step, py);
+			break;
+		case PATTERN_STRIPES:
+			stripes(v, m, px, step, py);
+			break;
+		case PATTERN_PLASMA:
+			plasma(v, m, px, step, py);
+			break;
+		default:
+			gradient(v, m, px, step, py);
+			break;
+		}
+		colorize(dst + i, v, m);
+	}
+}
+
+SIS_KERNEL_VARIANTS(pattern_row,
+  (col_t *restrict dst, ind_t x0, ind_t n, ind_t y, int factor),
+  (dst, x0, n, y, factor))
+
+
+void
+InitPatternKernel(void)
+{
+	SIS_KERNEL_SELECT(sis->PatternRow, pattern_row, "pattern:");
+}
+
+
+/// asteer() reads the dots of a texture row one by one, they are evaluated
+/// PATTERN_CHUNK dots at a time
+static SIS_THREAD_LOCAL col_t cached_dots[PATTERN_CHUNK];
+static SIS_THREAD_LOCAL ind_t cached_row = -1, cached_col;
+
+
+void
+Pattern_OpenTFile(char *TFileName, ind_t *width, ind_t *height)
+{
+	(void)TFileName;
+	/// The seed of the random dots (-s) also varies the noise
+	sis->pattern.seed = (uint32_t)SISRand();
+	sis->pattern.cos_angle = cosf(sis->pattern.angle * 0.017453293f);
+	sis->pattern.sin_angle = sinf(sis->pattern.angle * 0.017453293f);
+	cached_row = -1;
+	*width = PATTERN_SIZE;
+	*height = PATTERN_SIZE;
+}
+
+
+void
+Pattern_CloseTFile(ind_t height)
+{
+	(void)height;
+}
+
+
+col_t
+Pattern_ReadTPixel(ind_t r, ind_t c)
+{
+	if (r != cached_row || c < cached_col || c >= cached_col + PATTERN_CHUNK) {
+		cached_row = r;
+		cached_col = c - c % PATTERN_CHUNK;
+		sis->PatternRow(cached_dots, cached_col, PATTERN_CHUNK, r, 1);
+	}
+	return cached_dots[c - cached_col];
+}
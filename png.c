@@ -0,0 +1,532 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "png.h"
+
+/*
+
+png writers.
+
+The rows of the image are filtered and collected in bands of about
+BAND_SIZE bytes. Each band is deflated on its own (see deflate.c), so the
+compressed bands can simply be written one after the other as IDAT chunks.
+
+The streaming writer (--stream) filters each row as soon as it's rendered
+and writes a band when it's full. Only the current and the previous row and
+one band are kept in memory, the size of the image doesn't matter.
+
+PngWriteImage() writes an image that is in memory as a whole. Its bands are
+filtered and compressed in parallel, like pigz does it. The bands only
+depend on the image size, so the file is the same for any number of threads.
+
+Animated png files (ApngOpen()) are written frame by frame. Each frame is
+a rectangle that replaces the pixels of its region, its data goes into fdAT
+chunks, which are IDAT chunks with a sequence number.
+
+*/
+
+#define BAND_SIZE     (256 * 1024)
+/// Filter of --png-filter=fixed. The pattern of a stereogram repeats exactly
+/// every few dots, which deflate finds best in the unfiltered rows. It beats
+/// the adaptive filter on most stereograms and costs nothing.
+#define PNG_FIXED_FILTER 0
+
+static FILE *png_fp;
+static const char *png_name;
+/// Pixel format (SIS_PIXFMT_*) and bytes per pixel for the filters, 1 for
+/// palette indices and bits
+static int png_pixfmt;
+static size_t png_bpp;
+/// Filter type or SIS_PNG_ADAPTIVE
+static int png_row_filter;
+/// Streaming writer
+static ind_t png_width;
+/// Bytes of a row without the filter type byte
+static size_t row_bytes;
+static unsigned char *cur_row, *prev_row;
+static unsigned char *band;
+static size_t band_len, band_cap;
+static uint32_t adler;
+static bool zlib_header;
+static deflate_t zs;
+/// Animated png: sequence number of the next fcTL or fdAT chunk, the image
+/// data of the frames after the first one is written as fdAT chunks
+static uint32_t apng_seq;
+static bool apng_fdat;
+static int apng_fps;
+
+
+static void
+write_bytes(const void *data, size_t len)
+{
+	if (len && fwrite(data, 1, len, png_fp) != len) {
+		fprintf(stderr, "Failed to write %s.\n", png_name);
+		SISExit(1);
+	}
+}
+
+
+static void
+put_be32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+
+/// Write a chunk with the data a followed by b
+static void
+write_chunk(const char *type, const unsigned char *a, size_t alen,
+            const unsigned char *b, size_t blen)
+{
+	unsigned char buf[4];
+	put_be32(buf, alen + blen);
+	write_bytes(buf, 4);
+	write_bytes(type, 4);
+	write_bytes(a, alen);
+	write_bytes(b, blen);
+	uint32_t crc = Crc32(0, (const unsigned char *)type, 4);
+	crc = Crc32(crc, a, alen);
+	crc = Crc32(crc, b, blen);
+	put_be32(buf, crc);
+	write_bytes(buf, 4);
+}
+
+
+/// Choose the pixel format and the filter, returns the bytes of a row
+static size_t
+set_format(int pixfmt, ind_t width)
+{
+	png_pixfmt = pixfmt;
+	png_bpp = pixfmt == SIS_PIXFMT_RGB ? 3 : 1;
+	png_row_filter = sis->png_filter;
+	/// The sums of the adaptive filter don't mean anything for palette
+	/// indices and bits, they are compressed best without a filter
+	if (pixfmt != SIS_PIXFMT_RGB && sis->png_filter == SIS_PNG_ADAPTIVE)
+		png_row_filter = 0;
+	return pixfmt == SIS_PIXFMT_BILEVEL ? (width + 7) / 8 : width * png_bpp;
+}
+
+
+/// Open the file and write the signature and the header chunk, and the
+/// palette chunk of indexed images
+static void
+write_header(const char *FileName, ind_t width, ind_t height)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	unsigned char ihdr[13];
+	png_name = FileName;
+	if (!(png_fp = OpenOutputFile(FileName))) {
+		fprintf(stderr, "Failed to open %s for writing.\n", FileName);
+		SISExit(1);
+	}
+	write_bytes(signature, 8);
+	put_be32(ihdr, width);
+	put_be32(ihdr + 4, height);
+	ihdr[8] = png_pixfmt == SIS_PIXFMT_BILEVEL ? 1 : 8;     /// bit depth
+	ihdr[9] = png_pixfmt == SIS_PIXFMT_RGB ? 2              /// color type RGB,
+	        : png_pixfmt == SIS_PIXFMT_INDEXED ? 3 : 0;     /// palette or grey
+	ihdr[10] = 0;       /// deflate
+	ihdr[11] = 0;       /// adaptive filtering
+	ihdr[12] = 0;       /// no interlace
+	write_chunk("IHDR", ihdr, 13, NULL, 0);
+	if (png_pixfmt == SIS_PIXFMT_INDEXED)
+		write_chunk("PLTE", sis->SISPalette, 3 * sis->SISPaletteSize, NULL, 0);
+}
+
+
+/// Write a chunk of image data with the data a (at most the zlib header)
+/// followed by b
+static void
+write_data_chunk(const unsigned char *a, size_t alen, const unsigned char *b, size_t blen)
+{
+	unsigned char prefix[6];
+	if (!apng_fdat) {
+		write_chunk("IDAT", a, alen, b, blen);
+		return;
+	}
+	put_be32(prefix, apng_seq++);
+	memcpy(prefix + 4, a, alen);
+	write_chunk("fdAT", prefix, 4 + alen, b, blen);
+}
+
+
+static const unsigned char *
+zlib_header_bytes(void)
+{
+	static unsigned char header[2];
+	ZlibHeader(sis->png_level, header);
+	return header;
+}
+
+
+/// Write the end of the deflate stream and the adler32 checksum
+static void
+finish_data(deflate_t *d, uint32_t checksum, bool header_written)
+{
+	unsigned char trailer[4];
+	if (!header_written)
+		write_data_chunk(zlib_header_bytes(), 2, NULL, 0);
+	DeflateFinish(d);
+	put_be32(trailer, checksum);
+	write_data_chunk(d->data, d->len, trailer, 4);
+	d->len = 0;
+}
+
+
+/// Write the end chunk and close the file
+static void
+write_end(void)
+{
+	write_chunk("IEND", NULL, 0, NULL, 0);
+	if (CloseOutputFile(png_fp)) {
+		fprintf(stderr, "Failed to write %s.\n", png_name);
+		SISExit(1);
+	}
+	png_fp = NULL;
+}
+
+
+/// Write the end of the image data and the end chunk, and close the file
+static void
+write_trailer(deflate_t *d, uint32_t checksum, bool header_written)
+{
+	finish_data(d, checksum, header_written);
+	write_end();
+}
+
+
+static inline int
+paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+
+/// Filter the row x with filter type, b is the previous row (zeros for the first row)
+static void
+apply_filter(int type, unsigned char *f, const unsigned char *x, const unsigned char *b, size_t n)
+{
+	const size_t bpp = png_bpp;
+	size_t i;
+	switch (type) {
+	case 0:
+		memcpy(f, x, n);
+		break;
+	case 1:
+		for (i = 0; i < bpp && i < n; i++)
+			f[i] = x[i];
+		for (; i < n; i++)
+			f[i] = x[i] - x[i - bpp];
+		break;
+	case 2:
+		for (i = 0; i < n; i++)
+			f[i] = x[i] - b[i];
+		break;
+	case 3:
+		for (i = 0; i < bpp && i < n; i++)
+			f[i] = x[i] - (b[i] >> 1);
+		for (; i < n; i++)
+			f[i] = x[i] - ((x[i - bpp] + b[i]) >> 1);
+		break;
+	case 4:
+		for (i = 0; i < bpp && i < n; i++)
+			f[i] = x[i] - b[i];
+		for (; i < n; i++)
+			f[i] = x[i] - paeth(x[i - bpp], b[i], b[i - bpp]);
+		break;
+	}
+}
+
+
+/// Filter a row into dst (filter type byte and filtered row). The adaptive
+/// filter takes the filter type with the smallest sum of absolute values, as
+/// stb_image_write does; scratch has room for a row.
+static void
+filter_row(unsigned char *dst, const unsigned char *x, const unsigned char *b,
+           size_t n, unsigned char *scratch)
+{
+	int best = png_row_filter;
+	if (best == SIS_PNG_ADAPTIVE) {
+		unsigned long best_sum = (unsigned long)-1;
+		for (int type = 0; type < 5; type++) {
+			unsigned long sum = 0;
+			apply_filter(type, scratch, x, b, n);
+			for (size_t i = 0; i < n; i++)
+				sum += abs((signed char)scratch[i]);
+			if (sum < best_sum) {
+				best_sum = sum;
+				best = type;
+			}
+		}
+	}
+	dst[0] = best;
+	apply_filter(best, dst + 1, x, b, n);
+}
+
+
+static void
+write_band(void)
+{
+	if (band_len == 0)
+		return;
+	adler = Adler32(adler, band, band_len);
+	DeflateBand(&zs, band, band_len);
+	write_data_chunk(zlib_header_bytes(), zlib_header ? 0 : 2, zs.data, zs.len);
+	zlib_header = true;
+	zs.len = 0;
+	band_len = 0;
+}
+
+
+void
+Png_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	png_width = width;
+	row_bytes = set_format(sis->SISPixelFormat, width);
+	band_cap = (BAND_SIZE / (row_bytes + 1) + 1) * (row_bytes + 1);
+	cur_row = (unsigned char *)calloc(row_bytes, 1);
+	prev_row = (unsigned char *)calloc(row_bytes, 1);
+	/// The last row of the band is the scratch buffer of the adaptive filter
+	band = (unsigned char *)malloc(band_cap + row_bytes);
+	if (!cur_row || !prev_row || !band) {
+		fprintf(stderr, "Failed to allocate output row buffers.\n");
+		SISExit(1);
+	}
+	band_len = 0;
+	adler = 1;
+	zlib_header = false;
+	DeflateInit(&zs, sis->png_level);
+	write_header(sis->SISFileName, width, height);
+}
+
+
+void
+Png_WriteSISColorBuffer(ind_t r)
+{
+	if (png_pixfmt == SIS_PIXFMT_BILEVEL) {
+		/// Black is 0 in grey png files
+		GatherBitRow(cur_row, r, 0);
+	} else if (png_pixfmt == SIS_PIXFMT_INDEXED) {
+		GatherIndexRow(cur_row, r);
+	} else {
+		for (ind_t c = 0; c < png_width; c++) {
+			cur_row[3 * c + 0] = SIScolorRGB[c].r;
+			cur_row[3 * c + 1] = SIScolorRGB[c].g;
+			cur_row[3 * c + 2] = SIScolorRGB[c].b;
+		}
+	}
+	filter_row(band + band_len, cur_row, prev_row, row_bytes, band + band_cap);
+	band_len += row_bytes + 1;
+	unsigned char *tmp = prev_row;
+	prev_row = cur_row;
+	cur_row = tmp;
+	if (band_len + row_bytes + 1 > band_cap)
+		write_band();
+}
+
+
+void
+Png_WriteSISFile(void)
+{
+	write_band();
+	write_trailer(&zs, adler, zlib_header);
+}
+
+
+void
+Png_CloseSISFile(void)
+{
+	if (png_fp)
+		CloseOutputFile(png_fp);
+	png_fp = NULL;
+	DeflateFree(&zs);
+	free(cur_row);
+	free(prev_row);
+	free(band);
+	cur_row = prev_row = band = NULL;
+}
+
+
+/// The image is never kept in memory as a whole
+unsigned char *
+Png_GetSISFileBuffer(void)
+{
+	return NULL;
+}
+
+
+/// Filter type from its name, -2 if unknown
+int
+png_filter_from_name(const char *name)
+{
+	static const char *names[] = { "none", "sub", "up", "average", "paeth" };
+	if (!strcmp(name, "adaptive"))
+		return SIS_PNG_ADAPTIVE;
+	if (!strcmp(name, "fixed"))
+		return PNG_FIXED_FILTER;
+	for (int type = 0; type < 5; type++) {
+		if (!strcmp(name, names[type]))
+			return type;
+	}
+	return -2;
+}
+
+
+typedef struct {
+	const unsigned char *pix;
+	ind_t height;
+	size_t row_bytes, stride;
+	ind_t band_rows;
+	deflate_t *zs;
+	uint32_t *adler;
+	size_t *raw_len;
+} image_job_t;
+
+
+/// Filter and compress the png bands [begin, end)
+static void
+compress_bands(void *arg, int worker, ind_t begin, ind_t end)
+{
+	image_job_t *job = (image_job_t *)arg;
+	size_t n = job->row_bytes;
+	unsigned char *raw = (unsigned char *)malloc(job->band_rows * (n + 1) + n);
+	unsigned char *zeros = (unsigned char *)calloc(n, 1);
+	(void)worker;
+	if (!raw || !zeros) {
+		fprintf(stderr, "Failed to allocate compression buffer.\n");
+		SISExit(1);
+	}
+	for (ind_t b = begin; b < end; b++) {
+		ind_t first = b * job->band_rows;
+		ind_t last = first + job->band_rows < job->height ? first + job->band_rows : job->height;
+		size_t len = 0;
+		for (ind_t r = first; r < last; r++, len += n + 1) {
+			const unsigned char *x = job->pix + r * job->stride;
+			filter_row(raw + len, x, r ? x - job->stride : zeros, n, raw + job->band_rows * (n + 1));
+		}
+		DeflateInit(&job->zs[b], sis->png_level);
+		DeflateBand(&job->zs[b], raw, len);
+		job->adler[b] = Adler32(1, raw, len);
+		job->raw_len[b] = len;
+	}
+	free(zeros);
+	free(raw);
+}
+
+
+/// Filter and compress the rows of n bytes (stride bytes apart) in parallel
+/// and write them as image data
+static void
+write_image_data(const unsigned char *pix, size_t stride, size_t n, ind_t height)
+{
+	ind_t band_rows = BAND_SIZE / (n + 1) + 1;
+	ind_t bands = (height + band_rows - 1) / band_rows;
+	image_job_t job = { pix, height, n, stride, band_rows,
+	                    (deflate_t *)calloc(bands + 1, sizeof(deflate_t)),
+	                    (uint32_t *)calloc(bands + 1, sizeof(uint32_t)),
+	                    (size_t *)calloc(bands + 1, sizeof(size_t)) };
+	if (!job.zs || !job.adler || !job.raw_len) {
+		fprintf(stderr, "Failed to allocate compression buffer.\n");
+		SISExit(1);
+	}
+	ParallelFor(bands, ParallelBands(bands, 1), compress_bands, &job);
+
+	uint32_t checksum = 1;
+	for (ind_t b = 0; b < bands; b++) {
+		write_data_chunk(zlib_header_bytes(), b ? 0 : 2, job.zs[b].data, job.zs[b].len);
+		checksum = Adler32Combine(checksum, job.adler[b], job.raw_len[b]);
+		DeflateFree(&job.zs[b]);
+	}
+	DeflateInit(&job.zs[bands], 0);
+	finish_data(&job.zs[bands], checksum, bands > 0);
+	DeflateFree(&job.zs[bands]);
+	free(job.zs);
+	free(job.adler);
+	free(job.raw_len);
+}
+
+
+void
+PngWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height,
+              int pixfmt)
+{
+	size_t n = set_format(pixfmt, width);
+	write_header(FileName, width, height);
+	write_image_data(pix, n, n, height);
+	write_end();
+}
+
+
+void
+ApngOpen(const char *FileName, ind_t width, ind_t height, int pixfmt, long frames, int fps)
+{
+	unsigned char actl[8];
+	set_format(pixfmt, width);
+	write_header(FileName, width, height);
+	put_be32(actl, frames);
+	put_be32(actl + 4, 0);      /// loop forever
+	write_chunk("acTL", actl, 8, NULL, 0);
+	apng_seq = 0;
+	apng_fdat = false;
+	apng_fps = fps;
+}
+
+
+void
+ApngWriteFrame(const unsigned char *pix, size_t stride, ind_t x, ind_t y, ind_t width, ind_t height)
+{
+	unsigned char fctl[26];
+	put_be32(fctl, apng_seq++);
+	put_be32(fctl + 4, width);
+	put_be32(fctl + 8, height);
+	put_be32(fctl + 12, x);
+	put_be32(fctl + 16, y);
+	fctl[20] = 0;               /// delay 1/fps seconds
+	fctl[21] = 1;
+	fctl[22] = apng_fps >> 8;
+	fctl[23] = apng_fps;
+	fctl[24] = 0;               /// leave the frame for the next one,
+	fctl[25] = 0;               /// which replaces the pixels of its region
+	write_chunk("fcTL", fctl, 26, NULL, 0);
+	write_image_data(pix, stride, set_format(png_pixfmt, width), height);
+	apng_fdat = true;
+}
+
+
+void
+ApngClose(void)
+{
+	apng_fdat = false;
+	write_end();
+}
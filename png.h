@@ -0,0 +1,42 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sis.h"
+
+void Png_CreateSISBuffer(ind_t width, ind_t height, int SIStype);
+void Png_WriteSISColorBuffer(ind_t r);
+void Png_WriteSISFile(void);
+void Png_CloseSISFile(void);
+unsigned char *Png_GetSISFileBuffer(void);
+
+/// Write an image with the parallel png encoder, pix has the rows in the
+/// pixel format pixfmt (SIS_PIXFMT_*)
+void PngWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height,
+                   int pixfmt);
+
+/// Animated png with frames frames, which are shown for 1/fps seconds each.
+/// The first frame covers the whole image, the others only the rectangle that
+/// changed. pix points to the top left pixel of the rectangle, its rows are
+/// stride bytes apart.
+void ApngOpen(const char *FileName, ind_t width, ind_t height, int pixfmt, long frames, int fps);
+void ApngWriteFrame(const unsigned char *pix, size_t stride, ind_t x, ind_t y, ind_t width, ind_t height);
+void ApngClose(void);
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "qoi.h"
+
+/*
+
+qoi writer (see qoiformat.org).
+
+qoi compresses each pixel with a few comparisons against the previous pixel
+and a table of 64 recently seen colors. There is no entropy coding, so it
+writes lossless files many times faster than png, which are not much larger
+for stereograms. The encoder only looks back one pixel, so the rows can be
+written while they are rendered (--stream) as well as from a whole image.
+
+*/
+
+#define QOI_OP_INDEX  0x00
+#define QOI_OP_DIFF   0x40
+#define QOI_OP_LUMA   0x80
+#define QOI_OP_RUN    0xc0
+#define QOI_OP_RGB    0xfe
+/// Maximum length of a run
+#define QOI_RUN_MAX   62
+
+typedef struct {
+	FILE *fp;
+	const char *name;
+	uint32_t index[64];
+	uint32_t prev;
+	int run;
+	/// Encoded row, up to 4 bytes per pixel
+	unsigned char *out;
+} qoi_t;
+
+static qoi_t qs;
+static ind_t qoi_width;
+static unsigned char *qoi_row;
+
+
+static void
+write_bytes(qoi_t *q, const void *data, size_t len)
+{
+	if (len && fwrite(data, 1, len, q->fp) != len) {
+		fprintf(stderr, "Failed to write %s.\n", q->name);
+		SISExit(1);
+	}
+}
+
+
+static void
+qoi_open(qoi_t *q, const char *FileName, ind_t width, ind_t height)
+{
+	unsigned char header[14] = { 'q', 'o', 'i', 'f',
+	                             width >> 24, width >> 16, width >> 8, width,
+	                             height >> 24, height >> 16, height >> 8, height,
+	                             3,      /// RGB
+	                             0 };    /// sRGB
+	memset(q, 0, sizeof(*q));
+	q->name = FileName;
+	q->prev = 0xff000000;
+	if (!(q->out = (unsigned char *)malloc(width * 4 + 1))) {
+		fprintf(stderr, "Failed to allocate output row buffer.\n");
+		SISExit(1);
+	}
+	if (!(q->fp = OpenOutputFile(FileName))) {
+		fprintf(stderr, "Failed to open %s for writing.\n", FileName);
+		SISExit(1);
+	}
+	write_bytes(q, header, sizeof(header));
+}
+
+
+/// Encode a row of 8-bit RGB pixels
+static void
+qoi_encode_row(qoi_t *q, const unsigned char *pix, ind_t width)
+{
+	unsigned char *o = q->out;
+	for (ind_t c = 0; c < width; c++, pix += 3) {
+		uint32_t px = pix[0] | pix[1] << 8 | pix[2] << 16 | 0xff000000;
+		if (px == q->prev) {
+			if (++q->run == QOI_RUN_MAX) {
+				*o++ = QOI_OP_RUN | (q->run - 1);
+				q->run = 0;
+			}
+			continue;
+		}
+		if (q->run) {
+			*o++ = QOI_OP_RUN | (q->run - 1);
+			q->run = 0;
+		}
+		int hash = (pix[0] * 3 + pix[1] * 5 + pix[2] * 7 + 255 * 11) % 64;
+		if (q->index[hash] == px) {
+			*o++ = QOI_OP_INDEX | hash;
+		} else {
+			q->index[hash] = px;
+			signed char vr = pix[0] - (q->prev & 0xff);
+			signed char vg = pix[1] - (q->prev >> 8 & 0xff);
+			signed char vb = pix[2] - (q->prev >> 16 & 0xff);
+			signed char vg_r = vr - vg, vg_b = vb - vg;
+			if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+				*o++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+			} else if (vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 && vg_b >= -8 && vg_b <= 7) {
+				*o++ = QOI_OP_LUMA | (vg + 32);
+				*o++ = (vg_r + 8) << 4 | (vg_b + 8);
+			} else {
+				*o++ = QOI_OP_RGB;
+				*o++ = pix[0];
+				*o++ = pix[1];
+				*o++ = pix[2];
+			}
+		}
+		q->prev = px;
+	}
+	write_bytes(q, q->out, o - q->out);
+}
+
+
+static void
+qoi_close(qoi_t *q)
+{
+	static const unsigned char end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	if (q->run) {
+		unsigned char op = QOI_OP_RUN | (q->run - 1);
+		write_bytes(q, &op, 1);
+	}
+	write_bytes(q, end, sizeof(end));
+	if (CloseOutputFile(q->fp)) {
+		fprintf(stderr, "Failed to write %s.\n", q->name);
+		SISExit(1);
+	}
+	q->fp = NULL;
+	free(q->out);
+	q->out = NULL;
+}
+
+
+void
+Qoi_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	qoi_width = width;
+	if (!(qoi_row = (unsigned char *)malloc(width * 3))) {
+		fprintf(stderr, "Failed to allocate output row buffer.\n");
+		SISExit(1);
+	}
+	qoi_open(&qs, sis->SISFileName, width, height);
+}
+
+
+void
+Qoi_WriteSISColorBuffer(ind_t r)
+{
+	for (ind_t c = 0; c < qoi_width; c++) {
+		qoi_row[3 * c + 0] = SIScolorRGB[c].r;
+		qoi_row[3 * c + 1] = SIScolorRGB[c].g;
+		qoi_row[3 * c + 2] = SIScolorRGB[c].b;
+	}
+	qoi_encode_row(&qs, qoi_row, qoi_width);
+}
+
+
+void
+Qoi_WriteSISFile(void)
+{
+	qoi_close(&qs);
+}
+
+
+void
+Qoi_CloseSISFile(void)
+{
+	if (qs.fp)
+		CloseOutputFile(qs.fp);
+	qs.fp = NULL;
+	free(qs.out);
+	free(qoi_row);
+	qs.out = qoi_row = NULL;
+}
+
+
+/// The image is never kept in memory as a whole
+unsigned char *
+Qoi_GetSISFileBuffer(void)
+{
+	return NULL;
+}
+
+
+void
+QoiWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height)
+{
+	qoi_t q;
+	qoi_open(&q, FileName, width, height);
+	for (ind_t r = 0; r < height; r++)
+		qoi_encode_row(&q, pix + r * width * 3, width);
+	qoi_close(&q);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sis.h"
+#include "resample.h"
+
+/*
+
+Separable image resampling.
+
+Each destination pixel is a weighted sum of the source pixels around its
+center. The weights come from the filter, which is widened by the scale
+factor when shrinking, so that every source pixel contributes (no
+aliasing). The weights of a destination row or column are computed once
+and normalized to a sum of 1.
+
+The destination rows are computed in parallel bands. Each one first sums
+the source rows vertically into a float row and then filters that row
+horizontally. Textures have 8-bit channels, depth maps 16-bit values.
+
+*/
+
+/// Weights of the source pixels of each destination pixel, count per pixel
+typedef struct {
+	int count;
+	ind_t *index;
+	float *weight;
+} taps_t;
+
+typedef struct {
+	const void *src;
+	ind_t sw;
+	void *dst;
+	ind_t dw;
+	int channels;
+	bool wide;                /// 16-bit instead of 8-bit channels
+	taps_t *htaps, *vtaps;
+} resample_t;
+
+
+static const char *filter_names[] = {
+	[SIS_FILTER_BOX]      = "box",
+	[SIS_FILTER_BILINEAR] = "bilinear",
+	[SIS_FILTER_LANCZOS]  = "lanczos",
+};
+
+
+int
+ResampleFilterFromName(const char *name)
+{
+	for (int filter = SIS_FILTER_BOX; filter <= SIS_FILTER_LANCZOS; filter++) {
+		if (!strcmp(name, filter_names[filter]))
+			return filter;
+	}
+	return -1;
+}
+
+
+const char *
+ResampleFilterName(int filter)
+{
+	if (filter < SIS_FILTER_BOX || filter > SIS_FILTER_LANCZOS)
+		return "nearest";
+	return filter_names[filter];
+}
+
+
+static float
+filter_support(int filter)
+{
+	switch (filter) {
+	case SIS_FILTER_BOX:
+		return 0.5f;
+	case SIS_FILTER_LANCZOS:
+		return 3.0f;
+	default:
+		return 1.0f;
+	}
+}
+
+
+static float
+filter_weight(int filter, float x)
+{
+	x = fabsf(x);
+	switch (filter) {
+	case SIS_FILTER_BOX:
+		return x <= 0.5f ? 1.0f : 0.0f;
+	case SIS_FILTER_LANCZOS:
+		if (x < 1e-6f)
+			return 1.0f;
+		if (x >= 3.0f)
+			return 0.0f;
+		x *= 3.14159265f;
+		return 3.0f * sinf(x) * sinf(x / 3.0f) / (x * x);
+	default:
+		return x < 1.0f ? 1.0f - x : 0.0f;
+	}
+}
+
+
+static void
+compute_taps(taps_t *taps, ind_t src, ind_t dst, int filter, bool wrap)
+{
+	float scale = (float)dst / (float)src;
+	/// Shrinking widens the filter to the source pixels of a destination pixel
+	float width = scale < 1.0f ? 1.0f / scale : 1.0f;
+	float support = filter_support(filter) * width;
+	taps->count = (int)ceilf(2.0f * support) + 1;
+	taps->index = (ind_t *)malloc(dst * taps->count * sizeof(ind_t));
+	taps->weight = (float *)malloc(dst * taps->count * sizeof(float));
+	if (!taps->index || !taps->weight) {
+		fprintf(stderr, "Failed to allocate resampling weights.\n");
+		SISExit(1);
+	}
+	for (ind_t i = 0; i < dst; i++) {
+		ind_t *index = taps->index + i * taps->count;
+		float *weight = taps->weight + i * taps->count;
+		float center = ((float)i + 0.5f) / scale;
+		ind_t first = (ind_t)floorf(center - support);
+		float sum = 0.0f;
+		for (int k = 0; k < taps->count; k++) {
+			ind_t j = first + k;
+			weight[k] = filter_weight(filter, ((float)j + 0.5f - center) / width);
+			sum += weight[k];
+			if (wrap)
+				j = (j % src + src) % src;
+			else
+				j = j < 0 ? 0 : j >= src ? src - 1 : j;
+			index[k] = j;
+		}
+		for (int k = 0; k < taps->count; k++)
+			weight[k] = sum != 0.0f ? weight[k] / sum : (k == 0);
+	}
+}
+
+
+static void
+free_taps(taps_t *taps)
+{
+	free(taps->index);
+	free(taps->weight);
+}
+
+
+static void
+resample_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	const resample_t *rs = (const resample_t *)arg;
+	int ch = rs->channels;
+	float *row = (float *)malloc(rs->sw * ch * sizeof(float));
+	if (!row) {
+		fprintf(stderr, "Failed to allocate resampling row.\n");
+		SISExit(1);
+	}
+	for (ind_t y = begin; y < end; y++) {
+		const ind_t *vindex = rs->vtaps->index + y * rs->vtaps->count;
+		const float *vweight = rs->vtaps->weight + y * rs->vtaps->count;
+		for (ind_t i = 0; i < rs->sw * ch; i++)
+			row[i] = 0.0f;
+		for (int k = 0; k < rs->vtaps->count; k++) {
+			size_t offset = (size_t)vindex[k] * rs->sw * ch;
+			float w = vweight[k];
+			if (w == 0.0f)
+				continue;
+			if (rs->wide) {
+				const uint16_t *s = (const uint16_t *)rs->src + offset;
+				for (ind_t i = 0; i < rs->sw * ch; i++)
+					row[i] += w * s[i];
+			} else {
+				const unsigned char *s = (const unsigned char *)rs->src + offset;
+				for (ind_t i = 0; i < rs->sw * ch; i++)
+					row[i] += w * s[i];
+			}
+		}
+		float max = rs->wide ? 65535.0f : 255.0f;
+		size_t offset = (size_t)y * rs->dw * ch;
+		for (ind_t x = 0; x < rs->dw; x++) {
+			const ind_t *hindex = rs->htaps->index + x * rs->htaps->count;
+			const float *hweight = rs->htaps->weight + x * rs->htaps->count;
+			for (int c = 0; c < ch; c++) {
+				float v = 0.5f;
+				for (int k = 0; k < rs->htaps->count; k++)
+					v += hweight[k] * row[hindex[k] * ch + c];
+				/// Lanczos overshoots at edges
+				v = v <= 0.0f ? 0.0f : v >= max ? max : v;
+				if (rs->wide)
+					((uint16_t *)rs->dst)[offset + x * ch + c] = (uint16_t)v;
+				else
+					((unsigned char *)rs->dst)[offset + x * ch + c] = (unsigned char)v;
+			}
+		}
+	}
+	free(row);
+}
+
+
+static void
+resample_image(const void *src, ind_t sw, ind_t sh, void *dst, ind_t dw, ind_t dh,
+               int channels, bool wide, int filter, bool wrap)
+{
+	taps_t htaps, vtaps;
+	compute_taps(&htaps, sw, dw, filter, wrap);
+	compute_taps(&vtaps, sh, dh, filter, wrap);
+	resample_t rs = { src, sw, dst, dw, channels, wide, &htaps, &vtaps };
+	ParallelFor(dh, ParallelBands(dh, 8), resample_band, &rs);
+	free_taps(&htaps);
+	free_taps(&vtaps);
+}
+
+
+void
+ResampleImage8(const unsigned char *src, ind_t sw, ind_t sh,
+               unsigned char *dst, ind_t dw, ind_t dh,
+               int channels, int filter, bool wrap)
+{
+	resample_image(src, sw, sh, dst, dw, dh, channels, false, filter, wrap);
+}
+
+
+void
+ResampleImage16(const uint16_t *src, ind_t sw, ind_t sh,
+                uint16_t *dst, ind_t dw, ind_t dh,
+                int channels, int filter, bool wrap)
+{
+	resample_image(src, sw, sh, dst, dw, dh, channels, true, filter, wrap);
+}
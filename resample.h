@@ -0,0 +1,44 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sis.h"
+
+/// Filters of the resampling
+#define SIS_FILTER_BOX       0
+#define SIS_FILTER_BILINEAR  1
+#define SIS_FILTER_LANCZOS   2
+
+/// Filter of a name like "lanczos", -1 if there is none
+int ResampleFilterFromName(const char *name);
+/// Name of a filter, "nearest" for -1
+const char *ResampleFilterName(int filter);
+
+/// Resample an image with 8-bit channels from sw x sh to dw x dh pixels.
+/// With wrap the image is periodic (a tiled texture), otherwise the edge
+/// pixels are repeated.
+void ResampleImage8(const unsigned char *src, ind_t sw, ind_t sh,
+                    unsigned char *dst, ind_t dw, ind_t dh,
+                    int channels, int filter, bool wrap);
+/// The same with 16-bit channels, for depth maps
+void ResampleImage16(const uint16_t *src, ind_t sw, ind_t sh,
+                     uint16_t *dst, ind_t dw, ind_t dh,
+                     int channels, int filter, bool wrap);
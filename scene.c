@@ -0,0 +1,459 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sis.h"
+#include "scene.h"
+
+#define STB_TRUETYPE_IMPLEMENTATION
+/// sisui links stb_truetype from nanovg, too
+#define STBTT_STATIC
+#include "stb_truetype.h"
+
+/*
+
+Depth maps of simple scenes, given with --shape instead of a depth file.
+
+Text and simple shapes (spheres, boxes and rings) are the most common
+stereograms. Instead of rendering them into an image file that is decoded
+again, the rows of the depth map are computed from the shapes when they
+are read. Nothing but the glyphs of the text is kept in memory, and the
+scene is sharp at any size of the SIS (-x, -y).
+
+Shapes stand on the far plane. Where they overlap, the nearest one is
+seen. Positions and sizes are in dots of the depth map, or with a '%' in
+percent of its width (x, w of boxes) or height (all others).
+
+*/
+
+#define SHAPE_SPHERE  0
+#define SHAPE_BOX     1
+#define SHAPE_RING    2
+#define SHAPE_TEXT    3
+
+#define SCENE_MAX_SHAPES  64
+/// Size of the depth map if neither -x nor -y are given
+#define SCENE_WIDTH       1280
+#define SCENE_HEIGHT      720
+#define DefaultFontName   "DejaVuSans.ttf"
+
+static const struct {
+	const char *name;
+	const char *keys;
+} shape_kinds[] = {
+	[SHAPE_SPHERE] = { "sphere", "x y r depth" },
+	[SHAPE_BOX]    = { "box", "x y w h depth" },
+	[SHAPE_RING]   = { "ring", "x y r w depth" },
+	[SHAPE_TEXT]   = { "text", "x y size depth font text" },
+};
+
+/// A position or size in dots, or in percent of the width or height
+typedef struct {
+	float value;
+	bool percent;
+} length_t;
+
+/// Rendered glyph of a text, at its position in the depth map
+typedef struct {
+	ind_t x, y, width, height;
+	unsigned char *coverage;
+} glyph_t;
+
+typedef struct scene_shape {
+	int kind;
+	length_t x, y, r, w, h, size;
+	float depth;                  /// Height above the far plane in percent
+	const char *font;
+	const char *text;
+	/// Set in Scene_OpenDFile() for the size of the depth map
+	float cx, cy, rx, ry, tube;
+	ind_t top, bottom;            /// The rows [top, bottom) of the shape
+	float z;
+	glyph_t *glyphs;
+	int glyph_count;
+} shape_t;
+
+static uint16_t *zrow;
+
+
+/// Parse a length like "120" or "25%"
+static bool
+parse_length(const char *s, length_t *len)
+{
+	char *end;
+	len->value = strtof(s, &end);
+	len->percent = *end == '%';
+	if (len->percent)
+		end++;
+	return end != s && (*end == ':' || *end == 0);
+}
+
+
+/// The key of length len is one of the words in keys
+static bool
+has_key(const char *keys, const char *key, size_t len)
+{
+	for (const char *k = keys; *k; ) {
+		size_t n = strcspn(k, " ");
+		if (n == len && !strncmp(k, key, len))
+			return true;
+		k += n;
+		if (*k == ' ')
+			k++;
+	}
+	return false;
+}
+
+
+static bool
+parse_parameter(shape_t *shape, const char *spec)
+{
+	size_t len = strcspn(spec, "=:");
+	const char *value = spec + len + 1;
+	if (spec[len] != '=' || !has_key(shape_kinds[shape->kind].keys, spec, len))
+		return false;
+	switch (spec[0]) {
+	case 'x':
+		return parse_length(value, &shape->x);
+	case 'y':
+		return parse_length(value, &shape->y);
+	case 'r':
+		return parse_length(value, &shape->r) && shape->r.value > 0.0f;
+	case 'w':
+		return parse_length(value, &shape->w) && shape->w.value > 0.0f;
+	case 'h':
+		return parse_length(value, &shape->h) && shape->h.value > 0.0f;
+	case 's':
+		return parse_length(value, &shape->size) && shape->size.value > 0.0f;
+	case 'd': {
+		char *end;
+		shape->depth = strtof(value, &end);
+		return end != value && (*end == ':' || *end == 0)
+		       && shape->depth >= 0.0f && shape->depth <= 100.0f;
+	}
+	case 'f': {
+		size_t len = strcspn(value, ":");
+		char *font = (char *)malloc(len + 1);
+		if (!font) {
+			fprintf(stderr, "Failed to allocate scene font name.\n");
+			SISExit(1);
+		}
+		memcpy(font, value, len);
+		font[len] = 0;
+		shape->font = font;
+		return len != 0;
+	}
+	}
+	return false;
+}
+
+
+bool
+AddSceneShape(const char *spec)
+{
+	if (sis->scene_shapes == SCENE_MAX_SHAPES)
+		return false;
+	/// The shapes belong to the state, FreeState() frees them
+	if (!sis->shapes && !(sis->shapes = (shape_t *)malloc(SCENE_MAX_SHAPES * sizeof(shape_t))))
+		return false;
+	shape_t *shape = &sis->shapes[sis->scene_shapes];
+	size_t len = strcspn(spec, ":");
+	for (shape->kind = 0; shape->kind <= SHAPE_TEXT; shape->kind++) {
+		if (strlen(shape_kinds[shape->kind].name) == len
+		    && !strncmp(spec, shape_kinds[shape->kind].name, len))
+			break;
+	}
+	if (shape->kind > SHAPE_TEXT)
+		return false;
+	shape->x = shape->y = (length_t){ 50.0f, true };
+	shape->r = (length_t){ 30.0f, true };
+	shape->w = shape->kind == SHAPE_RING ? (length_t){ 10.0f, true } : (length_t){ 50.0f, true };
+	shape->h = (length_t){ 50.0f, true };
+	shape->size = (length_t){ 30.0f, true };
+	shape->depth = shape->kind == SHAPE_BOX ? 50.0f : 100.0f;
+	shape->font = NULL;
+	shape->text = NULL;
+	for (const char *p = spec + len; *p == ':'; p = p + 1 + strcspn(p + 1, ":")) {
+		/// The text is the rest of the spec, it may have colons
+		if (shape->kind == SHAPE_TEXT && !strncmp(p + 1, "text=", 5)) {
+			shape->text = p + 6;
+			break;
+		}
+		if (!parse_parameter(shape, p + 1))
+			return false;
+	}
+	if (shape->kind == SHAPE_TEXT && (!shape->text || !shape->text[0]))
+		return false;
+	sis->scene_shapes++;
+	return true;
+}
+
+
+static float
+resolve(length_t len, ind_t size)
+{
+	return len.percent ? len.value * (float)size / 100.0f : len.value;
+}
+
+
+/// Next code point of the UTF-8 string s, invalid bytes are taken as Latin-1
+static int
+next_codepoint(const unsigned char **s)
+{
+	const unsigned char *p = *s;
+	int n = p[0] >= 0xf0 ? 3 : p[0] >= 0xe0 ? 2 : p[0] >= 0xc0 ? 1 : 0;
+	int cp = n ? p[0] & (0x3f >> n) : p[0];
+	for (int i = 1; i <= n; i++) {
+		if ((p[i] & 0xc0) != 0x80) {
+			*s = p + 1;
+			return p[0];
+		}
+		cp = cp << 6 | (p[i] & 0x3f);
+	}
+	*s = p + n + 1;
+	return cp;
+}
+
+
+static unsigned char *
+read_font(const char *FileName)
+{
+	FILE *fp = fopen(FileName, "rb");
+	if (!fp) {
+		fprintf(stderr, "failed to open font file '%s'\n", FileName);
+		SISExit(EXIT_FAILURE);
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	unsigned char *data = malloc(size > 0 ? size : 1);
+	if (!data || size <= 0 || fread(data, 1, size, fp) != (size_t)size) {
+		fprintf(stderr, "failed to read font file '%s'\n", FileName);
+		SISExit(EXIT_FAILURE);
+	}
+	fclose(fp);
+	return data;
+}
+
+
+/// Render the glyphs of the text, centered at (cx, cy)
+static void
+layout_text(shape_t *shape, float size)
+{
+	char FontName[PATH_MAX];
+	stbtt_fontinfo font;
+	if (shape->font)
+		strncpy(FontName, shape->font, PATH_MAX - 1);
+	else
+		snprintf(FontName, PATH_MAX, "%s/%s", ASSET_PREFIX, DefaultFontName);
+	FontName[PATH_MAX - 1] = 0;
+	unsigned char *data = read_font(FontName);
+	if (!stbtt_InitFont(&font, data, stbtt_GetFontOffsetForIndex(data, 0))) {
+		fprintf(stderr, "font file '%s' is not a TrueType font\n", FontName);
+		SISExit(EXIT_FAILURE);
+	}
+	float scale = stbtt_ScaleForPixelHeight(&font, size);
+	int ascent, descent, gap;
+	stbtt_GetFontVMetrics(&font, &ascent, &descent, &gap);
+
+	/// Measure the text to center it
+	float width = 0.0f;
+	int count = 0, prev = 0;
+	for (const unsigned char *s = (const unsigned char *)shape->text; *s; count++) {
+		int cp = next_codepoint(&s), advance, lsb;
+		stbtt_GetCodepointHMetrics(&font, cp, &advance, &lsb);
+		width += scale * (advance + (prev ? stbtt_GetCodepointKernAdvance(&font, prev, cp) : 0));
+		prev = cp;
+	}
+	shape->glyphs = calloc(count, sizeof(glyph_t));
+	if (!shape->glyphs) {
+		fprintf(stderr, "failed to allocate the glyphs of '%s'\n", shape->text);
+		SISExit(EXIT_FAILURE);
+	}
+	float pen = shape->cx - width / 2.0f;
+	ind_t baseline = (ind_t)floorf(shape->cy + scale * (ascent + descent) / 2.0f + 0.5f);
+	shape->top = baseline;
+	shape->bottom = baseline;
+	prev = 0;
+	for (const unsigned char *s = (const unsigned char *)shape->text; *s; ) {
+		int cp = next_codepoint(&s), advance, lsb, w, h, xoff, yoff;
+		if (prev)
+			pen += scale * stbtt_GetCodepointKernAdvance(&font, prev, cp);
+		float x = floorf(pen);
+		glyph_t *glyph = &shape->glyphs[shape->glyph_count];
+		glyph->coverage = stbtt_GetCodepointBitmapSubpixel(&font, scale, scale, pen - x, 0.0f,
+		                                                    cp, &w, &h, &xoff, &yoff);
+		if (glyph->coverage) {
+			glyph->x = (ind_t)x + xoff;
+			glyph->y = baseline + yoff;
+			glyph->width = w;
+			glyph->height = h;
+			if (glyph->y < shape->top)
+				shape->top = glyph->y;
+			if (glyph->y + h > shape->bottom)
+				shape->bottom = glyph->y + h;
+			shape->glyph_count++;
+		}
+		stbtt_GetCodepointHMetrics(&font, cp, &advance, &lsb);
+		pen += scale * advance;
+		prev = cp;
+	}
+	free(data);
+}
+
+
+void
+Scene_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	(void)DFileName;
+	/// The depth map has the size of the SIS, it's computed at any size
+	*width = sis->SISwidth ? sis->SISwidth : sis->SISheight ? sis->SISheight * SCENE_WIDTH / SCENE_HEIGHT : SCENE_WIDTH;
+	*height = sis->SISheight ? sis->SISheight : *width * SCENE_HEIGHT / SCENE_WIDTH;
+	for (int i = 0; i < sis->scene_shapes; i++) {
+		shape_t *shape = &sis->shapes[i];
+		shape->cx = resolve(shape->x, *width);
+		shape->cy = resolve(shape->y, *height);
+		shape->z = shape->depth / 100.0f * SIS_MAX_DEPTH;
+		switch (shape->kind) {
+		case SHAPE_SPHERE:
+			shape->rx = shape->ry = resolve(shape->r, *height);
+			break;
+		case SHAPE_BOX:
+			shape->rx = resolve(shape->w, *width) / 2.0f;
+			shape->ry = resolve(shape->h, *height) / 2.0f;
+			break;
+		case SHAPE_RING:
+			shape->tube = resolve(shape->w, *height) / 2.0f;
+			shape->rx = shape->ry = resolve(shape->r, *height) + shape->tube;
+			break;
+		case SHAPE_TEXT:
+			layout_text(shape, resolve(shape->size, *height));
+			continue;
+		}
+		shape->top = (ind_t)floorf(shape->cy - shape->ry);
+		shape->bottom = (ind_t)ceilf(shape->cy + shape->ry);
+	}
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+	zrow = malloc(*width * sizeof(uint16_t));
+	if (!zrow) {
+		fprintf(stderr, "failed to allocate the depth row\n");
+		SISExit(EXIT_FAILURE);
+	}
+}
+
+
+/// Raise the depth row to z where the shape is nearer
+static void
+add_shape_row(const shape_t *shape, ind_t r)
+{
+	float y = (float)r + 0.5f - shape->cy;
+	ind_t x0 = (ind_t)floorf(shape->cx - shape->rx);
+	ind_t x1 = (ind_t)ceilf(shape->cx + shape->rx);
+	if (x0 < 0)
+		x0 = 0;
+	if (x1 > sis->Dwidth)
+		x1 = sis->Dwidth;
+	switch (shape->kind) {
+	case SHAPE_SPHERE:
+		for (ind_t c = x0; c < x1; c++) {
+			float x = (float)c + 0.5f - shape->cx;
+			float q = 1.0f - (x * x + y * y) / (shape->rx * shape->rx);
+			uint16_t z = q > 0.0f ? (uint16_t)(shape->z * sqrtf(q)) : 0;
+			if (z > zrow[c])
+				zrow[c] = z;
+		}
+		break;
+	case SHAPE_BOX:
+		for (ind_t c = x0; c < x1; c++) {
+			float x = (float)c + 0.5f - shape->cx;
+			if (fabsf(x) < shape->rx && fabsf(y) < shape->ry && shape->z > zrow[c])
+				zrow[c] = (uint16_t)shape->z;
+		}
+		break;
+	case SHAPE_RING:
+		for (ind_t c = x0; c < x1; c++) {
+			float x = (float)c + 0.5f - shape->cx;
+			float d = (sqrtf(x * x + y * y) - (shape->rx - shape->tube)) / shape->tube;
+			float q = 1.0f - d * d;
+			uint16_t z = q > 0.0f ? (uint16_t)(shape->z * sqrtf(q)) : 0;
+			if (z > zrow[c])
+				zrow[c] = z;
+		}
+		break;
+	case SHAPE_TEXT:
+		for (int i = 0; i < shape->glyph_count; i++) {
+			const glyph_t *glyph = &shape->glyphs[i];
+			if (r < glyph->y || r >= glyph->y + glyph->height)
+				continue;
+			const unsigned char *src = glyph->coverage + (r - glyph->y) * glyph->width;
+			for (ind_t j = 0; j < glyph->width; j++) {
+				ind_t c = glyph->x + j;
+				uint16_t z = (uint16_t)(shape->z * src[j] / 255.0f);
+				if (c >= 0 && c < sis->Dwidth && z > zrow[c])
+					zrow[c] = z;
+			}
+		}
+		break;
+	}
+}
+
+
+void
+Scene_ReadDBuffer(ind_t r)
+{
+	col_t lo, hi;
+	memset(zrow, 0, sis->Dwidth * sizeof(uint16_t));
+	for (int i = 0; i < sis->scene_shapes; i++) {
+		if (r >= sis->shapes[i].top && r < sis->shapes[i].bottom)
+			add_shape_row(&sis->shapes[i], r);
+	}
+	sis->IngestDepthRow16(DBuffer, zrow, sis->Dwidth, &lo, &hi);
+	DaddRange(lo, hi, 0);
+}
+
+
+void
+Scene_CloseDFile(void)
+{
+	for (int i = 0; i < sis->scene_shapes; i++) {
+		for (int j = 0; j < sis->shapes[i].glyph_count; j++)
+			stbtt_FreeBitmap(sis->shapes[i].glyphs[j].coverage, NULL);
+		free(sis->shapes[i].glyphs);
+		sis->shapes[i].glyphs = NULL;
+		sis->shapes[i].glyph_count = 0;
+	}
+	free(zrow);
+	zrow = NULL;
+}
+
+
+/// The depth map is never kept in memory as a whole
+unsigned char *
+Scene_GetDFileBuffer(void)
+{
+	return NULL;
+}
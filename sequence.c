@@ -0,0 +1,211 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "sis.h"
+#include "sequence.h"
+
+/*
+
+Depth map sequences, numbered depth files like depth%04d.png.
+
+Each frame is rendered into the SIS file with the same frame number, or
+into the next frame of an animated png or gif file, from the first frame
+until a frame is missing. Frames of an animation usually
+differ in small regions only. Each row of the depth map is compared with
+the same row of the previous frame, and the rows that didn't change are
+copied from the previous SIS frame instead of being rendered again. A
+change in one place can move the colors of the rest of the row along its
+links, so a changed row is always rendered as a whole.
+
+The random dots of a row only depend on the seed (-s) and the row number.
+Static parts of the scene keep their dots from frame to frame and don't
+shimmer.
+
+*/
+
+bool sequence;
+long sequence_frames;
+bool animation;
+
+static char DFilePattern[PATH_MAX], SISFilePattern[PATH_MAX];
+
+
+/// The file name has exactly one frame number like %d or %04d
+static bool
+is_numbered(const char *FileName)
+{
+	int count = 0;
+	for (const char *p = FileName; *p; p++) {
+		if (*p != '%')
+			continue;
+		if (*++p == '%')
+			continue;
+		while (isdigit((unsigned char)*p))
+			p++;
+		if (*p != 'd')
+			return false;
+		count++;
+	}
+	return count == 1;
+}
+
+
+static void
+frame_name(char *FileName, const char *pattern, long frame)
+{
+	if (snprintf(FileName, PATH_MAX, pattern, (int)frame) >= PATH_MAX) {
+		fprintf(stderr, "file name of frame %ld is too long\n", frame);
+		SISExit(EXIT_FAILURE);
+	}
+}
+
+
+static bool
+frame_exists(long frame)
+{
+	char FileName[PATH_MAX];
+	frame_name(FileName, DFilePattern, frame);
+	return access(FileName, R_OK) == 0;
+}
+
+
+void
+InitSequence(void)
+{
+	sequence = is_numbered(sis->DFileName);
+	if (!sequence)
+		return;
+	int format = sis->output_format >= 0 ? sis->output_format : ImgFileFormatFromName(sis->SISFileName);
+	animation = !is_numbered(sis->SISFileName);
+	if (animation && format != SIS_IMGFMT_APNG && format != SIS_IMGFMT_GIF) {
+		fprintf(stderr, "depth map sequences need a numbered SIS file name, e.g. sis%%04d.png,\n"
+		        "or an animated apng or gif file\n");
+		SISExit(EXIT_FAILURE);
+	}
+	strncpy(DFilePattern, sis->DFileName, PATH_MAX - 1);
+	strncpy(SISFilePattern, sis->SISFileName, PATH_MAX - 1);
+	if (sis->first_frame < 0)
+		sis->first_frame = frame_exists(0) ? 0 : 1;
+	for (sequence_frames = 0; frame_exists(sis->first_frame + sequence_frames); sequence_frames++)
+		;
+	frame_name(sis->DFileName, DFilePattern, sis->first_frame);
+	if (!animation)
+		frame_name(sis->SISFileName, SISFilePattern, sis->first_frame);
+}
+
+
+/// Seed of the random dots of a row, never zero
+static uint32_t
+row_seed(uint32_t seed, ind_t row)
+{
+	uint32_t x = seed ^ (uint32_t)row * 0x9e3779b9u;
+	x ^= x >> 16;
+	x *= 0x85ebca6bu;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35u;
+	x ^= x >> 16;
+	return x | 1;
+}
+
+
+/// Finish the SIS file (or the animation frame) of the last frame and open
+/// the files of frame
+static void
+next_frame(long frame)
+{
+	ind_t width = sis->Dwidth, height = sis->Dheight;
+	sis->WriteSISFile();
+	if (!animation)
+		sis->CloseSISFile();
+	sis->CloseDFile();
+	frame_name(sis->DFileName, DFilePattern, frame);
+	OpenDepthMap();
+	if (sis->Dwidth != width || sis->Dheight != height) {
+		fprintf(stderr, "%s is %ldx%ld, the frames before are %ldx%ld\n",
+		        sis->DFileName, sis->Dwidth, sis->Dheight, width, height);
+		SISExit(EXIT_FAILURE);
+	}
+	if (!animation) {
+		frame_name(sis->SISFileName, SISFilePattern, frame);
+		sis->CreateSISBuffer(sis->SISwidth, sis->SISheight, sis->SIStype);
+	}
+}
+
+
+void
+render_sequence(void)
+{
+	sis_stats_t worker_stats = {0};
+	size_t depth_row_size = sis->Dwidth * sizeof(col_t);
+	size_t sis_row_size = SISRowSize();
+	/// Depth map rows and rendered rows of the previous frame, per SIS row
+	col_t *prev_depth = (col_t *)malloc(sis->SISheight * depth_row_size);
+	unsigned char *prev_rows = (unsigned char *)malloc(sis->SISheight * sis_row_size);
+	if (!prev_depth || !prev_rows) {
+		fprintf(stderr, "Failed to allocate the buffers of the previous frame.\n");
+		SISExit(1);
+	}
+	uint32_t seed = (uint32_t)SISRand();
+	for (long frame = sis->first_frame; ; frame++) {
+		ind_t rendered = 0;
+		if (frame != sis->first_frame)
+			next_frame(frame);
+		sis->DLinePosition = 0.0;
+		for (sis->SISLineNumber = 0; sis->SISLineNumber < sis->SISheight; sis->SISLineNumber++) {
+			col_t *depth_row = prev_depth + sis->SISLineNumber * sis->Dwidth;
+			unsigned char *sis_row = prev_rows + sis->SISLineNumber * sis_row_size;
+			sis->DLineNumber = (ind_t)sis->DLinePosition;
+			sis->DLinePosition += sis->DLineStep;
+			max_depth_in_row = SIS_MIN_DEPTH;
+			min_depth_in_row = SIS_MAX_DEPTH;
+
+			sis->ReadDBuffer(sis->DLineNumber);
+			if (frame != sis->first_frame && !memcmp(depth_row, DBuffer, depth_row_size)) {
+				RestoreSISRow(sis_row);
+			} else {
+				uint32_t row_dots = row_seed(seed, sis->SISLineNumber);
+				SetDotSeed(&row_dots);
+				render_line(sis->SISLineNumber, &worker_stats);
+				memcpy(depth_row, DBuffer, depth_row_size);
+				SaveSISRow(sis_row);
+				rendered++;
+			}
+			sis->WriteSISColorBuffer(sis->SISLineNumber);
+		}
+		SetDotSeed(NULL);
+		if (sis->verbose) {
+			printf("  %6ld  %6ld\n", frame, rendered);
+		}
+		/// The SIS file of the last frame is written by the caller
+		if (frame + 1 == sis->first_frame + sequence_frames)
+			break;
+	}
+	MergeStats(&sis->render_stats, &worker_stats);
+	free(prev_depth);
+	free(prev_rows);
+}
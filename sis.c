@@ -1,110 +1,251 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 
 // #include "cfgpath.h"
 #include "cwalk.h"
 
 #include "sis.h"
 #include "stbimg.h"
+#include "png.h"
+#include "qoi.h"
+#include "tiff.h"
+#include "video.h"
+#include "anim.h"
+#include "sequence.h"
+#include "pattern.h"
+#include "scene.h"
+#include "mesh.h"
+#include "dprep.h"
+#include "dstream.h"
+#include "map.h"
 
 
-int ImgFileFormat = SIS_IMGFMT_DFLT;
-ind_t Tcolcount;
-
 char depth_map_path[PATH_MAX] = {0};
 char texture_path[PATH_MAX] = {0};
-char DFileName[PATH_MAX] = {0};
-char TFileName[PATH_MAX] = {0};
-char SISFileName[PATH_MAX] = {0};
 char CFGFileName[PATH_MAX] = {0};
 
-col_t *DBuffer = NULL;
-z_t zvalue[SIS_MAX_COLORS + 1];
-
-cmap_t *SISred, *SISgreen, *SISblue;
-col_rgb_t *SIScolorRGB;
-
-cmap_t black_value, white_value;
-int rand_grey_num, rand_col_num;
-col_t white, black;
-ind_t Dwidth, Dheight, SISwidth, SISheight, Twidth, Theight;
-ind_t eye_dist, origin, halfstripwidth, halftriangwidth;
-int SIStype, SIScompress, verbose;
-bool invert;
-bool mark;
-char metric;
-int resolution;
-int debug;
-double density;
-
-void (*OpenDFile)(char *DFileName, ind_t * width, ind_t * height);
-void (*OpenTFile)(char *TFileName, ind_t * width, ind_t * height);
-void (*CreateSISBuffer)(ind_t width, ind_t height, int SIStype);
-void (*CloseDFile)(void);
-void (*CloseTFile)(ind_t height);
-void (*CloseSISFile)(void);
-void (*WriteSISFile)(void);
-void (*ReadDBuffer)(ind_t r);
-col_t(*ReadTPixel) (ind_t r, ind_t c);
-// void (*WriteSISBuffer)(ind_t r);
-void (*WriteSISColorBuffer)(ind_t r);
-unsigned char *(*GetDFileBuffer)(void);
-unsigned char *(*GetTFileBuffer)(void);
-unsigned char *(*GetSISFileBuffer)(void);
+SIS_THREAD_LOCAL col_t *DBuffer = NULL;
+SIS_THREAD_LOCAL col_rgb_t *SIScolorRGB;
+
+/// The SIS is written to the standard output (SIS file name "-")
+FILE *sis_stdout;
+
+/// State of sis, libsis contexts have their own. It's set to zero, the
+/// options get their values from SetDefaults().
+static sis_state_t main_state;
+SIS_THREAD_LOCAL sis_state_t *sis = &main_state;
 
 const char *DefaultDFileName = "flowers.png";
 const char *DefaultTFileName = "clover.png";
 const char *DefaultSISFileName = "out.png";
-pos_t DLinePosition, DLineStep;
-ind_t SISLineNumber;
-ind_t DLineNumber;
+
+
+static const struct {
+	const char *ext;
+	int format;
+} img_file_formats[] = {
+	{ ".png", SIS_IMGFMT_PNG },
+	{ ".qoi", SIS_IMGFMT_QOI }, { ".bmp", SIS_IMGFMT_BMP },
+	{ ".tga", SIS_IMGFMT_TGA }, { ".jpg", SIS_IMGFMT_JPEG },
+	{ ".jpeg", SIS_IMGFMT_JPEG }, { ".ppm", SIS_IMGFMT_PPM },
+	{ ".raw", SIS_IMGFMT_RAW }, { ".pbm", SIS_IMGFMT_PBM },
+	{ ".tif", SIS_IMGFMT_TIFF }, { ".tiff", SIS_IMGFMT_TIFF },
+	{ ".y4m", SIS_IMGFMT_Y4M }, { ".apng", SIS_IMGFMT_APNG },
+	{ ".gif", SIS_IMGFMT_GIF },
+};
+
+
+/// Output file format of an extension with len characters, -1 if unknown
+static int
+format_from_extension(const char *ext, size_t len)
+{
+	for (size_t i = 0; i < sizeof(img_file_formats) / sizeof(img_file_formats[0]); i++) {
+		if (strlen(img_file_formats[i].ext) != len)
+			continue;
+		size_t j = 0;
+		while (j < len && tolower((unsigned char)ext[j]) == img_file_formats[i].ext[j])
+			j++;
+		if (j == len)
+			return img_file_formats[i].format;
+	}
+	return -1;
+}
+
+
+/// Output file format from the extension of the file name, png if unknown
+int
+ImgFileFormatFromName(const char *FileName)
+{
+	const char *ext;
+	size_t len;
+	int format;
+	if (!cwk_path_get_extension(FileName, &ext, &len)
+	    || (format = format_from_extension(ext, len)) < 0)
+		return SIS_IMGFMT_DFLT;
+	return format;
+}
+
+
+/// Output file format given by name (e.g. "qoi" for --format), -1 if unknown
+int
+ImgFileFormatFromExtension(const char *ext)
+{
+	char dotted[16];
+	if (snprintf(dotted, sizeof(dotted), ".%s", ext) >= (int)sizeof(dotted))
+		return -1;
+	return format_from_extension(dotted, strlen(dotted));
+}
+
+
+bool
+IsStdStream(const char *FileName)
+{
+	return !strcmp(FileName, "-");
+}
+
+
+/// Open an output file for writing, "-" is the standard output
+FILE *
+OpenOutputFile(const char *FileName)
+{
+	if (IsStdStream(FileName))
+		return sis_stdout ? sis_stdout : stdout;
+	return fopen(FileName, "wb");
+}
+
+
+/// Close a file opened with OpenOutputFile, the standard output is only flushed
+int
+CloseOutputFile(FILE *fp)
+{
+	if (fp == stdout || fp == sis_stdout)
+		return fflush(fp);
+	return fclose(fp);
+}
+
+
+/// Keep the standard output for the SIS and send everything that is printed
+/// there to stderr instead, so messages don't end up in the image data
+static void
+redirect_stdout(void)
+{
+	int fd;
+	fflush(stdout);
+	if ((fd = dup(STDOUT_FILENO)) < 0 || !(sis_stdout = fdopen(fd, "wb"))
+	    || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		fprintf(stderr, "failed to redirect the standard output: %s\n", strerror(errno));
+		SISExit(EXIT_FAILURE);
+	}
+}
+
+
+SIS_THREAD_LOCAL jmp_buf *sis_error_jump = NULL;
+
+
+void
+SISExit(int status)
+{
+	if (sis_error_jump)
+		longjmp(*sis_error_jump, status ? status : EXIT_FAILURE);
+	exit(status);
+}
 
 
 void
 SetDefaults(void)
 {
-	cwk_path_join(depth_map_path, DefaultDFileName, DFileName, PATH_MAX);
-	cwk_path_join(texture_path, DefaultTFileName, TFileName, PATH_MAX);
-	strncpy(SISFileName, DefaultSISFileName, PATH_MAX);
+	cwk_path_join(depth_map_path, DefaultDFileName, sis->DFileName, PATH_MAX);
+	cwk_path_join(texture_path, DefaultTFileName, sis->TFileName, PATH_MAX);
+	strncpy(sis->SISFileName, DefaultSISFileName, PATH_MAX);
+	sis->ImgFileFormat = SIS_IMGFMT_DFLT;
 	// SIStype = SIS_RANDOM_GREY;
-	SIStype = SIS_TEXT_MAP;
-	SISwidth = SISheight = 0;
-	algorithm = 2;
-	origin = -1;                /* that means, it is set to SISwidth/2 later */
-	verbose = 0;
-	invert = false;
-	mark = 0;
-	metric = 'i';
-	resolution = 75;
-	oversam = 4;
-	eye_dist = 300;
-	t = 1.0;
-	u = 0.67;
-	rand_grey_num = 2;
-	rand_col_num = SIS_MAX_COLORS;
-	density = 0.5;
-	debug = 0;
+	sis->SIStype = SIS_TEXT_MAP;
+	sis->SISwidth = sis->SISheight = 0;
+	sis->algorithm = 2;
+	sis->origin = -1;                /* that means, it is set to SISwidth/2 later */
+	sis->verbose = 0;
+	sis->invert = false;
+	sis->mark = 0;
+	sis->metric = 'i';
+	sis->resolution = 75;
+	sis->oversam = 4;
+	sis->direct_rgb = false;
+	sis->rand_seed = 1;
+	sis->stream_output = false;
+	sis->indexed_output = false;
+	sis->png_level = 6;
+	sis->png_filter = SIS_PNG_ADAPTIVE;
+	sis->jpeg_quality = 90;
+	sis->tiff_compression = SIS_TIFF_DEFLATE;
+	sis->y4m_chroma = SIS_Y4M_444;
+	sis->anim_fps = 25;
+	sis->cache_files = false;
+	sis->texture_scale = 0.0f;
+	sis->texture_fit = false;
+	sis->output_format = -1;
+	sis->raw_width = sis->raw_height = 0;
+	sis->eye_dist = 300;
+	sis->t = 1.0;
+	sis->u = 0.67;
+	sis->rand_grey_num = 2;
+	sis->rand_col_num = SIS_MAX_COLORS;
+	sis->density = 0.5;
+	sis->debug = 0;
+	/// Options of the other modules, libsis applies the options of a context for each render
+	sis->texture_pattern = false;
+	sis->scene_shapes = 0;
+	sis->depth_prep = false;
+	sis->depth_prep_spec[0] = 0;
+	sis->depth_filter = -1;
+	sis->prep = (prep_params_t){ 0.0f, 0, false, 1.0f };
+	sis->camera_yaw = sis->camera_pitch = sis->camera_fov = 0.0f;
+	sis->first_frame = -1;
+	sis->num_threads = 0;
+	sis->cpu_level_forced = -1;
 }
 
 
 void
 InitFuncs(void)
 {
-	OpenDFile = Stb_OpenDFile;
-	CloseDFile = Stb_CloseDFile;
-	ReadDBuffer = Stb_ReadDBuffer;
-	CreateSISBuffer = Stb_CreateSISBuffer;
-	OpenTFile = Stb_OpenTFile;
-	CloseTFile = Stb_CloseTFile;
-	CloseSISFile = Stb_CloseSISFile;
-	WriteSISFile = Stb_WriteSISFile;
-	ReadTPixel = Stb_ReadTPixel;
+	sis->OpenDFile = Stb_OpenDFile;
+	sis->CloseDFile = Stb_CloseDFile;
+	sis->ReadDBuffer = Stb_ReadDBuffer;
+	sis->CreateSISBuffer = Stb_CreateSISBuffer;
+	sis->OpenTFile = Stb_OpenTFile;
+	sis->CloseTFile = Stb_CloseTFile;
+	sis->CloseSISFile = Stb_CloseSISFile;
+	sis->WriteSISFile = Stb_WriteSISFile;
+	sis->ReadTPixel = Stb_ReadTPixel;
+	sis->ReadTRow = Stb_ReadTRow;
 	// WriteSISBuffer = Stb_WriteSISBuffer;
-	WriteSISColorBuffer = Stb_WriteSISColorBuffer;
-	GetDFileBuffer = Stb_GetDFileBuffer;
-	GetTFileBuffer = Stb_GetTFileBuffer;
-	GetSISFileBuffer = Stb_GetSISFileBuffer;
+	sis->WriteSISColorBuffer = Stb_WriteSISColorBuffer;
+	sis->GetDFileBuffer = Stb_GetDFileBuffer;
+	sis->GetTFileBuffer = Stb_GetTFileBuffer;
+	sis->GetSISFileBuffer = Stb_GetSISFileBuffer;
+}
+
+
+/// New state set to zero like the one of sis, NULL if there is no memory
+sis_state_t *
+NewState(void)
+{
+	return (sis_state_t *)calloc(1, sizeof(sis_state_t));
+}
+
+
+void
+FreeState(sis_state_t *state)
+{
+	if (!state)
+		return;
+	free(state->shapes);
+	free(state->DColumn);
+	free(state);
 }
 
 
@@ -113,9 +254,9 @@ init_base(int argc, char **argv)
 {
 	InitFuncs();
 
-	SISred = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
-	SISgreen = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
-	SISblue = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	sis->SISred = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	sis->SISgreen = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
+	sis->SISblue = (cmap_t *) calloc(SIS_MAX_COLORS + 1, sizeof(cmap_t));
 
 	SetDefaults();
 	/// If command line args are provided (with sis or sisui) or we're running non-gui sis with no args
@@ -124,6 +265,7 @@ init_base(int argc, char **argv)
 		get_options(argc, argv);
 #endif
 	}
+	srand(sis->rand_seed);
 
 #if 0
 	get_user_config_file(CFGFileName, sizeof(CFGFileName), "sis");
@@ -135,32 +277,210 @@ init_base(int argc, char **argv)
 }
 
 
-#include <stdio.h>
-#include <string.h>
-#include <errno.h>
+/// Choose the backend for the depth map DFileName and open it. Depth map
+/// sequences call this for every frame.
+void
+OpenDepthMap(void)
+{
+	char *dname = sis->DFileName;
+	char DCacheName[PATH_MAX] = "";
+	sis->OpenDFile = Stb_OpenDFile;
+	sis->ReadDBuffer = Stb_ReadDBuffer;
+	sis->CloseDFile = Stb_CloseDFile;
+	sis->GetDFileBuffer = Stb_GetDFileBuffer;
+	/// Meshes are rasterized when they are opened, the rows are taken from the z-buffer
+	if (!gui && !IsStdStream(sis->DFileName) && Mesh_ProbeFile(sis->DFileName)) {
+		sis->OpenDFile = Mesh_OpenDFile;
+		sis->ReadDBuffer = Mesh_ReadDBuffer;
+		sis->CloseDFile = Mesh_CloseDFile;
+		sis->GetDFileBuffer = Mesh_GetDFileBuffer;
+	/// Depth maps from a pipe are decoded by stb_image, they can't be mapped or streamed
+	} else if (!IsStdStream(sis->DFileName)) {
+		if (sis->cache_files && !Map_ProbeFile(sis->DFileName)) {
+			CacheFileName(sis->DFileName, "pgm", DCacheName);
+			if (CacheIsFresh(sis->DFileName, DCacheName)) {
+				dname = DCacheName;
+			}
+		}
+		/// Depth maps that are too large for stb_image (or all of them with
+		/// --stream) are decoded row by row while rendering
+		int stream = gui ? SIS_STREAM_NO : Stream_ProbeDFile(dname);
+		if (Map_ProbeFile(dname)) {
+			/// pgm, ppm and raw files (and cache files) are used in place
+			sis->OpenDFile = Map_OpenDFile;
+			sis->ReadDBuffer = Map_ReadDBuffer;
+			sis->CloseDFile = Map_CloseDFile;
+			sis->GetDFileBuffer = Map_GetDFileBuffer;
+		} else if (stream == SIS_STREAM_LARGE || (stream == SIS_STREAM_YES && sis->stream_output)) {
+			sis->OpenDFile = Stream_OpenDFile;
+			sis->ReadDBuffer = Stream_ReadDBuffer;
+			sis->CloseDFile = Stream_CloseDFile;
+			sis->GetDFileBuffer = Stream_GetDFileBuffer;
+		}
+	}
+	sis->OpenDFile(dname, &sis->Dwidth, &sis->Dheight);
+	if (DCacheName[0] && dname == sis->DFileName && sis->OpenDFile == Stb_OpenDFile) {
+		Stb_WriteDCache(DCacheName);
+	}
+	if (sis->depth_prep)
+		PrepDepthMap();
+}
+
+
+/// Choose the backend for the texture TFileName (or pattern) and open it
+void
+OpenTexture(void)
+{
+	if (sis->SIStype == SIS_TEXT_MAP && sis->texture_pattern) {
+		if (gui) {
+			fprintf(stderr, "procedural patterns can't be shown in the gui\n");
+			SISExit(EXIT_FAILURE);
+		}
+		/// Patterns are evaluated while rendering, they are always RGB
+		sis->OpenTFile = Pattern_OpenTFile;
+		sis->CloseTFile = Pattern_CloseTFile;
+		sis->ReadTPixel = Pattern_ReadTPixel;
+		sis->direct_rgb = true;
+		sis->OpenTFile(sis->TFileName, &sis->Twidth, &sis->Theight);
+	} else if (sis->SIStype == SIS_TEXT_MAP) {
+		if (!IsStdStream(sis->TFileName) && access(sis->TFileName, R_OK) == -1) {
+			/// TODO don't use stdio here but return error and string
+			fprintf(stderr, "failed to access texture image file '%s': %s\n",
+			  sis->TFileName, strerror(errno));
+			SISExit(EXIT_FAILURE);
+		}
+		sis->OpenTFile(sis->TFileName, &sis->Twidth, &sis->Theight);
+	}
+}
+
 
 void
 init_sis(void)
 {
-	if (access(DFileName, R_OK) == -1) {
+	if (!gui)
+		InitSequence();
+	if (IsStdStream(sis->SISFileName) && !gui)
+		redirect_stdout();
+	bool dstdin = IsStdStream(sis->DFileName);
+	if (dstdin && sis->SIStype == SIS_TEXT_MAP && IsStdStream(sis->TFileName)) {
+		fprintf(stderr, "depth map and texture can't both be read from the standard input\n");
+		SISExit(EXIT_FAILURE);
+	}
+	if (!dstdin && !sis->scene_shapes && access(sis->DFileName, R_OK) == -1) {
 		/// TODO don't use stdio here but return error and string
 		fprintf(stderr, "failed to access depthmap image file '%s': %s\n",
-		  DFileName, strerror(errno));
-		exit(EXIT_FAILURE);
+		  sis->DFileName, strerror(errno));
+		SISExit(EXIT_FAILURE);
 	}
-	OpenDFile(DFileName, &Dwidth, &Dheight);
-	if (SIStype == SIS_TEXT_MAP) {
-		if (access(TFileName, R_OK) == -1) {
-			/// TODO don't use stdio here but return error and string
-			fprintf(stderr, "failed to access texture image file '%s': %s\n",
-			  TFileName, strerror(errno));
-			exit(EXIT_FAILURE);
+	sis->ImgFileFormat = sis->output_format >= 0 ? sis->output_format : ImgFileFormatFromName(sis->SISFileName);
+	bool video = sis->ImgFileFormat == SIS_IMGFMT_Y4M && !gui;
+	if (!video && ImgFileFormatFromName(sis->DFileName) == SIS_IMGFMT_Y4M) {
+		fprintf(stderr, "y4m depth videos are rendered into y4m videos\n");
+		SISExit(EXIT_FAILURE);
+	}
+	if (video && sequence) {
+		fprintf(stderr, "depth map sequences are rendered into numbered image files\n");
+		SISExit(EXIT_FAILURE);
+	}
+	if (sis->depth_prep && (video || gui)) {
+		fprintf(stderr, "depth maps of videos and the gui aren't preprocessed (--depth-prep, --depth-filter)\n");
+		SISExit(EXIT_FAILURE);
+	}
+	if (sis->scene_shapes && (video || gui)) {
+		fprintf(stderr, "scenes (--shape) are rendered into single images\n");
+		SISExit(EXIT_FAILURE);
+	}
+	if (video) {
+		/// Depth videos are read frame by frame while rendering
+		sis->OpenDFile = Video_OpenDFile;
+		sis->ReadDBuffer = Video_ReadDBuffer;
+		sis->CloseDFile = Video_CloseDFile;
+		sis->GetDFileBuffer = Video_GetDFileBuffer;
+		sis->OpenDFile(sis->DFileName, &sis->Dwidth, &sis->Dheight);
+	} else if (sis->scene_shapes) {
+		/// The rows of scenes are computed while rendering
+		sis->OpenDFile = Scene_OpenDFile;
+		sis->ReadDBuffer = Scene_ReadDBuffer;
+		sis->CloseDFile = Scene_CloseDFile;
+		sis->GetDFileBuffer = Scene_GetDFileBuffer;
+		sis->OpenDFile(sis->DFileName, &sis->Dwidth, &sis->Dheight);
+		if (sis->depth_prep)
+			PrepDepthMap();
+	} else {
+		OpenDepthMap();
+	}
+	OpenTexture();
+	/// pbm files only have black and white dots, no interpolated colors
+	if (sis->ImgFileFormat == SIS_IMGFMT_PBM && !gui) {
+		if (!BilevelOutput()) {
+			fprintf(stderr, "pbm files need a black and white SIS (-d or -g 2)\n");
+			SISExit(1);
 		}
-		OpenTFile(TFileName, &Twidth, &Theight);
+		sis->indexed_output = true;
+	}
+	/// gif files take the palette of the SIS if it fits
+	if (sis->ImgFileFormat == SIS_IMGFMT_GIF && !gui && OutputColorCount() <= 256)
+		sis->indexed_output = true;
+	/// The gui shows the RGB colors of the output buffer
+	if (sis->indexed_output && (gui || OutputColorCount() > 256)) {
+		if (!gui)
+			fprintf(stderr, "SIS has more than 256 colors, writing RGB colors\n");
+		sis->indexed_output = false;
 	}
+	sis->SISPixelFormat = SIS_PIXFMT_RGB;
+	if (sis->indexed_output && (sis->ImgFileFormat == SIS_IMGFMT_PNG || sis->ImgFileFormat == SIS_IMGFMT_PBM
+	                       || sis->ImgFileFormat == SIS_IMGFMT_TIFF || sis->ImgFileFormat == SIS_IMGFMT_APNG))
+		sis->SISPixelFormat = BilevelOutput() ? SIS_PIXFMT_BILEVEL : SIS_PIXFMT_INDEXED;
+	if (sis->indexed_output && sis->ImgFileFormat == SIS_IMGFMT_GIF)
+		sis->SISPixelFormat = SIS_PIXFMT_INDEXED;
 	InitAlgorithm();
+	if (sis->indexed_output)
+		InitOutputPalette();
 	AllocBuffers();
-	CreateSISBuffer(SISwidth, SISheight, SIStype);
+	if ((sis->ImgFileFormat == SIS_IMGFMT_PPM || sis->ImgFileFormat == SIS_IMGFMT_RAW
+	     || sis->ImgFileFormat == SIS_IMGFMT_PBM) && !gui) {
+		/// ppm, pbm and raw output files are mapped and the rows written into them
+		sis->CreateSISBuffer = Map_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Map_WriteSISColorBuffer;
+		sis->WriteSISFile = Map_WriteSISFile;
+		sis->CloseSISFile = Map_CloseSISFile;
+		sis->GetSISFileBuffer = Map_GetSISFileBuffer;
+	} else if (sis->ImgFileFormat == SIS_IMGFMT_QOI && !gui) {
+		/// qoi costs nothing to stream
+		sis->CreateSISBuffer = Qoi_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Qoi_WriteSISColorBuffer;
+		sis->WriteSISFile = Qoi_WriteSISFile;
+		sis->CloseSISFile = Qoi_CloseSISFile;
+		sis->GetSISFileBuffer = Qoi_GetSISFileBuffer;
+	} else if (video) {
+		sis->CreateSISBuffer = Video_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Video_WriteSISColorBuffer;
+		sis->WriteSISFile = Video_WriteSISFile;
+		sis->CloseSISFile = Video_CloseSISFile;
+		sis->GetSISFileBuffer = Video_GetSISFileBuffer;
+	} else if ((sis->ImgFileFormat == SIS_IMGFMT_APNG || sis->ImgFileFormat == SIS_IMGFMT_GIF) && !gui) {
+		/// The frames of animations are written as they are rendered
+		sis->CreateSISBuffer = Anim_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Anim_WriteSISColorBuffer;
+		sis->WriteSISFile = Anim_WriteSISFile;
+		sis->CloseSISFile = Anim_CloseSISFile;
+		sis->GetSISFileBuffer = Anim_GetSISFileBuffer;
+	} else if (sis->ImgFileFormat == SIS_IMGFMT_TIFF && !gui) {
+		/// tiff strips are written as soon as they are full
+		sis->CreateSISBuffer = Tiff_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Tiff_WriteSISColorBuffer;
+		sis->WriteSISFile = Tiff_WriteSISFile;
+		sis->CloseSISFile = Tiff_CloseSISFile;
+		sis->GetSISFileBuffer = Tiff_GetSISFileBuffer;
+	} else if (sis->ImgFileFormat == SIS_IMGFMT_PNG && sis->stream_output && !gui) {
+		/// The gui needs the whole image in memory to show it
+		sis->CreateSISBuffer = Png_CreateSISBuffer;
+		sis->WriteSISColorBuffer = Png_WriteSISColorBuffer;
+		sis->WriteSISFile = Png_WriteSISFile;
+		sis->CloseSISFile = Png_CloseSISFile;
+		sis->GetSISFileBuffer = Png_GetSISFileBuffer;
+	}
+	sis->CreateSISBuffer(sis->SISwidth, sis->SISheight, sis->SIStype);
 }
 
 
@@ -175,15 +495,15 @@ init_all(int argc, char **argv)
 void
 finish_sis(void)
 {
-	CloseDFile();
-	if (SIStype == SIS_TEXT_MAP) {
-		CloseTFile(Theight);
+	sis->CloseDFile();
+	if (sis->SIStype == SIS_TEXT_MAP) {
+		sis->CloseTFile(sis->Theight);
 	}
-	CloseSISFile();
+	sis->CloseSISFile();
 	FreeBuffers();
-	free(SISred);
-	free(SISgreen);
-	free(SISblue);
+	free(sis->SISred);
+	free(sis->SISgreen);
+	free(sis->SISblue);
 }
 
 
@@ -194,31 +514,41 @@ finish_all(void)
 }
 
 
+/// Render row LineNumber of the SIS from the depth map row in DBuffer
+void
+render_line(ind_t LineNumber, sis_stats_t *stats)
+{
+	if (sis->algorithm < 4) {
+		sis->CalcIdentLine(stats);            /// My SIS-algorithm
+		InitSISBuffer(LineNumber);       /// Fill in the right color indices,
+		FillRGBBuffer(LineNumber);
+		                                 /// according to the SIS-type
+	} else {
+		InitSISBuffer(LineNumber);       /// Fill in the right color indices,
+		asteer(LineNumber);              /// Andrew Steer's SIS-algorithm
+	}
+}
+
+
 void
 render_sis(void)
 {
-	for (SISLineNumber = 0; SISLineNumber < SISheight; SISLineNumber++) {
-		DLineNumber = (int)DLinePosition;
-		DLinePosition += DLineStep;
+	/// Counter block of the (currently single) render worker
+	sis_stats_t worker_stats = {0};
+
+	for (sis->SISLineNumber = 0; sis->SISLineNumber < sis->SISheight; sis->SISLineNumber++) {
+		sis->DLineNumber = (ind_t)sis->DLinePosition;
+		sis->DLinePosition += sis->DLineStep;
 		max_depth_in_row = SIS_MIN_DEPTH;
 		min_depth_in_row = SIS_MAX_DEPTH;
 
-		ReadDBuffer(DLineNumber);            /// Read in one line of depth-map
-
-		if (algorithm < 4) {
-			CalcIdentLine();                 /// My SIS-algorithm
-			InitSISBuffer(SISLineNumber);    /// Fill in the right color indices,
-			FillRGBBuffer(SISLineNumber);
-			                                 /// according to the SIS-type
-		} else {
-			InitSISBuffer(SISLineNumber);    /// Fill in the right color indices,
-			asteer(SISLineNumber);           /// Andrew Steer's SIS-algorithm
-		}
+		sis->ReadDBuffer(sis->DLineNumber);            /// Read in one line of depth-map
+		render_line(sis->SISLineNumber, &worker_stats);
 		// WriteSISBuffer(SISLineNumber);    /// Write one line of output
-		WriteSISColorBuffer(SISLineNumber);  /// Write one line of output
-		if (verbose) {
-			show_statistics();
+		sis->WriteSISColorBuffer(sis->SISLineNumber);  /// Write one line of output
+		if (sis->verbose) {
+			show_statistics(&worker_stats);
 		}
 	}
+	MergeStats(&sis->render_stats, &worker_stats);
 }
-
@@ -28,22 +28,42 @@
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE 700
 #endif
+#include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <setjmp.h>
 
 #define SIS_RANDOM_GREY  1
 #define SIS_RANDOM_COLOR 2
 #define SIS_TEXT_MAP     3
 
-#define SIS_IMGFMT_DFLT  0
-// #define SIS_IMGFMT_TIFF  1
+/// Output file formats, chosen by the extension of the file name
+#define SIS_IMGFMT_PNG   0
+#define SIS_IMGFMT_QOI   1
+#define SIS_IMGFMT_BMP   2
+#define SIS_IMGFMT_TGA   3
+#define SIS_IMGFMT_JPEG  4
+#define SIS_IMGFMT_PPM   5
+#define SIS_IMGFMT_RAW   6
+#define SIS_IMGFMT_PBM   7
+#define SIS_IMGFMT_TIFF  8
+#define SIS_IMGFMT_Y4M   9     /// Video, the depth map is a y4m video too
+#define SIS_IMGFMT_APNG  10    /// Animation of a depth map sequence
+#define SIS_IMGFMT_GIF   11
+#define SIS_IMGFMT_DFLT  SIS_IMGFMT_PNG
 
 #define SIS_MAX_COLORS   0xffff    /// Max index in color palette
 #define SIS_MAX_CMAP     0xffff    /// Max value for color component (gray, r, g, b)
 #define SIS_MAX_DEPTH    0xffff    /// Max possible pixel value in the depth map image
 #define SIS_MIN_DEPTH    0x0       /// Min possible pixel value in the depth map image
 
+/// Fixed-point precision of the subpixel separations in algorithms 1-3
+#define SIS_SUBPIX_BITS  8
+#define SIS_SUBPIX_ONE   (1 << SIS_SUBPIX_BITS)
+#define SIS_SUBPIX_MASK  (SIS_SUBPIX_ONE - 1)
+
 #define SIS_MIN_ALGO     1
 #define SIS_MAX_ALGO     4
 
@@ -103,49 +123,277 @@ typedef struct {
 	int r, g, b;
 } col_rgb_t;
 
+/// With direct RGB textures, col_t holds the packed color 0x..bbggrr instead
+/// of an index into the color palette
+#define SIS_RGB_R(c)       ((int)((c) & 0xff))
+#define SIS_RGB_G(c)       ((int)(((c) >> 8) & 0xff))
+#define SIS_RGB_B(c)       ((int)(((c) >> 16) & 0xff))
+
+/// The row buffers of the render are per thread, so that several threads can
+/// render (e.g. the frames of a video) at the same time
+#if defined(NO_THREADING)
+#define SIS_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define SIS_THREAD_LOCAL __declspec(thread)
+#else
+#define SIS_THREAD_LOCAL __thread
+#endif
+
+#if defined(__GNUC__)
+#define SIS_NORETURN __attribute__((noreturn))
+#else
+#define SIS_NORETURN
+#endif
+
+/// Statistics counters of the row kernels. Each render worker counts into its
+/// own block, the blocks are merged into render_stats when the render is done.
+typedef struct {
+	long inner_propagate, outer_propagate;
+	long forwards_obscure, backwards_obscure;
+} sis_stats_t;
+
+/// Building with -DNO_STATS compiles the counters out of the row kernels
+#ifdef NO_STATS
+#define STAT_INC(stats, counter)
+#else
+#define STAT_INC(stats, counter)   ((stats)->counter++)
+#endif
+
+/*
+ * Renderer state:
+ */
+/// Preprocessing of the depth map (--depth-prep)
+typedef struct {
+	float sigma;              /// Gaussian blur, 0 for none
+	int box;                  /// Radius of the box blur, 0 for none
+	bool normalize;
+	float gamma;              /// 1 for none
+} prep_params_t;
+
+/// Procedural texture (--pattern)
+typedef struct {
+	int type;
+	float scale;              /// Size of the features in dots
+	int octaves;              /// Noise layers with halved size each
+	float angle;              /// Direction of the stripes in degrees
+	bool grey;
+	float cos_angle, sin_angle;
+	uint32_t seed;
+} pattern_params_t;
+
+/// Kernels that -v reports
+#define SIS_MAX_KERNELS  16
+
+struct sis_context;
+struct scene_shape;
+
+/// Everything the options set and a render reads and writes, except for the
+/// row buffers of the threads. sis renders with one state, each libsis
+/// context has its own, so that contexts can render at the same time. sis
+/// points to the state of the thread, ParallelFor() passes it on to the
+/// threads of its bands.
+typedef struct sis_state {
+	/// Files
+	char DFileName[PATH_MAX];
+	char TFileName[PATH_MAX];
+	char SISFileName[PATH_MAX];
+	char StatsFileName[PATH_MAX];
+	int ImgFileFormat;
+	/// Output file format given with --format, -1 if it's taken from the file name
+	int output_format;
+	/// Size of raw headerless input files
+	ind_t raw_width, raw_height;
+
+	/// Options
+	int SIStype, SIScompress, verbose, debug, algorithm;
+	ind_t eye_dist, origin;
+	bool invert;
+	bool mark;
+	int rand_grey_num, rand_col_num;
+	/// Seed of the random dots (-s)
+	unsigned int rand_seed;
+	/// Near and far plane
+	float t, u;
+	double density;
+	char metric;
+	int resolution;
+	/// Oversampling ratio
+	int oversam;
+	/// Texture colors are kept as packed RGB instead of palette indices
+	bool direct_rgb;
+	/// Rows are written to the output file while they are rendered
+	bool stream_output;
+	/// Render with palette colors only and write png files with the palette
+	bool indexed_output;
+	/// Pixel format of the output file
+	int SISPixelFormat;
+	/// png compression level (0-9) and filter type (0-4 or SIS_PNG_ADAPTIVE)
+	int png_level, png_filter;
+	/// Quality of jpeg files (1-100)
+	int jpeg_quality;
+	int tiff_compression;
+	/// Chroma subsampling of y4m videos
+	int y4m_chroma;
+	/// Frames per second of animated png and gif files
+	int anim_fps;
+	/// Decoded depth maps and textures are cached as pgm/ppm files next to them
+	bool cache_files;
+	/// Resample the texture at load by texture_scale, or to TexturePeriod()
+	/// columns with texture_fit (--texture-scale)
+	float texture_scale;
+	bool texture_fit;
+	/// Number of threads set with --threads, 0 means one per CPU core
+	int num_threads;
+	/// Highest instruction set level supported by the CPU, or forced with --cpu
+	int cpu_level;
+	/// Level forced on the command line, -1 means autodetect
+	int cpu_level_forced;
+	/// The texture is a procedural pattern (--pattern) instead of an image file
+	bool texture_pattern;
+	pattern_params_t pattern;
+	/// Depth maps are preprocessed when they are opened (--depth-prep)
+	bool depth_prep;
+	/// The --depth-prep argument, for messages
+	char depth_prep_spec[64];
+	/// Filter that resamples the depth map to the size of the SIS (--depth-filter),
+	/// -1 samples the nearest depth value of each dot while rendering
+	int depth_filter;
+	prep_params_t prep;
+	/// Camera of meshes (--camera), angles in degrees, fov 0 is orthographic
+	float camera_yaw, camera_pitch, camera_fov;
+	/// First frame number of a depth map sequence, -1 starts with 0 or 1
+	long first_frame;
+	/// Number of shapes given with --shape, the depth map is the scene of the
+	/// shapes instead of a file if there are any
+	int scene_shapes;
+	struct scene_shape *shapes;
+
+	/// Backends of the depth map, the texture and the SIS
+	void (*OpenDFile)(char *DFileName, ind_t * width, ind_t * height);
+	void (*CreateSISBuffer)(ind_t width, ind_t height, int SIStype);
+	void (*OpenTFile)(char *TFileName, ind_t * width, ind_t * height);
+	void (*CloseDFile)(void);
+	void (*CloseTFile)(ind_t height);
+	void (*CloseSISFile)(void);
+	void (*WriteSISFile)(void);
+	void (*ReadDBuffer)(ind_t r);
+	col_t(*ReadTPixel) (ind_t r, ind_t c);
+	col_t *(*ReadTRow) (ind_t r);
+	void (*WriteSISColorBuffer)(ind_t r);
+	unsigned char *(*GetDFileBuffer)(void);
+	unsigned char *(*GetTFileBuffer)(void);
+	unsigned char *(*GetSISFileBuffer)(void);
+
+	/// Sizes, colors and rows of the render
+	ind_t Dwidth, Dheight, SISwidth, SISheight, Twidth, Theight, Tcolcount;
+	cmap_t white_value, black_value;
+	/// Color palettes for depth and sis image colors (from texture or random dots)
+	cmap_t *SISred, *SISgreen, *SISblue;
+	col_t white, black;
+	z_t zvalue[SIS_MAX_COLORS + 1];
+	pos_t DLinePosition, DLineStep;
+	ind_t SISLineNumber;
+	ind_t DLineNumber;
+	ind_t halfstripwidth, halftriangwidth;
+
+	/// Algorithms (algorithm.c)
+	z_t max_depth, min_depth;
+	/// The depth map is read for preprocessing (dprep.c), its rows aren't registered
+	bool depth_capture;
+	/// Just for statistics, merged from the workers' counter blocks.
+	sis_stats_t render_stats;
+	/// Link pixels with subpixel precision in algorithms 1-3
+	bool subpixel;
+	/// Separation of each possible z, for algorithms 1-3 in fixed-point with
+	/// SIS_SUBPIX_BITS fractional bits. With 16-bit depth maps all entries can be
+	/// in use, 32 bits per entry keep the table small enough for the cache.
+	int32_t separation[SIS_MAX_COLORS + 1];
+	/// Ascend dz to check for hidden pixels
+	pos_t dz[SIS_MAX_COLORS + 1];
+	pos_t DBufStep;
+	/// Depth map column of each SIS column, with a resampled depth map (--depth-filter) the column itself
+	ind_t *DColumn;
+	/// Proportions of near and far-plane
+	int numerator, denominator;
+	/// Smallest and largest depth value for which zvalue and separation are set
+	col_t filled_lo, filled_hi;
+	/// Palette of indexed output files (--indexed), 8-bit RGB
+	unsigned char SISPalette[3 * 256];
+	int SISPaletteSize;
+	/// Palette colors of the SIS and the index of black in SISPalette
+	int index_count, index_black;
+
+	/// Row kernels, selected for the instruction set of the CPU
+	void (*CalcIdentLine)(sis_stats_t *stats);
+	void (*IngestDepthRow)(col_t *dst, const uint8_t *src, ind_t n, col_t *lo, col_t *hi);
+	void (*IngestDepthRow16)(col_t *dst, const uint16_t *src, ind_t n, col_t *lo, col_t *hi);
+	void (*FillTextureRow)(col_t *dst, const col_t *src, ind_t twidth, ind_t n);
+	void (*GatherPaletteRow)(col_rgb_t *dst, const col_t *src, ind_t n);
+	void (*AverageRow)(col_rgb_t *dst, const col_t *src, ind_t width, int factor);
+	/// Evaluate n texture colors of row y, starting at x0. x0 and n are in
+	/// units of 1/factor dots, the colors are packed RGB like direct_rgb textures
+	void (*PatternRow)(col_t *dst, ind_t x0, ind_t n, ind_t y, int factor);
+	/// Weighted sum of count rows of 16-bit depth values (dprep.c)
+	void (*BlurRow)(uint16_t *dst, const uint16_t *const *rows, const uint32_t *weights,
+	                int count, ind_t n);
+	/// Kernels and the variants that were selected, for printing with -v
+	const char *kernel_names[SIS_MAX_KERNELS];
+	int kernel_levels[SIS_MAX_KERNELS];
+	int kernel_count;
+
+	/// Texture (stbimg.c, map.c)
+	unsigned char *texpic_p;
+	/// Texture palette indices, rows are Tread_stride indices apart
+	col_t *Tread_buf;
+	void *Tread_mem;
+	ind_t Tread_stride;
+	/// Texture as packed RGB colors, used instead of Tread_buf with direct_rgb
+	col_t *Trgb_buf;
+	/// Trgb_buf was allocated and not decoded into by stb_image
+	bool Trgb_own;
+	/// texpic_p is a mapped ppm or raw file (or cache file)
+	bool texpic_mapped;
+	/// texpic_p is a texture resampled with --texture-scale
+	bool texpic_scaled;
+	/// Mapped texture file
+	const unsigned char *tmap;
+	size_t tmap_size;
+
+	/// Preprocessed depth map (dprep.c)
+	uint16_t *prep_depth;
+	/// Row that is captured by the ingest functions of dprep.c
+	ind_t prep_row;
+	/// Size of the depth map before it was resampled
+	ind_t depth_source_width, depth_source_height;
+
+	/// libsis context that renders with the state, NULL for sis
+	struct sis_context *context;
+} sis_state_t;
+
+extern SIS_THREAD_LOCAL sis_state_t *sis;
+sis_state_t *NewState(void);
+void FreeState(sis_state_t *state);
+
 /*
  * Interface to bitmap handlers (stbimg.c):
  */
 
-extern int ImgFileFormat;
+int ImgFileFormatFromName(const char *FileName);
+int ImgFileFormatFromExtension(const char *ext);
+/// File name "-" is the standard input (depth map or texture) or output (SIS)
+bool IsStdStream(const char *FileName);
+FILE *OpenOutputFile(const char *FileName);
+int CloseOutputFile(FILE *fp);
+extern FILE *sis_stdout;
 extern char depth_map_path[PATH_MAX];
 extern char texture_path[PATH_MAX];
-extern char DFileName[PATH_MAX];
-extern char TFileName[PATH_MAX];
-extern char SISFileName[PATH_MAX];
-extern int SIStype;
 /// Color palettes for depth and sis image colors (from texture or random dots)
-extern col_t *DBuffer;
-
-extern z_t zvalue[SIS_MAX_COLORS + 1];
-extern cmap_t *SISred;
-extern cmap_t *SISgreen;
-extern cmap_t *SISblue;
-extern col_rgb_t *SIScolorRGB;
-extern ind_t Dwidth, Dheight, SISwidth, SISheight, Twidth, Theight, Tcolcount;
-extern cmap_t white_value, black_value;
-
-extern void (*OpenDFile)(char *DFileName, ind_t * width, ind_t * height);
-extern void (*CreateSISBuffer)(ind_t width, ind_t height, int SIStype);
-extern void (*OpenTFile)(char *TFileName, ind_t * width, ind_t * height);
-extern void (*CloseDFile)(void);
-extern void (*CloseTFile)(ind_t height);
-extern void (*CloseSISFile)(void);
-extern void (*WriteSISFile)(void);
-extern void (*ReadDBuffer)(ind_t r);
-extern col_t(*ReadTPixel) (ind_t r, ind_t c);
-// void (*WriteSISBuffer)(ind_t r);
-extern void (*WriteSISColorBuffer)(ind_t r);
-extern unsigned char *(*GetDFileBuffer)(void);
-extern unsigned char *(*GetTFileBuffer)(void);
-extern unsigned char *(*GetSISFileBuffer)(void);
+extern SIS_THREAD_LOCAL col_t *DBuffer;
+extern SIS_THREAD_LOCAL col_rgb_t *SIScolorRGB;
 
 extern const char *DefaultDFileName;
 extern const char *DefaultSISFileName;
 extern const char *DefaultTFileName;
-extern pos_t DLinePosition, DLineStep;
-extern ind_t SISLineNumber;
-extern ind_t DLineNumber;
 
 void SetDefaults(void);
 void InitFuncs(void);
@@ -153,46 +401,184 @@ void InitFuncs(void);
 /*
  * Interface to get_opt.c:
  */
-extern ind_t eye_dist, origin;
-extern int verbose, debug, algorithm;
-extern bool invert;
-extern bool mark;
-extern int rand_grey_num, rand_col_num;
-extern float t, u;
-extern double density;
-extern char metric;
-extern int resolution;
-extern int oversam;
+/// Pixel formats of the output file
+#define SIS_PIXFMT_RGB      0   /// 8-bit RGB
+#define SIS_PIXFMT_INDEXED  1   /// 8-bit indices into SISPalette
+#define SIS_PIXFMT_BILEVEL  2   /// 1 bit per pixel, black and white
+/// png compression level (0-9) and filter type (0-4 or SIS_PNG_ADAPTIVE)
+#define SIS_PNG_ADAPTIVE -1
+/// Compression of tiff files, the values of the tiff compression tag
+#define SIS_TIFF_NONE     1
+#define SIS_TIFF_DEFLATE  8
+#define SIS_TIFF_PACKBITS 32773
+int tiff_compression_from_name(const char *name);
+int png_filter_from_name(const char *name);
+/// Chroma subsampling of y4m videos
+#define SIS_Y4M_MONO 0
+#define SIS_Y4M_420  1
+#define SIS_Y4M_444  2
 extern const bool gui;
 
+/// Errors end the process with SISExit(), unless a libsis call that renders
+/// in the thread has set sis_error_jump, then they return to it
+extern SIS_THREAD_LOCAL jmp_buf *sis_error_jump;
+SIS_NORETURN void SISExit(int status);
+
 void get_options(int argc, char **argv);
 void init_all(int argc, char **argv);
 void init_base(int argc, char **argv);
+void OpenDepthMap(void);
+void OpenTexture(void);
 void render_sis(void);
+void render_line(ind_t LineNumber, sis_stats_t *stats);
 void finish_all(void);
-void show_statistics(void);
+void show_statistics(const sis_stats_t *stats);
 ind_t metric2pixel(int metric_val, int resolution);
 
 /*
  * Interface to algorithm.c:
  */
-extern int algorithm;
-extern z_t min_depth_in_row, max_depth_in_row, min_depth, max_depth;
-extern col_t black, white;
-extern ind_t halfstripwidth, halftriangwidth;
-extern long forwards_obscure_c, backwards_obscure_c;
-extern long inner_propagate_c, outer_propagate_c;
-
-extern col_t(*ReadTPixel) (ind_t r, ind_t c);
-// extern void (*WriteSISBuffer)(ind_t r);
-extern void (*WriteSISColorBuffer)(ind_t r);
+extern SIS_THREAD_LOCAL z_t min_depth_in_row, max_depth_in_row;
+
+
+void InitKernels(void);
+void InitSISSize(void);
 void InitAlgorithm(void);
 void DaddEntry(col_t index, z_t zval);
+void DaddRange(col_t lo, col_t hi, int shift);
 void AllocBuffers(void);
 void FreeBuffers(void);
 void InitSISBuffer(ind_t LineNumber);
+void SetDotSeed(uint32_t *seed);
+int SISRand(void);
+size_t SISRowSize(void);
+void SaveSISRow(unsigned char *dst);
+void RestoreSISRow(const unsigned char *src);
 void FillRGBBuffer(ind_t LineNumber);
-void CalcIdentLine(void);
+void MergeStats(sis_stats_t *total, const sis_stats_t *worker);
 void asteer(ind_t LineNumber);
+ind_t TexturePeriod(void);
+int OutputColorCount(void);
+void InitOutputPalette(void);
+void GatherIndexRow(unsigned char *dst, ind_t LineNumber);
+bool BilevelOutput(void);
+void GatherBitRow(unsigned char *dst, ind_t LineNumber, int black_bit);
+
+/*
+ * Interface to cpu.c:
+ */
+#define SIS_CPU_GENERIC  0
+#define SIS_CPU_SSE2     1
+#define SIS_CPU_AVX2     2
+#define SIS_CPU_AVX512   3
+#define SIS_CPU_NEON     4
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(NO_DISPATCH)
+#define SIS_DISPATCH_X86
+#elif defined(__GNUC__) && !defined(__clang__) && defined(__arm__) && defined(__linux__) \
+    && !defined(NO_DISPATCH)
+#define SIS_DISPATCH_ARM
+#endif
+
+/// The body of a row kernel is inlined into each of its variants
+#if defined(__GNUC__) || defined(__clang__)
+#define SIS_KERNEL_BODY  static inline __attribute__((always_inline))
+#else
+#define SIS_KERNEL_BODY  static inline
+#endif
+/// -O2 doesn't vectorize loops with an unknown trip count, but the variants should
+#if defined(__GNUC__) && !defined(__clang__)
+#define SIS_VECTORIZE    optimize("tree-vectorize", "vect-cost-model=dynamic"),
+#else
+#define SIS_VECTORIZE
+#endif
+
+/// Define the variants name_generic(), name_sse2(), ... of the row kernel
+/// name_body(). SIS_KERNEL_SELECT() points ptr to the best variant for the CPU.
+#if defined(SIS_DISPATCH_X86)
+#define SIS_KERNEL_VARIANTS(name, params, args) \
+	static void name##_generic params { name##_body args; } \
+	__attribute__((SIS_VECTORIZE target("sse2"))) \
+	static void name##_sse2 params { name##_body args; } \
+	__attribute__((SIS_VECTORIZE target("avx2"))) \
+	static void name##_avx2 params { name##_body args; } \
+	__attribute__((SIS_VECTORIZE target("avx512f,avx512bw"))) \
+	static void name##_avx512 params { name##_body args; }
+#define SIS_KERNEL_SELECT(ptr, name, label) do { \
+	int level_ = sis->cpu_level >= SIS_CPU_AVX512 ? SIS_CPU_AVX512 : sis->cpu_level; \
+	ptr = level_ == SIS_CPU_AVX512 ? name##_avx512 : level_ == SIS_CPU_AVX2 ? name##_avx2 \
+	    : level_ == SIS_CPU_SSE2 ? name##_sse2 : name##_generic; \
+	ReportKernel(label, level_); \
+} while (0)
+#elif defined(SIS_DISPATCH_ARM)
+#define SIS_KERNEL_VARIANTS(name, params, args) \
+	static void name##_generic params { name##_body args; } \
+	__attribute__((SIS_VECTORIZE target("fpu=neon"))) \
+	static void name##_neon params { name##_body args; }
+#define SIS_KERNEL_SELECT(ptr, name, label) do { \
+	ptr = sis->cpu_level == SIS_CPU_NEON ? name##_neon : name##_generic; \
+	ReportKernel(label, sis->cpu_level); \
+} while (0)
+#else
+/// Only one variant, which uses the baseline instruction set of the target (e.g. NEON on aarch64)
+#define SIS_KERNEL_VARIANTS(name, params, args) \
+	static void name##_generic params { name##_body args; }
+#define SIS_KERNEL_SELECT(ptr, name, label) do { \
+	ptr = name##_generic; \
+	ReportKernel(label, sis->cpu_level); \
+} while (0)
+#endif
+
+
+void InitCPU(void);
+const char *cpu_level_name(int level);
+int cpu_level_from_name(const char *name);
+void ReportKernel(const char *name, int level);
+void PrintKernels(void);
+
+/*
+ * Interface to deflate.c:
+ */
+typedef struct {
+	unsigned char *data;       /// Compressed bytes, reset len after writing them out
+	size_t len, cap;
+	uint32_t bits;             /// Pending bits, least significant first
+	int bit_count;
+	int level;                 /// 0 (stored) to 9 (best)
+	int32_t *head, *prev;      /// Hash chains of the LZ77 matcher
+} deflate_t;
+
+void DeflateInit(deflate_t *d, int level);
+void DeflateBand(deflate_t *d, const unsigned char *src, size_t n);
+void DeflateFinish(deflate_t *d);
+void DeflateFree(deflate_t *d);
+void ZlibHeader(int level, unsigned char *header);
+uint32_t Adler32(uint32_t adler, const unsigned char *src, size_t n);
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2);
+uint32_t Crc32(uint32_t crc, const unsigned char *src, size_t n);
+
+/*
+ * Interface to inflate.c:
+ */
+/// Read up to n compressed bytes into buf, returns 0 at the end of the data
+typedef size_t (*inflate_read_fn)(void *ctx, unsigned char *buf, size_t n);
+typedef struct inflate_s inflate_t;
+
+inflate_t *InflateNew(inflate_read_fn read, void *ctx);
+size_t Inflate(inflate_t *s, unsigned char *dst, size_t n);
+bool InflateError(const inflate_t *s);
+void InflateFree(inflate_t *s);
+
+/*
+ * Interface to parallel.c:
+ */
+/// Work on the items [begin, end) of band number band
+typedef void (*parallel_fn)(void *arg, int band, ind_t begin, ind_t end);
+
+
+int ThreadCount(void);
+int ParallelBands(ind_t n, ind_t min_band);
+void ParallelFor(ind_t n, int bands, parallel_fn fn, void *arg);
 
 #endif     /// SIS_INCLUDED
@@ -22,38 +22,326 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "3rd-party/stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "3rd-party/stb_image_write.h"
-#define STB_DS_IMPLEMENTATION
-#include "3rd-party/stb_ds.h"
 
 #include "sis.h"
 #include "stbimg.h"
-
-static unsigned char *inpic_p, *outpic_buf_p, *texpic_p;
+#include "map.h"
+#include "png.h"
+#include "qoi.h"
+#include "tiff.h"
+#include "gif.h"
+#include "resample.h"
+
+static unsigned char *inpic_p, *outpic_buf_p;
+/// Depth maps with more than 8 bits per pixel (16-bit png/pgm, pfm)
+static uint16_t *inpic16_p;
+static bool inpic16_from_pfm;
 static ind_t outpic_width = 0, outpic_height = 0;
-static col_t **Tread_buf;
+/// Bytes of a row of the output buffer in the pixel format SISPixelFormat
+static size_t outpic_row_bytes;
 /* static ind_t cur_Dread=-1, */
-static ind_t cur_Tread = -1;
+static SIS_THREAD_LOCAL ind_t cur_Tread = -1;
 static const int SISChannelCount = 3;
 
 
+/// The standard input, read once. Images from a pipe are probed before they
+/// are decoded (and textures may be decoded twice), a pipe can't be rewound.
+static unsigned char *stdin_buf;
+static size_t stdin_size;
+
+
+/// Read a whole stream into a malloc'd buffer, returns NULL on failure
+static unsigned char *
+read_stream(FILE *fp, size_t *size)
+{
+	size_t cap = 1 << 16, n;
+	unsigned char *buf = (unsigned char *)malloc(cap);
+
+	*size = 0;
+	if (!buf)
+		return NULL;
+	while ((n = fread(buf + *size, 1, cap - *size, fp)) > 0) {
+		*size += n;
+		if (*size == cap) {
+			unsigned char *p = (unsigned char *)realloc(buf, cap * 2);
+			if (!p) {
+				free(buf);
+				return NULL;
+			}
+			buf = p;
+			cap *= 2;
+		}
+	}
+	if (ferror(fp)) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+
+static void
+read_stdin(void)
+{
+	if (stdin_buf)
+		return;
+	/// stb_image takes the length of a buffer as an int
+	if (!(stdin_buf = read_stream(stdin, &stdin_size))
+	    || stdin_size == 0 || stdin_size > INT_MAX) {
+		fprintf(stderr, "Failed to read an image from the standard input.\n");
+		SISExit(1);
+	}
+}
+
+
+static void
+free_stdin(void)
+{
+	free(stdin_buf);
+	stdin_buf = NULL;
+	stdin_size = 0;
+}
+
+
+/// Load an image file, "-" is the standard input
+static unsigned char *
+load_image(const char *FileName, int *width, int *height, int *channels, int desired)
+{
+	if (IsStdStream(FileName)) {
+		read_stdin();
+		return stbi_load_from_memory(stdin_buf, (int)stdin_size,
+		                             width, height, channels, desired);
+	}
+	return stbi_load(FileName, width, height, channels, desired);
+}
+
+
+static uint16_t *
+load_image_16(const char *FileName, int *width, int *height, int *channels, int desired)
+{
+	if (IsStdStream(FileName)) {
+		read_stdin();
+		return stbi_load_16_from_memory(stdin_buf, (int)stdin_size,
+		                                width, height, channels, desired);
+	}
+	return stbi_load_16(FileName, width, height, channels, desired);
+}
+
+
+static bool
+is_16_bit(const char *FileName)
+{
+	if (IsStdStream(FileName)) {
+		read_stdin();
+		return stbi_is_16_bit_from_memory(stdin_buf, (int)stdin_size);
+	}
+	return stbi_is_16_bit(FileName);
+}
+
+
+/// Load a portable float map (pfm) and map its values to 16-bit depth values.
+/// Values in [0, 1] are taken as they are, otherwise the range of the values
+/// in the image is stretched to [0, SIS_MAX_DEPTH].
+static uint16_t *
+load_pfm(const char *FileName, int *width, int *height)
+{
+	FILE *fp;
+	char type[3] = {0}, header[64];
+	float scale;
+	int channels, header_len;
+	unsigned char *data;
+	size_t size, pos;
+	uint16_t *depth = NULL;
+	float *pic = NULL;
+
+	if (IsStdStream(FileName)) {
+		read_stdin();
+		data = stdin_buf;
+		size = stdin_size;
+	} else {
+		if (!(fp = fopen(FileName, "rb")))
+			return NULL;
+		data = read_stream(fp, &size);
+		fclose(fp);
+		if (!data)
+			return NULL;
+	}
+	pos = size < sizeof(header) - 1 ? size : sizeof(header) - 1;
+	memcpy(header, data, pos);
+	header[pos] = '\0';
+	/// The header ends with a single whitespace character
+	if (sscanf(header, "%2s %d %d %f%n", type, width, height, &scale, &header_len) != 4
+	    || (size_t)header_len >= pos || *width <= 0 || *height <= 0) {
+		goto fail;
+	}
+	pos = header_len + 1;
+	channels = (type[1] == 'F') ? 3 : 1;
+	size_t pixel_count = (size_t)*width * *height;
+	size_t row_bytes = (size_t)*width * channels * sizeof(float);
+	if ((size - pos) / row_bytes < (size_t)*height)
+		goto fail;
+	if (!(pic = (float *)malloc(pixel_count * sizeof(float)))
+	    || !(depth = (uint16_t *)malloc(pixel_count * sizeof(uint16_t)))) {
+		goto fail;
+	}
+	/// A negative scale means little endian
+	uint16_t probe = 1;
+	bool swap = (*(uint8_t *)&probe == 1) != (scale < 0);
+	float min = INFINITY, max = -INFINITY;
+	/// Rows are stored from bottom to top
+	for (int r = *height - 1; r >= 0; r--, pos += row_bytes) {
+		for (int c = 0; c < *width; c++) {
+			float v = 0.0f;
+			for (int i = 0; i < channels; i++) {
+				float f;
+				memcpy(&f, data + pos + ((size_t)c * channels + i) * sizeof(float), sizeof(f));
+				if (swap) {
+					uint32_t u;
+					memcpy(&u, &f, sizeof(u));
+					u = (u >> 24) | ((u >> 8) & 0xff00) | ((u << 8) & 0xff0000) | (u << 24);
+					memcpy(&f, &u, sizeof(u));
+				}
+				v += f;
+			}
+			v /= channels;
+			if (!isfinite(v))
+				v = 0.0f;
+			pic[(size_t)r * *width + c] = v;
+			if (v < min)
+				min = v;
+			if (v > max)
+				max = v;
+		}
+	}
+	if (min >= 0.0f && max <= 1.0f) {
+		min = 0.0f;
+		max = 1.0f;
+	} else if (max <= min) {
+		max = min + 1.0f;
+	}
+	for (size_t i = 0; i < pixel_count; i++) {
+		depth[i] = (uint16_t)((pic[i] - min) / (max - min) * SIS_MAX_DEPTH + 0.5f);
+	}
+	free(pic);
+	if (data != stdin_buf)
+		free(data);
+	return depth;
+fail:
+	free(pic);
+	free(depth);
+	if (data != stdin_buf)
+		free(data);
+	return NULL;
+}
+
+
+/// Check the magic number of a netpbm file, e.g. "fF" for pfm files
+static bool
+has_pnm_magic(const char *FileName, const char *types)
+{
+	unsigned char magic[2] = {0};
+	size_t n;
+	if (IsStdStream(FileName)) {
+		read_stdin();
+		n = stdin_size < 2 ? stdin_size : 2;
+		memcpy(magic, stdin_buf, n);
+	} else {
+		FILE *fp = fopen(FileName, "rb");
+		if (!fp)
+			return false;
+		n = fread(magic, 1, 2, fp);
+		fclose(fp);
+	}
+	return n == 2 && magic[0] == 'P' && magic[1] && strchr(types, magic[1]);
+}
+
+
+static bool
+is_pfm(const char *FileName)
+{
+	return has_pnm_magic(FileName, "fF");
+}
+
+
+static bool
+is_pnm(const char *FileName)
+{
+	return has_pnm_magic(FileName, "56");
+}
+
+
 void
 Stb_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
 {
 	stbi_set_unpremultiply_on_load(1);
 	stbi_convert_iphone_png_to_rgb(1);
 	int channel_count = 0, desired_channel_count = 1;
-	if (! (inpic_p = (unsigned char *)stbi_load(DFileName, (int *)width, (int *)height,
+	int w = 0, h = 0;
+	inpic_p = NULL;
+	inpic16_p = NULL;
+	inpic16_from_pfm = false;
+	if (is_pfm(DFileName)) {
+		if (!(inpic16_p = load_pfm(DFileName, &w, &h))) {
+			fprintf(stderr, "Failed to load %s: invalid pfm file\n", DFileName);
+			SISExit(1);
+		}
+		inpic16_from_pfm = true;
+	} else if (is_16_bit(DFileName)) {
+		/// stb_image v2.27 returns the big-endian samples of 16-bit pnm files
+		/// unswapped, they are swapped before they are converted to grey
+		uint16_t probe = 1;
+		bool swap = is_pnm(DFileName) && *(uint8_t *)&probe == 1;
+		/// Keep the full precision of 16-bit png and pgm depth maps
+		if (!(inpic16_p = load_image_16(DFileName, &w, &h, &channel_count,
+		                               swap ? 0 : desired_channel_count))) {
+			fprintf(stderr, "Failed to load %s: %s\n", DFileName, stbi_failure_reason());
+			SISExit(1);
+		}
+		if (swap) {
+			size_t pixel_count = (size_t)w * h;
+			for (size_t i = 0; i < pixel_count * channel_count; i++)
+				inpic16_p[i] = (uint16_t)(inpic16_p[i] << 8 | inpic16_p[i] >> 8);
+			/// Grey like stb_image converts it, in place
+			if (channel_count == 3) {
+				for (size_t i = 0; i < pixel_count; i++) {
+					const uint16_t *rgb = inpic16_p + 3 * i;
+					inpic16_p[i] = (uint16_t)((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+				}
+			}
+		}
+	} else if (! (inpic_p = load_image(DFileName, &w, &h,
 	                                &channel_count, desired_channel_count))) {
 	    fprintf(stderr, "Failed to load %s: %s\n", DFileName, stbi_failure_reason());
-		exit(1);
+		SISExit(1);
 	}
-	black_value = 0;
-	white_value = SIS_MAX_CMAP;
+	/// The decoded depth map is all that is needed from the standard input
+	free_stdin();
+	*width = w;
+	*height = h;
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+/// Write the decoded depth map as pgm file, which can be mapped by later renders
+void
+Stb_WriteDCache(const char *CacheName)
+{
+	bool ok;
+	if (inpic16_p)
+		ok = WriteCacheFile(CacheName, inpic16_p, sis->Dwidth, sis->Dheight, 1, 2, 2);
+	else
+		ok = WriteCacheFile(CacheName, inpic_p, sis->Dwidth, sis->Dheight, 1, 1, 1);
+	if (!ok)
+		fprintf(stderr, "Failed to write cache file %s\n", CacheName);
 }
 
 
@@ -62,73 +350,418 @@ Stb_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
 {
 	outpic_width = width;
 	outpic_height = height;
+	outpic_row_bytes = sis->SISPixelFormat == SIS_PIXFMT_BILEVEL ? (width + 7) / 8
+	                 : sis->SISPixelFormat == SIS_PIXFMT_INDEXED ? width : width * SISChannelCount;
 	// Allocate buffer for the output image data that can be directly written with stb_image_write()
-	if (! (outpic_buf_p = (unsigned char *)calloc(height * width, SISChannelCount))) {
+	if (! (outpic_buf_p = (unsigned char *)calloc(height, outpic_row_bytes))) {
 		fprintf(stderr, "Failed to allocate output image buffer.\n");
-		exit(1);
+		SISExit(1);
 	}
 }
 
 
-void
-Stb_OpenTFile(char *TFileName, ind_t *width, ind_t *height)
+/// Resampled textures are cached by their scale, or by their width with
+/// --texture-scale fit
+static void
+texture_cache_name(const char *TFileName, char *CacheName)
 {
-	int channel_count = 0, desired_channel_count = 3;
-	if (!(texpic_p = (unsigned char *)stbi_load(TFileName, (int *)width, (int *)height,
-	                                &channel_count, desired_channel_count))) {
-	    fprintf(stderr, "Failed to load %s: %s\n", TFileName, stbi_failure_reason());
-		exit(1);
+	char ext[32] = "ppm";
+	if (sis->texture_fit)
+		snprintf(ext, sizeof(ext), "w%ld.ppm", TexturePeriod());
+	else if (sis->texture_scale != 0.0f)
+		snprintf(ext, sizeof(ext), "x%g.ppm", sis->texture_scale);
+	CacheFileName(TFileName, ext, CacheName);
+}
+
+
+/// Map the texture if it's a ppm or raw file or has a fresh cache file.
+/// Otherwise CacheName is set to the cache file that should be written after
+/// decoding, or emptied if there is none.
+static const unsigned char *
+map_texture(char *TFileName, ind_t *width, ind_t *height, char *CacheName)
+{
+	const unsigned char *pix;
+	CacheName[0] = 0;
+	if (IsStdStream(TFileName))
+		return NULL;
+	/// Resampled textures are never used in place
+	if (sis->texture_scale == 0.0f && Map_ProbeFile(TFileName))
+		return Map_OpenTexture(TFileName, width, height);
+	if (!sis->cache_files)
+		return NULL;
+	texture_cache_name(TFileName, CacheName);
+	if (CacheIsFresh(TFileName, CacheName)
+	    && (pix = Map_OpenTexture(CacheName, width, height))) {
+		CacheName[0] = 0;
+		return pix;
+	}
+	return NULL;
+}
+
+
+static void
+write_texture_cache(const char *CacheName, ind_t width, ind_t height, int step)
+{
+	if (CacheName[0] && !WriteCacheFile(CacheName, sis->texpic_p, width, height, 3, 1, step))
+		fprintf(stderr, "Failed to write cache file %s\n", CacheName);
+}
+
+
+static void
+free_texture_pixels(void)
+{
+	if (sis->texpic_mapped)
+		Map_CloseTexture();
+	else if (sis->texpic_scaled)
+		free(sis->texpic_p);
+	else
+		stbi_image_free(sis->texpic_p);
+	sis->texpic_p = NULL;
+	sis->texpic_mapped = false;
+	sis->texpic_scaled = false;
+}
+
+
+/// Decode (or map) the texture and resample it once as --texture-scale
+/// says, texpic_p is then the RGB texture at its new size. With fit it's one
+/// period of the SIS wide and tiles without seams.
+static void
+open_scaled_texture(char *TFileName, ind_t *width, ind_t *height)
+{
+	const unsigned char *src = NULL;
+	unsigned char *decoded = NULL;
+	ind_t w = 0, h = 0;
+	if (!IsStdStream(TFileName) && Map_ProbeFile(TFileName))
+		src = Map_OpenTexture(TFileName, &w, &h);
+	if (!src) {
+		int channel_count = 0, iw = 0, ih = 0;
+		if (!(decoded = load_image(TFileName, &iw, &ih, &channel_count, 3))) {
+			fprintf(stderr, "Failed to load %s: %s\n", TFileName, stbi_failure_reason());
+			SISExit(1);
+		}
+		if (channel_count != 3) {
+			fprintf(stderr,
+			        "Input texture map image must have three color channels\n");
+			SISExit(1);
+		}
+		src = decoded;
+		w = iw;
+		h = ih;
+	}
+	*width = sis->texture_fit ? TexturePeriod() : (ind_t)lroundf(w * sis->texture_scale);
+	if (*width < 1)
+		*width = 1;
+	*height = (ind_t)llround((double)h * *width / w);
+	if (*height < 1)
+		*height = 1;
+	if (!(sis->texpic_p = (unsigned char *)malloc((size_t)*width * *height * 3))) {
+		fprintf(stderr, "Failed to allocate texture readbuf.\n");
+		SISExit(1);
+	}
+	/// Textures are tiled, so the filter wraps around their edges
+	ResampleImage8(src, w, h, sis->texpic_p, *width, *height, 3, SIS_FILTER_BILINEAR, true);
+	sis->texpic_scaled = true;
+	if (decoded)
+		stbi_image_free(decoded);
+	else
+		Map_CloseTexture();
+}
+
+
+/// Decode the texture as packed RGB, the rows are read directly from the
+/// decoded image and no color palette is needed.
+static void
+open_rgb_texture(char *TFileName, ind_t *width, ind_t *height)
+{
+	int channel_count = 0;
+	int w = 0, h = 0;
+	char CacheName[PATH_MAX];
+	const unsigned char *pix = map_texture(TFileName, width, height, CacheName);
+	/// The number of unique colors isn't counted
+	sis->Tcolcount = 0;
+	if (pix) {
+		sis->texpic_p = (unsigned char *)pix;
+		sis->texpic_mapped = true;
+	} else if (sis->texture_scale != 0.0f) {
+		open_scaled_texture(TFileName, width, height);
+		write_texture_cache(CacheName, *width, *height, 3);
+		pix = sis->texpic_p;
+	}
+	if (pix) {
+		size_t n = (size_t)*width * *height;
+		if (!(sis->Trgb_buf = (col_t *)malloc(n * sizeof(col_t)))) {
+			fprintf(stderr, "Failed to allocate texture readbuf.\n");
+			SISExit(1);
+		}
+		sis->Trgb_own = true;
+		for (size_t i = 0; i < n; i++)
+			sis->Trgb_buf[i] = (col_t)pix[3 * i] | (col_t)pix[3 * i + 1] << 8 | (col_t)pix[3 * i + 2] << 16;
+		return;
+	}
+	/// Four channels per pixel give one col_t per pixel, the alpha byte is ignored
+	if (!(sis->texpic_p = load_image(TFileName, &w, &h, &channel_count, 4))) {
+		fprintf(stderr, "Failed to load %s: %s\n", TFileName, stbi_failure_reason());
+		SISExit(1);
 	}
-	if (channel_count != desired_channel_count) {
+	*width = w;
+	*height = h;
+	if (channel_count != 3) {
 		fprintf(stderr,
 		        "Input texture map image must have three color channels\n");
-		/// TODO: check if we can continue if channel count is not equal
-		///       to the desired channel count
-		exit(1);
-	}
-	/// Copy the interleaved color values and populate the texture image
-	/// planes SISred, SISgreen, SISblue and the image color index buffer
-	/// Tread_buf by creating a color map from the interleaved stb_image data.
-	struct {
-		uint32_t key;
-		col_t value;
-	} *colmap = NULL;
-	const col_t default_value = -1;
-	hmdefault(colmap, default_value);
-	col_t col_idx = 0;
-	if (!(Tread_buf = (col_t **) calloc(*height, sizeof(col_t *)))) {
+		SISExit(1);
+	}
+	write_texture_cache(CacheName, w, h, 4);
+	sis->Trgb_buf = (col_t *)sis->texpic_p;
+	uint16_t probe = 1;
+	if (*(uint8_t *)&probe != 1) {
+		/// Bytes r, g, b, a are read as 0xrrggbbaa on big-endian hosts
+		for (size_t i = 0; i < (size_t)w * h; i++) {
+			col_t c = sis->Trgb_buf[i];
+			sis->Trgb_buf[i] = c >> 24 | (c >> 8 & 0xff00) | (c << 8 & 0xff0000);
+		}
+	}
+}
+
+
+static void
+free_palette_texture(void)
+{
+	free(sis->Tread_mem);
+	sis->Tread_mem = NULL;
+	sis->Tread_buf = NULL;
+}
+
+
+/// Open addressing hash table of packed 24-bit colors
+typedef struct {
+	uint32_t *keys;     /// color + 1, 0 marks an empty slot
+	col_t *values;
+	int bits;
+} coltab_t;
+
+typedef struct {
+	coltab_t tab;
+	uint32_t *colors;   /// colors of the band in order of their first occurrence
+	col_t count;
+	col_t *remap;       /// band color index to palette index
+	bool overflow;
+} tband_t;
+
+typedef struct {
+	const unsigned char *pic;
+	ind_t width;
+	tband_t *bands;
+} tindex_t;
+
+
+static void
+coltab_init(coltab_t *tab, size_t max_entries)
+{
+	/// Keep the load factor below 1/2
+	tab->bits = 6;
+	while (((size_t)1 << tab->bits) < 2 * max_entries)
+		tab->bits++;
+	tab->keys = (uint32_t *)calloc((size_t)1 << tab->bits, sizeof(uint32_t));
+	tab->values = (col_t *)malloc(((size_t)1 << tab->bits) * sizeof(col_t));
+	if (!tab->keys || !tab->values) {
+		fprintf(stderr, "Failed to allocate texture color table.\n");
+		SISExit(1);
+	}
+}
+
+
+static void
+coltab_free(coltab_t *tab)
+{
+	free(tab->keys);
+	free(tab->values);
+}
+
+
+/// Return the slot of color rgb, which is either empty or holds rgb
+static size_t
+coltab_slot(const coltab_t *tab, uint32_t rgb)
+{
+	size_t mask = ((size_t)1 << tab->bits) - 1;
+	size_t i = (uint32_t)(rgb * 2654435761u) >> (32 - tab->bits);
+	while (tab->keys[i] && tab->keys[i] != rgb + 1)
+		i = (i + 1) & mask;
+	return i;
+}
+
+
+/// Index the colors of the texture rows [begin, end) with a color table of
+/// the band, Tread_buf gets the band color indices
+static void
+index_texture_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	tindex_t *ti = (tindex_t *)arg;
+	tband_t *tb = &ti->bands[band];
+	size_t pixels = (size_t)(end - begin) * ti->width;
+	coltab_init(&tb->tab, pixels < SIS_MAX_COLORS ? pixels : SIS_MAX_COLORS);
+	if (!(tb->colors = (uint32_t *)malloc(SIS_MAX_COLORS * sizeof(uint32_t)))) {
+		fprintf(stderr, "Failed to allocate texture color table.\n");
+		SISExit(1);
+	}
+	uint32_t last_rgb = 0xffffffff;
+	col_t last_idx = 0;
+	for (ind_t r = begin; r < end; ++r) {
+		const unsigned char *p = ti->pic + (size_t)r * ti->width * 3;
+		col_t *dst = sis->Tread_buf + r * sis->Tread_stride;
+		for (ind_t c = 0; c < ti->width; ++c, p += 3) {
+			uint32_t rgb = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+			/// Neighbouring pixels often have the same color
+			if (rgb != last_rgb) {
+				size_t i = coltab_slot(&tb->tab, rgb);
+				if (!tb->tab.keys[i]) {
+					if (tb->count == SIS_MAX_COLORS) {
+						tb->overflow = true;
+						return;
+					}
+					tb->tab.keys[i] = rgb + 1;
+					tb->tab.values[i] = tb->count;
+					tb->colors[tb->count++] = rgb;
+				}
+				last_rgb = rgb;
+				last_idx = tb->tab.values[i];
+			}
+			dst[c] = last_idx;
+		}
+	}
+}
+
+
+static void
+remap_texture_band(void *arg, int band, ind_t begin, ind_t end)
+{
+	tindex_t *ti = (tindex_t *)arg;
+	const col_t *remap = ti->bands[band].remap;
+	/// The colors of the first band are the first palette entries
+	if (band == 0)
+		return;
+	for (ind_t r = begin; r < end; ++r) {
+		col_t *row = sis->Tread_buf + r * sis->Tread_stride;
+		for (ind_t c = 0; c < ti->width; ++c)
+			row[c] = remap[row[c]];
+	}
+}
+
+
+/// Build the color palette SISred, SISgreen, SISblue and the palette index
+/// buffer Tread_buf from the interleaved stb_image data. The rows are indexed
+/// in parallel bands, the band colors are merged in band order, so the palette
+/// index of a color is the order of its first occurrence in the texture.
+/// Returns the number of colors or -1 if there are too many for the palette.
+static ind_t
+index_texture(const unsigned char *pic, ind_t width, ind_t height)
+{
+	/// Rows of texture indices start at cache line boundaries
+	const ind_t align = 64;
+	sis->Tread_stride = (width + align / sizeof(col_t) - 1) & ~(ind_t)(align / sizeof(col_t) - 1);
+	if (!(sis->Tread_mem = malloc(height * sis->Tread_stride * sizeof(col_t) + align))) {
 		fprintf(stderr, "Failed to allocate texture readbuf.\n");
-		exit(1);
+		SISExit(1);
 	}
-	for (ind_t r = 0; r < *height; ++r) {
-		if (!(Tread_buf[r] = (col_t *) calloc(*width, sizeof(col_t)))) {
-			fprintf(stderr, "Failed to allocate texture readbuf.\n");
-			exit(1);
+	sis->Tread_buf = (col_t *)(((uintptr_t)sis->Tread_mem + align - 1) & ~(uintptr_t)(align - 1));
+
+	int bands = ParallelBands(height, 1 + 0xffff / (width ? width : 1));
+	tindex_t ti = { pic, width, (tband_t *)calloc(bands, sizeof(tband_t)) };
+	if (!ti.bands) {
+		fprintf(stderr, "Failed to allocate texture color table.\n");
+		SISExit(1);
+	}
+	ParallelFor(height, bands, index_texture_band, &ti);
+
+	coltab_t palette;
+	col_t col_idx = 0;
+	bool overflow = false;
+	coltab_init(&palette, SIS_MAX_COLORS);
+	for (int b = 0; b < bands && !overflow; b++) {
+		tband_t *tb = &ti.bands[b];
+		if (tb->overflow || !(tb->remap = (col_t *)malloc((tb->count + 1) * sizeof(col_t)))) {
+			overflow = true;
+			break;
 		}
-		for (ind_t c = 0; c < *width; ++c) {
-			ind_t row_pos = r * (*width) * channel_count;
-			ind_t col_base_pos = c * channel_count;
-			uint32_t col_rgb =
-			    (uint32_t) (texpic_p[row_pos + col_base_pos + 0]) |
-			    (uint32_t) (texpic_p[row_pos + col_base_pos + 1]) << 8 |
-			    (uint32_t) (texpic_p[row_pos + col_base_pos + 2]) << 16;
-			col_t current_col_idx = hmget(colmap, col_rgb);
-			if (current_col_idx == default_value) {
-				hmput(colmap, col_rgb, col_idx);
-				current_col_idx = col_idx;
+		for (col_t i = 0; i < tb->count; i++) {
+			uint32_t rgb = tb->colors[i];
+			size_t slot = coltab_slot(&palette, rgb);
+			if (!palette.keys[slot]) {
+				/// The last palette entry is reserved for black
+				if (col_idx == SIS_MAX_COLORS) {
+					overflow = true;
+					break;
+				}
+				palette.keys[slot] = rgb + 1;
+				palette.values[slot] = col_idx;
+				sis->SISred[col_idx] = rgb & 0xff;
+				sis->SISgreen[col_idx] = (rgb >> 8) & 0xff;
+				sis->SISblue[col_idx] = (rgb >> 16) & 0xff;
 				col_idx++;
 			}
-			Tread_buf[r][c] = current_col_idx;
-			SISred[current_col_idx] = texpic_p[row_pos + col_base_pos + 0];
-			SISgreen[current_col_idx] = texpic_p[row_pos + col_base_pos + 1];
-			SISblue[current_col_idx] = texpic_p[row_pos + col_base_pos + 2];
+			tb->remap[i] = palette.values[slot];
+		}
+	}
+	coltab_free(&palette);
+	if (!overflow)
+		ParallelFor(height, bands, remap_texture_band, &ti);
+	for (int b = 0; b < bands; b++) {
+		coltab_free(&ti.bands[b].tab);
+		free(ti.bands[b].colors);
+		free(ti.bands[b].remap);
+	}
+	free(ti.bands);
+	if (overflow) {
+		free_palette_texture();
+		return -1;
+	}
+	return col_idx;
+}
 
+
+void
+Stb_OpenTFile(char *TFileName, ind_t *width, ind_t *height)
+{
+	int channel_count = 0, desired_channel_count = 3;
+	int w = 0, h = 0;
+	if (sis->direct_rgb) {
+		open_rgb_texture(TFileName, width, height);
+		return;
+	}
+	char CacheName[PATH_MAX];
+	if ((sis->texpic_p = (unsigned char *)map_texture(TFileName, width, height, CacheName))) {
+		sis->texpic_mapped = true;
+	} else if (sis->texture_scale != 0.0f) {
+		open_scaled_texture(TFileName, width, height);
+		write_texture_cache(CacheName, *width, *height, 3);
+	} else {
+		if (!(sis->texpic_p = load_image(TFileName, &w, &h,
+		                            &channel_count, desired_channel_count))) {
+			fprintf(stderr, "Failed to load %s: %s\n", TFileName, stbi_failure_reason());
+			SISExit(1);
 		}
+		*width = w;
+		*height = h;
+		if (channel_count != desired_channel_count) {
+			fprintf(stderr,
+			        "Input texture map image must have three color channels\n");
+			/// TODO: check if we can continue if channel count is not equal
+			///       to the desired channel count
+			SISExit(1);
+		}
+		write_texture_cache(CacheName, w, h, 3);
+	}
+	ind_t col_count = index_texture(sis->texpic_p, *width, *height);
+	if (col_count < 0) {
+		/// Fall back to direct RGB colors
+		free_texture_pixels();
+		fprintf(stderr, "Texture has more than %d colors, "
+		        "using direct RGB colors\n", SIS_MAX_COLORS);
+		sis->direct_rgb = true;
+		open_rgb_texture(TFileName, width, height);
+		return;
 	}
-	hmfree(colmap);
-	/// Number of unique colors is col_idx + black
-	// printf("texture unique color count: %d\n", col_idx + 1);
-	Tcolcount = col_idx + 1;
+	/// Number of unique colors is col_count + black
+	sis->Tcolcount = col_count + 1;
 }
 
 
@@ -142,7 +775,7 @@ Stb_GetDFileBuffer(void)
 unsigned char *
 Stb_GetTFileBuffer(void)
 {
-	return texpic_p;
+	return sis->texpic_p;
 }
 
 
@@ -156,12 +789,16 @@ Stb_GetSISFileBuffer(void)
 void
 Stb_ReadDBuffer(ind_t r)
 {
-	z_t zval = 0;
-	for (ind_t c = 0; c < Dwidth; c++) {
-		DBuffer[c] = inpic_p[r * Dwidth + c];
-		zval = DBuffer[c] << 8;
-		DaddEntry(DBuffer[c], zval);
+	col_t lo, hi;
+	if (inpic16_p) {
+		sis->IngestDepthRow16(DBuffer, inpic16_p + r * sis->Dwidth, sis->Dwidth, &lo, &hi);
+		/// 16-bit depth values are the z values
+		DaddRange(lo, hi, 0);
+		return;
 	}
+	sis->IngestDepthRow(DBuffer, inpic_p + r * sis->Dwidth, sis->Dwidth, &lo, &hi);
+	/// 8-bit depth values are scaled to the full z range
+	DaddRange(lo, hi, 8);
 }
 
 
@@ -184,6 +821,14 @@ Stb_ReadDBuffer(ind_t r)
 void
 Stb_WriteSISColorBuffer(ind_t r)
 {
+	if (sis->SISPixelFormat == SIS_PIXFMT_BILEVEL) {
+		GatherBitRow(outpic_buf_p + r * outpic_row_bytes, r, 0);
+		return;
+	}
+	if (sis->SISPixelFormat == SIS_PIXFMT_INDEXED) {
+		GatherIndexRow(outpic_buf_p + r * outpic_row_bytes, r);
+		return;
+	}
 	// Write each line of the generated SIS subsequently to the output file / buffer
 	for (ind_t c = 0; c < outpic_width; c++) {
 		ind_t row_pos = r * outpic_width * SISChannelCount;
@@ -197,6 +842,17 @@ Stb_WriteSISColorBuffer(ind_t r)
 }
 
 
+// Return the row r of color palette indices (or packed RGB colors) of the
+// texture image
+col_t *
+Stb_ReadTRow(ind_t r)
+{
+	if (sis->Trgb_buf)
+		return sis->Trgb_buf + r * sis->Twidth;
+	return sis->Tread_buf + r * sis->Tread_stride;
+}
+
+
 // Return the index into the color palette of the pixel with coordinates (r, c)
 // in the texture image
 col_t
@@ -206,25 +862,37 @@ Stb_ReadTPixel(ind_t r, ind_t c)
 	if (cur_Tread != r) {
 		cur_Tread = r;
 	}
-	return Tread_buf[r][c];
+	if (sis->Trgb_buf)
+		return sis->Trgb_buf[r * sis->Twidth + c];
+	return sis->Tread_buf[r * sis->Tread_stride + c];
 }
 
 
 void
 Stb_CloseDFile(void)
 {
+	if (inpic16_from_pfm)
+		free(inpic16_p);
+	else
+		stbi_image_free(inpic16_p);
 	stbi_image_free(inpic_p);
+	inpic_p = NULL;
+	inpic16_p = NULL;
 }
 
 
 void
 Stb_CloseTFile(ind_t height)
 {
-	for (ind_t r = 0; r < height; ++r) {
-		free(Tread_buf[r]);
-	}
-	free(Tread_buf);
-	stbi_image_free(texpic_p);
+	free_palette_texture();
+	if (sis->Trgb_own)
+		free(sis->Trgb_buf);
+	free_texture_pixels();
+	sis->Trgb_buf = NULL;
+	sis->Trgb_own = false;
+	/// The standard input is shared by all states, only a texture from it frees it
+	if (IsStdStream(sis->TFileName))
+		free_stdin();
 }
 
 
@@ -235,13 +903,103 @@ Stb_CloseSISFile(void)
 }
 
 
+/// Write the RGB output buffer as pbm file, dark dots are black
+static int
+write_pbm_threshold(FILE *fp)
+{
+	size_t row_bytes = (outpic_width + 7) / 8;
+	unsigned char *row = (unsigned char *)calloc(row_bytes, 1);
+	int ok = row && fprintf(fp, "P4\n%ld %ld\n", outpic_width, outpic_height) > 0;
+	for (ind_t r = 0; ok && r < outpic_height; r++) {
+		const unsigned char *p = outpic_buf_p + r * outpic_row_bytes;
+		memset(row, 0, row_bytes);
+		for (ind_t c = 0; c < outpic_width; c++, p += SISChannelCount) {
+			if (p[0] * 77 + p[1] * 150 + p[2] * 29 < 128 * 256)
+				row[c >> 3] |= 0x80 >> (c & 7);
+		}
+		ok = fwrite(row, 1, row_bytes, fp) == row_bytes;
+	}
+	free(row);
+	return ok;
+}
+
+
+/// stb_image_write output function, context is the output file
+static bool write_failed;
+
+static void
+write_to_file(void *context, void *data, int size)
+{
+	if (fwrite(data, 1, size, (FILE *)context) != (size_t)size)
+		write_failed = true;
+}
+
+
+/// Write bmp, tga, jpeg, pbm or raw files, these are written at once
+static int
+write_stb_file(FILE *fp)
+{
+	write_failed = false;
+	switch (sis->ImgFileFormat) {
+	case SIS_IMGFMT_BMP:
+		return stbi_write_bmp_to_func(write_to_file, fp, outpic_width, outpic_height,
+		                              SISChannelCount, outpic_buf_p) && !write_failed;
+	case SIS_IMGFMT_TGA:
+		/// Uncompressed, tga files are for handing the image on quickly
+		stbi_write_tga_with_rle = 0;
+		return stbi_write_tga_to_func(write_to_file, fp, outpic_width, outpic_height,
+		                              SISChannelCount, outpic_buf_p) && !write_failed;
+	case SIS_IMGFMT_JPEG:
+		return stbi_write_jpg_to_func(write_to_file, fp, outpic_width, outpic_height,
+		                              SISChannelCount, outpic_buf_p, sis->jpeg_quality) && !write_failed;
+	case SIS_IMGFMT_PBM:
+		/// Only in the gui, otherwise pbm files are written by map.c
+		return write_pbm_threshold(fp);
+	default: {
+		size_t size = (size_t)outpic_width * outpic_height * SISChannelCount;
+		return fwrite(outpic_buf_p, 1, size, fp) == size;
+	}
+	}
+}
+
+
 void
 Stb_WriteSISFile(void)
 {
-	// TODO write to other image formats
-	stbi_write_png(SISFileName,
-	               outpic_width,
-	               outpic_height,
-	               SISChannelCount,
-	               outpic_buf_p, outpic_width * SISChannelCount);
+	int ok = 1;
+	switch (sis->ImgFileFormat) {
+	case SIS_IMGFMT_QOI:
+		QoiWriteImage(sis->SISFileName, outpic_buf_p, outpic_width, outpic_height);
+		break;
+	case SIS_IMGFMT_BMP:
+	case SIS_IMGFMT_TGA:
+	case SIS_IMGFMT_JPEG:
+	case SIS_IMGFMT_PBM:
+	case SIS_IMGFMT_RAW: {
+		FILE *fp = OpenOutputFile(sis->SISFileName);
+		ok = fp && write_stb_file(fp);
+		if (fp && CloseOutputFile(fp))
+			ok = 0;
+		break;
+	}
+	case SIS_IMGFMT_PPM:
+		/// Only in the gui, otherwise ppm and raw files are written by map.c
+		ok = WriteCacheFile(sis->SISFileName, outpic_buf_p, outpic_width, outpic_height,
+		                    SISChannelCount, 1, SISChannelCount);
+		break;
+	case SIS_IMGFMT_TIFF:
+		TiffWriteImage(sis->SISFileName, outpic_buf_p, outpic_width, outpic_height, sis->SISPixelFormat);
+		break;
+	case SIS_IMGFMT_GIF:
+		/// Only in the gui, otherwise gif files are written by anim.c
+		GifWriteImage(sis->SISFileName, outpic_buf_p, outpic_width, outpic_height);
+		break;
+	default:
+		PngWriteImage(sis->SISFileName, outpic_buf_p, outpic_width, outpic_height, sis->SISPixelFormat);
+		break;
+	}
+	if (!ok) {
+		fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+		SISExit(1);
+	}
 }
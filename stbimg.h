@@ -24,6 +24,7 @@
 
 void Stb_OpenDFile(char *DFileName, ind_t * width, ind_t * height);
 void Stb_OpenTFile(char *TFileName, ind_t * width, ind_t * height);
+void Stb_WriteDCache(const char *CacheName);
 void Stb_CreateSISBuffer(ind_t width, ind_t height, int SIStype);
 
 unsigned char *Stb_GetDFileBuffer(void);
@@ -34,6 +35,7 @@ void Stb_ReadDBuffer(ind_t r);
 void Stb_WriteSISBuffer(ind_t r);
 void Stb_WriteSISColorBuffer(ind_t r);
 col_t Stb_ReadTPixel(ind_t r, ind_t c);
+col_t *Stb_ReadTRow(ind_t r);
 
 void Stb_CloseDFile(void);
 void Stb_CloseTFile(ind_t height);
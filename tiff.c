@@ -0,0 +1,496 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "tiff.h"
+
+/*
+
+tiff strip writer for large print jobs.
+
+The rows are collected in strips of about STRIP_SIZE bytes, each strip is
+compressed (see --tiff-compression) and written as soon as it is full. The
+directory with the strip offsets, the resolution and the palette follows the
+strips at the end of the file, only its offset in the header is written
+last. Files that might grow beyond 4 GB are written as BigTIFF with 64-bit
+offsets, so the size of the image is only limited by the disk.
+
+*/
+
+#define STRIP_SIZE    (256 * 1024)
+
+/// Field types
+#define TIFF_SHORT    3
+#define TIFF_LONG     4
+#define TIFF_RATIONAL 5
+#define TIFF_LONG8    16
+
+#define MAX_ENTRIES   16
+
+typedef struct {
+	uint16_t tag, type;
+	uint64_t count;
+	/// Value if it fits into the entry, otherwise the offset of the data
+	unsigned char value[8];
+} tiff_entry_t;
+
+static FILE *tiff_fp;
+/// The file is assembled in memory if tiff_fp can't be rewound
+static bool tiff_buffered;
+static unsigned char *tiff_mem;
+static size_t tiff_mem_size, tiff_mem_cap;
+static const char *tiff_name;
+static bool bigtiff;
+/// Bytes written so far
+static uint64_t tiff_pos;
+static ind_t tiff_width, tiff_height;
+static int tiff_pixfmt;
+static size_t row_bytes;
+static ind_t rows_per_strip, strip_rows;
+static unsigned char *strip, *packed;
+static uint64_t *strip_offsets, *strip_counts;
+static ind_t strip_count;
+static deflate_t zs;
+static tiff_entry_t entries[MAX_ENTRIES];
+static int entry_count;
+
+
+/// Compression from its name, 0 if unknown
+int
+tiff_compression_from_name(const char *name)
+{
+	if (!strcmp(name, "none"))
+		return SIS_TIFF_NONE;
+	if (!strcmp(name, "packbits"))
+		return SIS_TIFF_PACKBITS;
+	if (!strcmp(name, "deflate"))
+		return SIS_TIFF_DEFLATE;
+	return 0;
+}
+
+
+static void
+write_bytes(const void *data, size_t len)
+{
+	if (tiff_buffered) {
+		if (tiff_mem_size + len > tiff_mem_cap) {
+			size_t cap = tiff_mem_cap ? tiff_mem_cap : 1 << 16;
+			while (cap < tiff_mem_size + len)
+				cap *= 2;
+			unsigned char *p = (unsigned char *)realloc(tiff_mem, cap);
+			if (!p) {
+				fprintf(stderr, "Failed to allocate output buffer.\n");
+				SISExit(1);
+			}
+			tiff_mem = p;
+			tiff_mem_cap = cap;
+		}
+		memcpy(tiff_mem + tiff_mem_size, data, len);
+		tiff_mem_size += len;
+	} else if (len && fwrite(data, 1, len, tiff_fp) != len) {
+		fprintf(stderr, "Failed to write %s.\n", tiff_name);
+		SISExit(1);
+	}
+	tiff_pos += len;
+}
+
+
+static void
+put_le(unsigned char *p, uint64_t v, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		p[i] = v >> (8 * i);
+}
+
+
+static int
+type_size(int type)
+{
+	return type == TIFF_SHORT ? 2 : type == TIFF_LONG ? 4 : 8;
+}
+
+
+/// Add a directory entry with count values of type. Values that don't fit
+/// into the entry are written to the file now, the directory follows them.
+static void
+add_entry(uint16_t tag, uint16_t type, uint64_t count, const uint64_t *values)
+{
+	tiff_entry_t *e = &entries[entry_count++];
+	e->tag = tag;
+	e->type = type;
+	e->count = count;
+	memset(e->value, 0, sizeof(e->value));
+	/// A rational is the numerator and the denominator as two longs
+	if (type == TIFF_RATIONAL) {
+		type = TIFF_LONG;
+		count *= 2;
+	}
+	int size = type_size(type);
+	if (count * size <= (uint64_t)(bigtiff ? 8 : 4)) {
+		for (uint64_t i = 0; i < count; i++)
+			put_le(e->value + i * size, values[i], size);
+		return;
+	}
+	unsigned char buf[4096];
+	size_t n = 0;
+	if (tiff_pos & 1)
+		write_bytes("", 1);
+	put_le(e->value, tiff_pos, bigtiff ? 8 : 4);
+	for (uint64_t i = 0; i < count; i++) {
+		put_le(buf + n, values[i], size);
+		if ((n += size) == sizeof(buf)) {
+			write_bytes(buf, n);
+			n = 0;
+		}
+	}
+	write_bytes(buf, n);
+}
+
+
+static void
+add_value(uint16_t tag, uint16_t type, uint64_t value)
+{
+	add_entry(tag, type, 1, &value);
+}
+
+
+/// PackBits compression of a row, returns the length
+static size_t
+packbits_row(unsigned char *dst, const unsigned char *src, size_t n)
+{
+	size_t i = 0, o = 0;
+	while (i < n) {
+		size_t run = 1;
+		while (i + run < n && run < 128 && src[i + run] == src[i])
+			run++;
+		if (run >= 3 || (run == 2 && i + run == n)) {
+			dst[o++] = (unsigned char)(1 - run);
+			dst[o++] = src[i];
+			i += run;
+			continue;
+		}
+		/// Literal bytes up to the next run of three
+		size_t lit = 0;
+		while (i + lit < n && lit < 128
+		       && !(i + lit + 2 < n && src[i + lit] == src[i + lit + 1]
+		            && src[i + lit] == src[i + lit + 2]))
+			lit++;
+		dst[o++] = (unsigned char)(lit - 1);
+		memcpy(dst + o, src + i, lit);
+		o += lit;
+		i += lit;
+	}
+	return o;
+}
+
+
+static void
+write_strip(void)
+{
+	size_t len = strip_rows * row_bytes;
+	if (strip_rows == 0)
+		return;
+	strip_offsets[strip_count] = tiff_pos;
+	switch (sis->tiff_compression) {
+	case SIS_TIFF_PACKBITS: {
+		size_t n = 0;
+		/// Each row is packed on its own
+		for (ind_t r = 0; r < strip_rows; r++)
+			n += packbits_row(packed + n, strip + r * row_bytes, row_bytes);
+		write_bytes(packed, n);
+		len = n;
+		break;
+	}
+	case SIS_TIFF_DEFLATE: {
+		/// Each strip is a zlib stream
+		unsigned char header[2], trailer[4];
+		uint32_t adler = Adler32(1, strip, len);
+		ZlibHeader(sis->png_level, header);
+		zs.len = 0;
+		DeflateBand(&zs, strip, len);
+		DeflateFinish(&zs);
+		trailer[0] = adler >> 24;
+		trailer[1] = adler >> 16;
+		trailer[2] = adler >> 8;
+		trailer[3] = adler;
+		write_bytes(header, 2);
+		write_bytes(zs.data, zs.len);
+		write_bytes(trailer, 4);
+		len = 2 + zs.len + 4;
+		break;
+	}
+	default:
+		write_bytes(strip, len);
+		break;
+	}
+	strip_counts[strip_count++] = len;
+	strip_rows = 0;
+}
+
+
+static void
+tiff_open(const char *FileName, ind_t width, ind_t height, int pixfmt)
+{
+	tiff_name = FileName;
+	tiff_width = width;
+	tiff_height = height;
+	tiff_pixfmt = pixfmt;
+	row_bytes = pixfmt == SIS_PIXFMT_BILEVEL ? (width + 7) / 8
+	          : pixfmt == SIS_PIXFMT_INDEXED ? (size_t)width : (size_t)width * 3;
+	rows_per_strip = STRIP_SIZE / row_bytes ? STRIP_SIZE / row_bytes : 1;
+	if (rows_per_strip > height)
+		rows_per_strip = height;
+	ind_t strips = (height + rows_per_strip - 1) / rows_per_strip;
+	size_t strip_size = rows_per_strip * row_bytes;
+	/// Compressed strips can be a bit larger than the raw ones
+	uint64_t max_size = (uint64_t)row_bytes * height * 129 / 128 + (uint64_t)strips * 64 + 65536;
+	bigtiff = max_size > 0xffffffffu;
+	strip = (unsigned char *)malloc(strip_size);
+	packed = (unsigned char *)malloc(strip_size + strip_size / 128 + rows_per_strip + 1);
+	strip_offsets = (uint64_t *)malloc(strips * sizeof(uint64_t));
+	strip_counts = (uint64_t *)malloc(strips * sizeof(uint64_t));
+	if (!strip || !packed || !strip_offsets || !strip_counts) {
+		fprintf(stderr, "Failed to allocate output strip buffers.\n");
+		SISExit(1);
+	}
+	strip_rows = 0;
+	strip_count = 0;
+	if (sis->tiff_compression == SIS_TIFF_DEFLATE)
+		DeflateInit(&zs, sis->png_level);
+
+	if (!(tiff_fp = OpenOutputFile(FileName))) {
+		fprintf(stderr, "Failed to open %s for writing.\n", FileName);
+		SISExit(1);
+	}
+	/// The offset of the directory is patched into the header at the end.
+	/// A pipe can't be rewound, the file is assembled in memory instead.
+	tiff_buffered = IsStdStream(FileName) && ftell(tiff_fp) != 0;
+	tiff_mem_size = 0;
+	tiff_pos = 0;
+	/// Little-endian header, the offset of the directory is written last
+	static const unsigned char classic[8] = { 'I', 'I', 42, 0, 0, 0, 0, 0 };
+	static const unsigned char big[16] = { 'I', 'I', 43, 0, 8, 0, 0, 0 };
+	if (bigtiff)
+		write_bytes(big, 16);
+	else
+		write_bytes(classic, 8);
+}
+
+
+/// Next row of the image, written into the strip
+static unsigned char *
+next_row(void)
+{
+	return strip + strip_rows * row_bytes;
+}
+
+
+static void
+row_done(void)
+{
+	if (++strip_rows == rows_per_strip)
+		write_strip();
+}
+
+
+/// Write the offset of the directory into the header
+static int
+patch_header(const unsigned char *offset, size_t len)
+{
+	long pos = bigtiff ? 8 : 4;
+	if (!tiff_buffered)
+		return fseek(tiff_fp, pos, SEEK_SET) || fwrite(offset, 1, len, tiff_fp) != len;
+	memcpy(tiff_mem + pos, offset, len);
+	return 0;
+}
+
+
+/// Close the output file, after copying the file assembled in memory to it
+static int
+close_output(void)
+{
+	int err = 0;
+	if (tiff_buffered && tiff_fp
+	    && fwrite(tiff_mem, 1, tiff_mem_size, tiff_fp) != tiff_mem_size)
+		err = 1;
+	free(tiff_mem);
+	tiff_mem = NULL;
+	tiff_mem_size = tiff_mem_cap = 0;
+	tiff_buffered = false;
+	if (tiff_fp && CloseOutputFile(tiff_fp))
+		err = 1;
+	tiff_fp = NULL;
+	return err;
+}
+
+
+static void
+tiff_close(void)
+{
+	/// Room for a BigTIFF directory entry
+	unsigned char buf[20];
+	uint64_t values[3 * 256];
+	write_strip();
+
+	entry_count = 0;
+	add_value(256, TIFF_LONG, tiff_width);              /// ImageWidth
+	add_value(257, TIFF_LONG, tiff_height);             /// ImageLength
+	if (tiff_pixfmt == SIS_PIXFMT_RGB) {
+		values[0] = values[1] = values[2] = 8;
+		add_entry(258, TIFF_SHORT, 3, values);          /// BitsPerSample
+	} else {
+		add_value(258, TIFF_SHORT, tiff_pixfmt == SIS_PIXFMT_BILEVEL ? 1 : 8);
+	}
+	add_value(259, TIFF_SHORT, sis->tiff_compression);       /// Compression
+	/// PhotometricInterpretation: WhiteIsZero, RGB or palette
+	add_value(262, TIFF_SHORT, tiff_pixfmt == SIS_PIXFMT_BILEVEL ? 0
+	          : tiff_pixfmt == SIS_PIXFMT_RGB ? 2 : 3);
+	add_entry(273, bigtiff ? TIFF_LONG8 : TIFF_LONG, strip_count, strip_offsets);
+	add_value(277, TIFF_SHORT, tiff_pixfmt == SIS_PIXFMT_RGB ? 3 : 1);  /// SamplesPerPixel
+	add_value(278, TIFF_LONG, rows_per_strip);          /// RowsPerStrip
+	add_entry(279, bigtiff ? TIFF_LONG8 : TIFF_LONG, strip_count, strip_counts);
+	/// Resolution in dots per inch, as given with -x and -y
+	values[0] = sis->resolution;
+	values[1] = 1;
+	add_entry(282, TIFF_RATIONAL, 1, values);           /// XResolution
+	add_entry(283, TIFF_RATIONAL, 1, values);           /// YResolution
+	add_value(284, TIFF_SHORT, 1);                      /// PlanarConfiguration
+	add_value(296, TIFF_SHORT, 2);                      /// ResolutionUnit inch
+	if (tiff_pixfmt == SIS_PIXFMT_INDEXED) {
+		/// ColorMap with all reds, greens and blues of 16 bits
+		for (int i = 0; i < 256; i++) {
+			for (int k = 0; k < 3; k++)
+				values[k * 256 + i] = i < sis->SISPaletteSize ? sis->SISPalette[3 * i + k] * 257 : 0;
+		}
+		add_entry(320, TIFF_SHORT, 3 * 256, values);
+	}
+
+	if (tiff_pos & 1)
+		write_bytes("", 1);
+	uint64_t ifd_offset = tiff_pos;
+	put_le(buf, entry_count, bigtiff ? 8 : 2);
+	write_bytes(buf, bigtiff ? 8 : 2);
+	for (int i = 0; i < entry_count; i++) {
+		tiff_entry_t *e = &entries[i];
+		put_le(buf, e->tag, 2);
+		put_le(buf + 2, e->type, 2);
+		put_le(buf + 4, e->count, bigtiff ? 8 : 4);
+		memcpy(buf + (bigtiff ? 12 : 8), e->value, bigtiff ? 8 : 4);
+		write_bytes(buf, bigtiff ? 20 : 12);
+	}
+	/// No next directory
+	memset(buf, 0, 8);
+	write_bytes(buf, bigtiff ? 8 : 4);
+
+	put_le(buf, ifd_offset, bigtiff ? 8 : 4);
+	if (patch_header(buf, bigtiff ? 8 : 4) || close_output()) {
+		fprintf(stderr, "Failed to write %s.\n", tiff_name);
+		SISExit(1);
+	}
+}
+
+
+static void
+tiff_free(void)
+{
+	close_output();
+	DeflateFree(&zs);
+	free(strip);
+	free(packed);
+	free(strip_offsets);
+	free(strip_counts);
+	strip = packed = NULL;
+	strip_offsets = strip_counts = NULL;
+}
+
+
+void
+Tiff_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	tiff_open(sis->SISFileName, width, height, sis->SISPixelFormat);
+}
+
+
+void
+Tiff_WriteSISColorBuffer(ind_t r)
+{
+	unsigned char *row = next_row();
+	if (tiff_pixfmt == SIS_PIXFMT_BILEVEL) {
+		/// WhiteIsZero, black dots are 1
+		GatherBitRow(row, r, 1);
+	} else if (tiff_pixfmt == SIS_PIXFMT_INDEXED) {
+		GatherIndexRow(row, r);
+	} else {
+		for (ind_t c = 0; c < tiff_width; c++) {
+			row[3 * c + 0] = SIScolorRGB[c].r;
+			row[3 * c + 1] = SIScolorRGB[c].g;
+			row[3 * c + 2] = SIScolorRGB[c].b;
+		}
+	}
+	row_done();
+}
+
+
+void
+Tiff_WriteSISFile(void)
+{
+	tiff_close();
+}
+
+
+void
+Tiff_CloseSISFile(void)
+{
+	tiff_free();
+}
+
+
+/// The image is never kept in memory as a whole
+unsigned char *
+Tiff_GetSISFileBuffer(void)
+{
+	return NULL;
+}
+
+
+void
+TiffWriteImage(const char *FileName, const unsigned char *pix, ind_t width, ind_t height,
+               int pixfmt)
+{
+	tiff_open(FileName, width, height, pixfmt);
+	for (ind_t r = 0; r < height; r++) {
+		unsigned char *row = next_row();
+		memcpy(row, pix + r * row_bytes, row_bytes);
+		/// The bits of bilevel buffers are black is zero
+		if (pixfmt == SIS_PIXFMT_BILEVEL) {
+			for (size_t i = 0; i < row_bytes; i++)
+				row[i] = ~row[i];
+		}
+		row_done();
+	}
+	tiff_close();
+	tiff_free();
+}
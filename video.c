@@ -0,0 +1,492 @@
+/*
+ * Copyright 2026 Jörg Bakker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sis.h"
+#include "video.h"
+
+/*
+
+Depth videos as YUV4MPEG2 (y4m) streams.
+
+The luma plane of each frame of the depth video is the depth map, the
+chroma planes are skipped. The SIS video is written as y4m stream with 4:4:4,
+4:2:0 or grey (mono) frames.
+
+Everything that doesn't change from frame to frame (texture, palettes, the
+depth tables) is set up once. The depth tables are filled for all depth
+values before the first frame, so the render threads only read them. The row
+buffers of the algorithm are per thread, each thread renders whole frames.
+The frames are read in batches of one frame per thread, rendered in parallel
+and written in their order.
+
+*/
+
+/// Chroma subsampling of the depth video
+enum { CHROMA_MONO, CHROMA_411, CHROMA_420, CHROMA_422, CHROMA_444, CHROMA_444ALPHA };
+
+static FILE *vin, *vout;
+static const char *vin_name;
+/// Bytes per sample (1 or 2) and bits of the samples in the depth video
+static int in_bytes, in_bits;
+static size_t luma_size, chroma_size;
+/// Header fields that are handed on to the SIS video
+static char frame_rate[32] = "25:1", aspect[32] = "0:0";
+/// Bytes of an output frame and of its chroma planes
+static size_t out_size, out_chroma_w, out_chroma_h;
+/// Frame that is rendered by the calling thread, for ReadDBuffer()
+static unsigned char *cur_luma;
+static uint16_t *cur_row16;
+
+
+static void
+read_failed(void)
+{
+	fprintf(stderr, "Failed to read y4m video %s\n", vin_name);
+	SISExit(1);
+}
+
+
+/// Read a header line without the newline, returns false at the end of the file
+static bool
+read_line(char *buf, size_t size)
+{
+	size_t n = 0;
+	int c;
+	while ((c = fgetc(vin)) != EOF && c != '\n') {
+		if (n + 1 < size)
+			buf[n++] = c;
+	}
+	buf[n] = 0;
+	if (c == EOF && n == 0)
+		return false;
+	if (c == EOF)
+		read_failed();
+	return true;
+}
+
+
+/// Chroma subsampling and bits per sample of a C parameter, e.g. 420jpeg or 444p10
+static void
+parse_colorspace(const char *cs, int *chroma, int *bits)
+{
+	static const struct {
+		const char *name;
+		int chroma;
+	} spaces[] = {
+		{ "444alpha", CHROMA_444ALPHA }, { "mono", CHROMA_MONO }, { "411", CHROMA_411 },
+		{ "420", CHROMA_420 }, { "422", CHROMA_422 }, { "444", CHROMA_444 },
+	};
+	for (size_t i = 0; i < sizeof(spaces) / sizeof(spaces[0]); i++) {
+		size_t len = strlen(spaces[i].name);
+		if (strncmp(cs, spaces[i].name, len))
+			continue;
+		*chroma = spaces[i].chroma;
+		cs += len;
+		/// 420jpeg, 420paldv and 420mpeg2 only differ in the chroma siting
+		if (*cs == 'p' && cs[1] >= '0' && cs[1] <= '9')
+			*bits = atoi(cs + 1);
+		else if (*chroma == CHROMA_MONO && *cs >= '0' && *cs <= '9')
+			*bits = atoi(cs);
+		else
+			*bits = 8;
+		return;
+	}
+	fprintf(stderr, "Unsupported y4m color space C%s in %s\n", cs, vin_name);
+	SISExit(1);
+}
+
+
+void
+Video_OpenDFile(char *DFileName, ind_t *width, ind_t *height)
+{
+	char header[1024];
+	int chroma = CHROMA_420, bits = 8;
+	ind_t w = 0, h = 0;
+	vin_name = DFileName;
+	if (IsStdStream(DFileName))
+		vin = stdin;
+	else if (!(vin = fopen(DFileName, "rb"))) {
+		fprintf(stderr, "Failed to open %s\n", DFileName);
+		SISExit(1);
+	}
+	if (!read_line(header, sizeof(header)) || strncmp(header, "YUV4MPEG2 ", 10)) {
+		fprintf(stderr, "%s is not a y4m video\n", DFileName);
+		SISExit(1);
+	}
+	for (char *tok = strtok(header + 10, " "); tok; tok = strtok(NULL, " ")) {
+		switch (tok[0]) {
+		case 'W':
+			w = atol(tok + 1);
+			break;
+		case 'H':
+			h = atol(tok + 1);
+			break;
+		case 'F':
+			snprintf(frame_rate, sizeof(frame_rate), "%s", tok + 1);
+			break;
+		case 'A':
+			snprintf(aspect, sizeof(aspect), "%s", tok + 1);
+			break;
+		case 'C':
+			parse_colorspace(tok + 1, &chroma, &bits);
+			break;
+		}
+	}
+	if (w <= 0 || h <= 0 || bits < 8 || bits > 16) {
+		fprintf(stderr, "Invalid y4m header in %s\n", DFileName);
+		SISExit(1);
+	}
+	in_bits = bits;
+	in_bytes = bits > 8 ? 2 : 1;
+	luma_size = (size_t)w * h * in_bytes;
+	switch (chroma) {
+	case CHROMA_MONO:
+		chroma_size = 0;
+		break;
+	case CHROMA_411:
+		chroma_size = 2 * (size_t)((w + 3) / 4) * h;
+		break;
+	case CHROMA_420:
+		chroma_size = 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+		break;
+	case CHROMA_422:
+		chroma_size = 2 * (size_t)((w + 1) / 2) * h;
+		break;
+	case CHROMA_444:
+		chroma_size = 2 * (size_t)w * h;
+		break;
+	case CHROMA_444ALPHA:
+		chroma_size = 3 * (size_t)w * h;
+		break;
+	}
+	chroma_size *= in_bytes;
+	if (!(cur_row16 = (uint16_t *)malloc(w * sizeof(uint16_t)))) {
+		fprintf(stderr, "Failed to allocate depth row buffer.\n");
+		SISExit(1);
+	}
+	*width = w;
+	*height = h;
+	sis->black_value = 0;
+	sis->white_value = SIS_MAX_CMAP;
+}
+
+
+/// Read the luma plane of the next frame into luma, false at the end of the video
+static bool
+read_frame(unsigned char *luma)
+{
+	char line[256];
+	static unsigned char skip[65536];
+	if (!read_line(line, sizeof(line)))
+		return false;
+	if (strncmp(line, "FRAME", 5))
+		read_failed();
+	if (fread(luma, 1, luma_size, vin) != luma_size)
+		read_failed();
+	for (size_t left = chroma_size; left > 0; ) {
+		size_t n = left < sizeof(skip) ? left : sizeof(skip);
+		if (fread(skip, 1, n, vin) != n)
+			read_failed();
+		left -= n;
+	}
+	return true;
+}
+
+
+/// Copy row r of a frame into DBuffer
+static void
+ingest_row(const unsigned char *luma, ind_t r, uint16_t *row16)
+{
+	col_t lo, hi;
+	if (in_bytes == 1) {
+		sis->IngestDepthRow(DBuffer, luma + r * sis->Dwidth, sis->Dwidth, &lo, &hi);
+		DaddRange(lo, hi, 8);
+		return;
+	}
+	/// Little-endian samples with in_bits bits are scaled to 16 bits
+	const unsigned char *p = luma + 2 * r * sis->Dwidth;
+	for (ind_t c = 0; c < sis->Dwidth; c++)
+		row16[c] = (uint16_t)((p[2 * c] | p[2 * c + 1] << 8) << (16 - in_bits));
+	sis->IngestDepthRow16(DBuffer, row16, sis->Dwidth, &lo, &hi);
+	DaddRange(lo, hi, 0);
+}
+
+
+void
+Video_ReadDBuffer(ind_t r)
+{
+	ingest_row(cur_luma, r, cur_row16);
+}
+
+
+void
+Video_CloseDFile(void)
+{
+	if (vin && vin != stdin)
+		fclose(vin);
+	vin = NULL;
+	free(cur_row16);
+	cur_row16 = NULL;
+}
+
+
+unsigned char *
+Video_GetDFileBuffer(void)
+{
+	return cur_luma;
+}
+
+
+/// Limited range BT.601 colors, as most players expect them in y4m files
+static inline unsigned char
+rgb_to_y(int r, int g, int b)
+{
+	return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+
+static inline unsigned char
+rgb_to_u(int r, int g, int b)
+{
+	return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+
+static inline unsigned char
+rgb_to_v(int r, int g, int b)
+{
+	return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+
+/// Convert the rendered row r into the planes of the output frame. For 4:2:0
+/// the chroma of the row is written into the full size planes in chroma,
+/// which are subsampled when the frame is done.
+static void
+put_row(unsigned char *frame, unsigned char *chroma, ind_t r)
+{
+	unsigned char *y = frame + r * sis->SISwidth;
+	size_t plane = (size_t)sis->SISwidth * sis->SISheight;
+	unsigned char *u = (sis->y4m_chroma == SIS_Y4M_420 ? chroma : frame + plane) + r * sis->SISwidth;
+	unsigned char *v = u + plane;
+	for (ind_t c = 0; c < sis->SISwidth; c++) {
+		/// The same 8-bit colors as in the other output files
+		int cr = (unsigned char)SIScolorRGB[c].r;
+		int cg = (unsigned char)SIScolorRGB[c].g;
+		int cb = (unsigned char)SIScolorRGB[c].b;
+		y[c] = rgb_to_y(cr, cg, cb);
+		if (sis->y4m_chroma != SIS_Y4M_MONO) {
+			u[c] = rgb_to_u(cr, cg, cb);
+			v[c] = rgb_to_v(cr, cg, cb);
+		}
+	}
+}
+
+
+/// Average each 2x2 chroma samples of the full size planes in chroma
+static void
+subsample_chroma(unsigned char *frame, const unsigned char *chroma)
+{
+	size_t plane = (size_t)sis->SISwidth * sis->SISheight;
+	unsigned char *dst = frame + plane;
+	for (int k = 0; k < 2; k++, chroma += plane) {
+		for (size_t cy = 0; cy < out_chroma_h; cy++) {
+			const unsigned char *a = chroma + 2 * cy * sis->SISwidth;
+			const unsigned char *b = 2 * cy + 1 < (size_t)sis->SISheight ? a + sis->SISwidth : a;
+			for (size_t cx = 0; cx < out_chroma_w; cx++) {
+				size_t x0 = 2 * cx, x1 = 2 * cx + 1 < (size_t)sis->SISwidth ? 2 * cx + 1 : 2 * cx;
+				*dst++ = (a[x0] + a[x1] + b[x0] + b[x1] + 2) >> 2;
+			}
+		}
+	}
+}
+
+
+void
+Video_CreateSISBuffer(ind_t width, ind_t height, int SIStype)
+{
+	static const char *colorspaces[] = {
+		[SIS_Y4M_MONO] = "mono", [SIS_Y4M_420] = "420jpeg", [SIS_Y4M_444] = "444"
+	};
+	out_chroma_w = sis->y4m_chroma == SIS_Y4M_420 ? (width + 1) / 2 : width;
+	out_chroma_h = sis->y4m_chroma == SIS_Y4M_420 ? (height + 1) / 2 : height;
+	out_size = (size_t)width * height
+	         + (sis->y4m_chroma == SIS_Y4M_MONO ? 0 : 2 * out_chroma_w * out_chroma_h);
+	if (!(vout = OpenOutputFile(sis->SISFileName))) {
+		fprintf(stderr, "Failed to open %s for writing.\n", sis->SISFileName);
+		SISExit(1);
+	}
+	if (fprintf(vout, "YUV4MPEG2 W%ld H%ld F%s Ip A%s C%s\n", width, height,
+	            frame_rate, aspect, colorspaces[sis->y4m_chroma]) < 0) {
+		fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+		SISExit(1);
+	}
+}
+
+
+/// Rows are put into the frames by render_video()
+void
+Video_WriteSISColorBuffer(ind_t r)
+{
+}
+
+
+void
+Video_WriteSISFile(void)
+{
+	if (vout && CloseOutputFile(vout)) {
+		fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+		SISExit(1);
+	}
+	vout = NULL;
+}
+
+
+void
+Video_CloseSISFile(void)
+{
+	Video_WriteSISFile();
+}
+
+
+unsigned char *
+Video_GetSISFileBuffer(void)
+{
+	return NULL;
+}
+
+
+typedef struct {
+	unsigned char **luma, **frames;
+	uint32_t *seeds;
+	sis_stats_t *stats;
+} batch_t;
+
+
+static void
+render_frames(void *arg, int band, ind_t begin, ind_t end)
+{
+	batch_t *b = (batch_t *)arg;
+	/// The calling thread renders with the buffers of init_sis()
+	bool own_buffers = !DBuffer;
+	if (own_buffers)
+		AllocBuffers();
+	uint16_t *row16 = (uint16_t *)malloc(sis->Dwidth * sizeof(uint16_t));
+	unsigned char *chroma = sis->y4m_chroma == SIS_Y4M_420
+	                      ? (unsigned char *)malloc(2 * (size_t)sis->SISwidth * sis->SISheight) : NULL;
+	if (!row16 || (sis->y4m_chroma == SIS_Y4M_420 && !chroma)) {
+		fprintf(stderr, "Failed to allocate frame buffers.\n");
+		SISExit(1);
+	}
+	for (ind_t f = begin; f < end; f++) {
+		pos_t pos = 0.0;
+		SetDotSeed(&b->seeds[f]);
+		for (ind_t r = 0; r < sis->SISheight; r++) {
+			ind_t dr = (ind_t)pos;
+			pos += sis->DLineStep;
+			max_depth_in_row = SIS_MIN_DEPTH;
+			min_depth_in_row = SIS_MAX_DEPTH;
+			ingest_row(b->luma[f], dr, row16);
+			render_line(r, &b->stats[band]);
+			put_row(b->frames[f], chroma, r);
+		}
+		if (chroma)
+			subsample_chroma(b->frames[f], chroma);
+	}
+	SetDotSeed(NULL);
+	free(row16);
+	free(chroma);
+	if (own_buffers) {
+		FreeBuffers();
+		DBuffer = NULL;
+		SIScolorRGB = NULL;
+	}
+}
+
+
+void
+render_video(void)
+{
+	int batch = ThreadCount();
+	batch_t b;
+	long frame_count = 0;
+	b.luma = (unsigned char **)calloc(batch, sizeof(unsigned char *));
+	b.frames = (unsigned char **)calloc(batch, sizeof(unsigned char *));
+	b.seeds = (uint32_t *)calloc(batch, sizeof(uint32_t));
+	b.stats = (sis_stats_t *)calloc(batch, sizeof(sis_stats_t));
+	if (!b.luma || !b.frames || !b.seeds || !b.stats) {
+		fprintf(stderr, "Failed to allocate frame buffers.\n");
+		SISExit(1);
+	}
+	for (int i = 0; i < batch; i++) {
+		if (!(b.luma[i] = (unsigned char *)malloc(luma_size))
+		    || !(b.frames[i] = (unsigned char *)malloc(out_size))) {
+			fprintf(stderr, "Failed to allocate frame buffers.\n");
+			SISExit(1);
+		}
+	}
+	/// All depth values of the video are known, fill the tables now and
+	/// the render threads never write them
+	if (in_bytes == 1)
+		DaddRange(0, UINT8_MAX, 8);
+	else
+		DaddRange(0, UINT16_MAX, 0);
+	/// Random dots of each frame depend on the seed (-s) and the frame number
+	uint32_t seed_base = (uint32_t)SISRand();
+	for (;;) {
+		int n = 0;
+		while (n < batch && read_frame(b.luma[n])) {
+			b.seeds[n] = (seed_base + (uint32_t)(frame_count + n) * 0x9e3779b9u) | 1;
+			n++;
+		}
+		if (!n)
+			break;
+		cur_luma = b.luma[0];
+		memset(b.stats, 0, batch * sizeof(sis_stats_t));
+		ParallelFor(n, n, render_frames, &b);
+		for (int i = 0; i < n; i++) {
+			if (fputs("FRAME\n", vout) < 0 || fwrite(b.frames[i], 1, out_size, vout) != out_size) {
+				fprintf(stderr, "Failed to write %s.\n", sis->SISFileName);
+				SISExit(1);
+			}
+			MergeStats(&sis->render_stats, &b.stats[i]);
+		}
+		frame_count += n;
+		if (sis->verbose) {
+			printf("  %6ld\r", frame_count);
+			fflush(stdout);
+		}
+	}
+	for (int i = 0; i < batch; i++) {
+		free(b.luma[i]);
+		free(b.frames[i]);
+	}
+	free(b.luma);
+	free(b.frames);
+	free(b.seeds);
+	free(b.stats);
+	cur_luma = NULL;
+}